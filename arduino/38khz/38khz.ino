@@ -6,41 +6,81 @@
  *  长连接码：660us脉冲 + 40000us空闲
  *  结束码：660us脉冲
  *  数据0：660us脉冲 + 540us空闲
- *  数据1：660us脉冲 + 1640us空闲
+ *  数据1：660us脉冲 + 1680us空闲
  *  us为微秒
+ *  时长和段的结构在gree_protocol.h中，由tools/gen_protocol.py生成
  */
 
-const byte first[35] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0 };
-const byte second[32] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0 };
-const byte third[35] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 1, 0 };
-const byte four[32] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0 };
-
-// 引导码
-#define AGC_MARK 9000
-#define AGC_SPACE 4500
-
-// 数字0
-#define ZERO_MARK 660
-#define ZERO_SPACE 540
-
-// 数字1
-#define ONE_MARK 660
-#define ONE_SPACE 1640
-
-// 短连接码 
-#define CONN_MARK 660
-// 没有使用，因为delayMicroseconds 最大值为16383，需要延时两次
-#define CONN_SPACE 20000
-
-// 长连接码
-#define CONN_LONG_MARK 660
-// 没有使用，因为delayMicroseconds 最大值为16383，需要延时四次
-#define CONN_LONG_SPACE 40000
-
-// 结束码
-#define END_MARK 660
+#include <avr/pgmspace.h>
+
+#include "gree_protocol.h"
+
+// 预置帧放在flash中，不占SRAM，串口发送'0'~'9'选择
+const byte presets[][PACKED_BYTES] PROGMEM = {
+  // 关机，自动模式25度
+  { 0x00, 0x09, 0x20, 0x50, 0x02, 0x00, 0x00, 0x80, 0x01, 0x48, 0x00, 0x81, 0x13, 0x00, 0x00, 0x00, 0x0c },
+  // 制冷26度，自动风，灯光开
+  { 0x09, 0x0a, 0x20, 0x50, 0x02, 0x00, 0x00, 0x80, 0x4e, 0x50, 0x00, 0x81, 0x13, 0x00, 0x00, 0x00, 0x34 },
+  // 制热22度，自动风，灯光开
+  { 0x0c, 0x06, 0x20, 0x50, 0x02, 0x00, 0x00, 0x00, 0x66, 0x30, 0x00, 0x81, 0x13, 0x00, 0x00, 0x00, 0x30 },
+};
+
+#define PRESET_NUM (sizeof(presets) / sizeof(presets[0]))
+
+// 两帧之间的间隔
+#define FRAME_INTERVAL_MS 5000
+
+// Timer2 64分频，一个计数为4us
+#define TICK_US 4
+#define US_TO_TICKS(us) ((us) / TICK_US)
+// Timer2是8位的，一次中断最多256个计数，更长的时间分几次
+#define TIMER2_MAX_TICKS 256
+// 最后一段太短时，写OCR2A前TCNT2可能已经超过它，留出余量
+#define TIMER2_MIN_TICKS 32
+
+// 波形表中的时长编号，每种码的脉冲后面紧跟着它的空闲
+enum {
+  CODE_LEADER_MARK,
+  CODE_LEADER_SPACE,
+  CODE_ZERO_MARK,
+  CODE_ZERO_SPACE,
+  CODE_ONE_MARK,
+  CODE_ONE_SPACE,
+  CODE_CONNECT_MARK,
+  CODE_CONNECT_SPACE,
+  CODE_LONG_CONNECT_MARK,
+  CODE_LONG_CONNECT_SPACE,
+  CODE_END_MARK,
+};
+
+const uint16_t codeTicks[] = {
+  US_TO_TICKS(LEADER_MARK),
+  US_TO_TICKS(LEADER_SPACE),
+  US_TO_TICKS(ZERO_MARK),
+  US_TO_TICKS(ZERO_SPACE),
+  US_TO_TICKS(ONE_MARK),
+  US_TO_TICKS(ONE_SPACE),
+  US_TO_TICKS(CONNECT_MARK),
+  US_TO_TICKS(CONNECT_SPACE),
+  US_TO_TICKS(LONG_CONNECT_MARK),
+  US_TO_TICKS(LONG_CONNECT_SPACE),
+  US_TO_TICKS(END_MARK),
+};
+
+// 段后的码对应的脉冲，下标为segmentGaps中的值
+const byte gapMarks[] = { CODE_CONNECT_MARK, CODE_LONG_CONNECT_MARK, CODE_END_MARK };
+
+// 预先算好的整帧波形，每项是codeTicks的下标
+byte frameCodes[FRAME_CODES];
+
+// 中断中使用的播放状态
+volatile bool sending = false;
+volatile uint16_t playIndex;
+volatile uint16_t playRemain;
 
 void setup() {
+  Serial.begin(115200);
+
   TCCR1A = _BV(WGM11);              // PWM, Phase Correct, Top is ICR1
   TCCR1B = _BV(WGM13) | _BV(CS10);  // CS10 -> no prescaling
 
@@ -53,55 +93,57 @@ void setup() {
   OCR1A = 69;
   // PB1在Arduino UNO R3中为9号针脚
   DDRB |= _BV(PB1);
-}
-void loop() {
+  PORTB &= ~_BV(PB1);
 
-  delay(100);
+  // Timer2 CTC模式，Top为OCR2A，发送时才开始计数
+  TCCR2A = _BV(WGM21);
+  TCCR2B = 0;
 
-  sendLeader();
+  buildFrame(0);
+}
 
-  for (int i = 0; i < sizeof(first); i++) {
-    if (0 == first[i]) {
-      sendZero();
-    } else {
-      sendOne();
+void loop() {
+  static unsigned long lastSend;
+
+  // 串口收到's'立即发送当前帧，收到数字时换成对应的预置帧再发送
+  if (Serial.available() > 0 && !sending) {
+    int c = Serial.read();
+    if (c >= '0' && c < '0' + (int)PRESET_NUM) {
+      buildFrame(c - '0');
+      startSend();
+    } else if (c == 's') {
+      startSend();
     }
   }
 
-  sendConnect();
-
-  for (int i = 0; i < sizeof(second); i++) {
-    if (0 == second[i]) {
-      sendZero();
-    } else {
-      sendOne();
-    }
+  if (millis() - lastSend >= FRAME_INTERVAL_MS && startSend()) {
+    lastSend = millis();
   }
+}
 
-  sendConnectLong();
-
-  sendLeader();
-
-  for (int i = 0; i < sizeof(first); i++) {
-    if (0 == third[i]) {
-      sendZero();
-    } else {
-      sendOne();
+// 正在发送时不能调用，frameCodes在中断中使用
+void buildFrame(byte preset) {
+  const byte *packed = presets[preset];
+  int n = 0;
+  int offset = 0;
+
+  for (byte segment = 0; segment < SEGMENT_NUM; segment++) {
+    // 第一段和长连接码之后的一段前面是引导码
+    if (segment == 0 || segmentGaps[segment - 1] == GAP_LONG_CONNECT) {
+      frameCodes[n++] = CODE_LEADER_MARK;
+      frameCodes[n++] = CODE_LEADER_SPACE;
     }
-  }
-
-  sendConnect();
-
-  for (int i = 0; i < sizeof(second); i++) {
-    if (0 == four[i]) {
-      sendZero();
-    } else {
-      sendOne();
+    for (byte i = 0; i < segmentBits[segment]; i++, offset++) {
+      byte code = (pgm_read_byte(&packed[offset >> 3]) >> (offset & 7)) & 1 ? CODE_ONE_MARK : CODE_ZERO_MARK;
+      frameCodes[n++] = code;
+      frameCodes[n++] = code + 1;
+    }
+    frameCodes[n++] = gapMarks[segmentGaps[segment]];
+    // 结束码没有空闲
+    if (segmentGaps[segment] != GAP_END) {
+      frameCodes[n++] = gapMarks[segmentGaps[segment]] + 1;
     }
   }
-
-  sendEnd();
-  delay(5000);
 }
 
 void enableSend() {
@@ -113,48 +155,55 @@ void disableSend() {
   TCCR1A &= ~(_BV(COM1A1));
 }
 
-void sendLeader() {
-  enableSend();
-  delayMicroseconds(AGC_MARK);
-  disableSend();
-  delayMicroseconds(AGC_SPACE);
-}
-
-void sendZero() {
-  enableSend();
-  delayMicroseconds(ZERO_MARK);
-  disableSend();
-  delayMicroseconds(ZERO_SPACE);
+// 下一次比较匹配前的计数，剩余不足两段时平分，避免最后一段太短
+void loadChunk() {
+  uint16_t chunk = playRemain;
+  if (chunk > TIMER2_MAX_TICKS) {
+    chunk = playRemain - TIMER2_MAX_TICKS >= TIMER2_MIN_TICKS ? TIMER2_MAX_TICKS : playRemain / 2;
+  }
+  playRemain -= chunk;
+  OCR2A = chunk - 1;
 }
 
-void sendOne() {
+// 正在发送时返回false
+bool startSend() {
+  if (sending) {
+    return false;
+  }
+  sending = true;
+  playIndex = 0;
+  playRemain = codeTicks[frameCodes[0]];
+
+  TCNT2 = 0;
+  loadChunk();
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 = _BV(OCIE2A);
   enableSend();
-  delayMicroseconds(ONE_MARK);
-  disableSend();
-  delayMicroseconds(ONE_SPACE);
+  TCCR2B = _BV(CS22);  // 64分频，开始计时
+  return true;
 }
 
-void sendConnect() {
-  enableSend();
-  delayMicroseconds(CONN_MARK);
-  disableSend();
-  // delayMicroseconds 最大值为16383，所以延时两次
-  delayMicroseconds(10000);
-  delayMicroseconds(9800);
-}
+ISR(TIMER2_COMPA_vect) {
+  if (playRemain > 0) {
+    loadChunk();
+    return;
+  }
 
-void sendConnectLong() {
-  enableSend();
-  delayMicroseconds(CONN_LONG_MARK);
-  disableSend();
-  delayMicroseconds(10000);
-  delayMicroseconds(10000);
-  delayMicroseconds(10000);
-  delayMicroseconds(9500);
-}
+  playIndex++;
+  if (playIndex >= FRAME_CODES) {
+    // 结束码发送完
+    disableSend();
+    TCCR2B = 0;
+    TIMSK2 = 0;
+    sending = false;
+    return;
+  }
 
-void sendEnd() {
-  enableSend();
-  delayMicroseconds(END_MARK);
-  disableSend();
+  if (playIndex & 1) {
+    disableSend();
+  } else {
+    enableSend();
+  }
+  playRemain = codeTicks[frameCodes[playIndex]];
+  loadChunk();
 }
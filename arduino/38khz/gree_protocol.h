@@ -0,0 +1,43 @@
+// 由tools/gen_protocol.py根据protocols/gree_yapof.json生成，不要手动修改
+// 格力空调遥控器YAPOF，时长单位us
+
+#pragma once
+
+// 引导码
+#define LEADER_MARK 9000
+#define LEADER_SPACE 4500
+
+// 数据码 0
+#define ZERO_MARK 660
+#define ZERO_SPACE 540
+
+// 数据码 1
+#define ONE_MARK 660
+#define ONE_SPACE 1680
+
+// 短连接码
+#define CONNECT_MARK 660
+#define CONNECT_SPACE 20000
+
+// 长连接码
+#define LONG_CONNECT_MARK 660
+#define LONG_CONNECT_SPACE 40000
+
+// 结束码，后面没有空闲
+#define END_MARK 660
+
+// 段后的码，长连接码之后重新发引导码
+enum {
+  GAP_CONNECT,
+  GAP_LONG_CONNECT,
+  GAP_END,
+};
+
+#define SEGMENT_NUM 4
+const byte segmentBits[SEGMENT_NUM] = { 35, 32, 35, 32 };
+const byte segmentGaps[SEGMENT_NUM] = { GAP_CONNECT, GAP_LONG_CONNECT, GAP_CONNECT, GAP_END };
+
+// 整帧的数据码按发送顺序逐位存放，低位在前，134位共17字节
+#define PACKED_BYTES 17
+// 整帧波形的项数，每项是一段脉冲或空闲
+#define FRAME_CODES 279
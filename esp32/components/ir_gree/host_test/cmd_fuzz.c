@@ -0,0 +1,357 @@
+/*
+ * MQTT命令解析的模糊测试
+ *
+ * 默认是带种子的变异循环，从合法的二进制和JSON命令出发，随机翻转、替换、插入、删除、截断和拼接，
+ * 每个输入拷贝到刚好len字节的堆内存中再交给ir_gree_cmd_parse、ir_gree_cmd_lookup和ir_gree_sched_parse，
+ * 配合AddressSanitizer，读到len之外会立即报错：
+ *   ir_gree_cmd_fuzz [--iterations 次数] [--seed 种子]
+ *
+ * 用clang编译并打开IR_GREE_LIBFUZZER时编译为libFuzzer的入口，检查相同
+ *
+ * 对每个输入检查：
+ *   出错时返回值合法，state和opts不变
+ *   成功时所有字段在范围内，二进制命令长度与版本一致，JSON命令以{开头、以}结尾
+ *   成功后的状态写回JSON再解析，得到同样的状态
+ * 另外有一组已知的坏命令，必须被拒绝
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir_gree_cmd.h"
+#include "ir_gree_sched.h"
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            s_failures++;                               \
+        }                                               \
+    } while (0)
+
+static const gree_state_t s_initial = {
+    .power = 1,
+    .mode = GREE_MODE_COOL,
+    .temperature = 26,
+    .fan = GREE_FAN_LOW,
+    .swing = 1,
+    .timer = 4,
+};
+static const ir_gree_cmd_opts_t s_initial_opts = {
+    .repeat = 1,
+    .gap_ms = 50,
+};
+
+static const char *const s_json_seeds[] = {
+    "{}",
+    "{\"power\":1,\"mode\":\"cool\",\"temp\":26,\"fan\":\"auto\",\"swing\":true}",
+    " { \"temperature\" : 30 , \"mode\" : 4 , \"light\" : false } ",
+    "{\"temp\":24,\"repeat\":2,\"gap_ms\":100}",
+    "{\"gap\":1000,\"timer\":48,\"turbo\":1,\"sleep\":0}",
+    "{\"unknown\":\"x\",\"fan\":\"high\",\"other\":12}",
+    "{\"id\":\"evening\",\"at\":\"18:00\",\"days\":\"12345\",\"power\":1,\"mode\":\"cool\",\"temp\":26}",
+    "{\"id\":\"t\",\"at\":\"7:5\",\"once\":true,\"power\":0}",
+};
+
+static const uint8_t s_binary_seeds[][IR_GREE_CMD_BINARY_V2_SIZE] = {
+    {'G', 1, 1, 1, 26, 0, 1, 0, 0, 0, 0},
+    {'G', 1, 0, 4, 16, 3, 0, 1, 1, 1, 48},
+    {'G', 2, 1, 2, 30, 2, 1, 0, 0, 0, 0, 5, 0xE8, 0x03},
+    {'G', 2, 0, 0, 20, 0, 0, 0, 0, 0, 1, 0, 0, 0},
+};
+static const size_t s_binary_seed_len[] = {
+    IR_GREE_CMD_BINARY_SIZE,
+    IR_GREE_CMD_BINARY_SIZE,
+    IR_GREE_CMD_BINARY_V2_SIZE,
+    IR_GREE_CMD_BINARY_V2_SIZE,
+};
+
+#define FUZZ_SEED_NUM (sizeof(s_json_seeds) / sizeof(s_json_seeds[0]) + sizeof(s_binary_seeds) / sizeof(s_binary_seeds[0]))
+#define FUZZ_MAX_LEN 256
+
+// 必须被拒绝的命令，len为0时用strlen
+static const struct
+{
+    const char *data;
+    size_t len;
+} s_bad[] = {
+    {"", 0},
+    {"G", 0},
+    {"G\x01\x01\x01\x1a\x00\x01\x00\x00\x00", 10},                  // 版本1少一个字节
+    {"G\x01\x01\x01\x1a\x00\x01\x00\x00\x00\x00\x00", 12},          // 版本1多一个字节
+    {"G\x03\x01\x01\x1a\x00\x01\x00\x00\x00\x00", 11},              // 不认识的版本
+    {"G\x01\x01\x01\x1f\x00\x01\x00\x00\x00\x00", 11},              // 温度31
+    {"G\x02\x01\x01\x1a\x00\x01\x00\x00\x00\x00\x06\x00\x00", 14},  // 重复6次
+    {"G\x02\x01\x01\x1a\x00\x01\x00\x00\x00\x00\x00\xe9\x03", 14},  // 间隔1001ms
+    {"{", 0},
+    {"{\"temp\":", 0},
+    {"{\"temp\":26", 0},
+    {"{\"temp\":26,}", 0},
+    {"{\"temp\":31}", 0},
+    {"{\"temp\":15}", 0},
+    {"{\"temp\":99999999999}", 0},
+    {"{\"temp\":-1}", 0},
+    {"{\"mode\":\"cold\"}", 0},
+    {"{\"fan\":\"hi\\\"gh\"}", 0},
+    {"{\"power\":tru}", 0},
+    {"{\"power\":1}x", 0},
+    {"{\"power\":1}}", 0},
+    {"{\"x\":{\"power\":1}}", 0},
+    {"{\"x\":[1]}", 0},
+    {"{temp:26}", 0},
+    {"{\"temp\"26}", 0},
+    {"[\"temp\",26]", 0},
+    {"{\"repeat\":6}", 0},
+    {"{\"gap_ms\":1001}", 0},
+};
+
+static uint32_t s_rng = 1;
+
+static uint32_t fuzz_random(void)
+{
+    // xorshift32
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static bool state_in_range(const gree_state_t *s)
+{
+    return s->power <= 1 && s->mode <= GREE_MODE_HEAT && s->temperature >= GREE_TEMP_MIN &&
+           s->temperature <= GREE_TEMP_MAX && s->fan <= GREE_FAN_HIGH && s->swing <= 1 && s->light <= 1 &&
+           s->turbo <= 1 && s->sleep <= 1 && s->timer <= GREE_TIMER_MAX;
+}
+
+// 去掉两端空白后的首尾字符
+static bool json_braced(const uint8_t *data, size_t len)
+{
+    size_t begin = 0;
+    size_t end = len;
+    while (begin < end && strchr(" \t\r\n", data[begin]) && data[begin])
+    {
+        begin++;
+    }
+    while (end > begin && strchr(" \t\r\n", data[end - 1]) && data[end - 1])
+    {
+        end--;
+    }
+    return end - begin >= 2 && data[begin] == '{' && data[end - 1] == '}';
+}
+
+static void fuzz_one(const uint8_t *input, size_t len)
+{
+    // 拷贝到刚好len字节的内存，越界读会被ASan发现
+    char *data = malloc(len ? len : 1);
+    if (!data)
+    {
+        return;
+    }
+    memcpy(data, input, len);
+
+    gree_state_t state = s_initial;
+    ir_gree_cmd_opts_t opts = s_initial_opts;
+    ir_gree_cmd_err_t err = ir_gree_cmd_parse(data, len, &state, &opts);
+    if (err != IR_GREE_CMD_OK)
+    {
+        CHECK(err == IR_GREE_CMD_ERR_FORMAT || err == IR_GREE_CMD_ERR_RANGE, "unexpected error %d", err);
+        CHECK(memcmp(&state, &s_initial, sizeof(state)) == 0, "state changed on error %d", err);
+        CHECK(memcmp(&opts, &s_initial_opts, sizeof(opts)) == 0, "opts changed on error %d", err);
+    }
+    else
+    {
+        CHECK(state_in_range(&state), "accepted state out of range");
+        CHECK(opts.repeat <= IR_GREE_CMD_REPEAT_MAX && opts.gap_ms <= IR_GREE_CMD_GAP_MAX_MS,
+              "accepted opts out of range: repeat %u gap %u", opts.repeat, opts.gap_ms);
+        if (len >= 2 && data[0] == IR_GREE_CMD_MAGIC)
+        {
+            CHECK((data[1] == IR_GREE_CMD_VERSION && len == IR_GREE_CMD_BINARY_SIZE) ||
+                      (data[1] == IR_GREE_CMD_VERSION_2 && len == IR_GREE_CMD_BINARY_V2_SIZE),
+                  "accepted binary command of version %d and %zu bytes", data[1], len);
+        }
+        else
+        {
+            CHECK(json_braced(input, len), "accepted JSON command that is not an object");
+        }
+
+        // 写回JSON再解析，得到同样的状态
+        char json[160];
+        int json_len = ir_gree_cmd_format(&state, IR_GREE_CMD_STATE_ALL, json, sizeof(json));
+        gree_state_t again = {0};
+        CHECK(json_len > 0 && (size_t)json_len < sizeof(json) &&
+                  ir_gree_cmd_parse(json, json_len, &again, NULL) == IR_GREE_CMD_OK &&
+                  memcmp(&again, &state, sizeof(state)) == 0,
+              "formatted state does not parse back: %s", json);
+    }
+
+    const char *value;
+    size_t value_len;
+    if (ir_gree_cmd_lookup(data, len, "id", &value, &value_len))
+    {
+        CHECK(value >= data && value + value_len <= data + len, "lookup value outside the input");
+    }
+
+    ir_gree_sched_t sched = {0};
+    if (ir_gree_sched_parse(data, len, &sched) == IR_GREE_SCHED_OK)
+    {
+        CHECK(sched.len == len && len <= IR_GREE_SCHED_CMD_MAX && memcmp(sched.cmd, data, len) == 0,
+              "schedule keeps %u of %zu bytes", sched.len, len);
+        CHECK(sched.id[0] && sched.minute < 24 * 60 && sched.days && !(sched.days & ~IR_GREE_SCHED_ALL_DAYS),
+              "accepted schedule out of range");
+    }
+    free(data);
+}
+
+#ifdef IR_GREE_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len)
+{
+    fuzz_one(data, len);
+    if (s_failures)
+    {
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+// 取第index个种子
+static size_t fuzz_seed(size_t index, uint8_t *buf)
+{
+    size_t json_num = sizeof(s_json_seeds) / sizeof(s_json_seeds[0]);
+    if (index < json_num)
+    {
+        size_t len = strlen(s_json_seeds[index]);
+        memcpy(buf, s_json_seeds[index], len);
+        return len;
+    }
+    index -= json_num;
+    memcpy(buf, s_binary_seeds[index], s_binary_seed_len[index]);
+    return s_binary_seed_len[index];
+}
+
+// 对buf做1~4次随机变异，返回新的长度
+static size_t fuzz_mutate(uint8_t *buf, size_t len)
+{
+    // 偏向JSON和二进制格式中有意义的字节
+    static const char s_dict[] = "{}\":, \\0123456789aeflnrstuG\x01\x02\xff";
+    int count = 1 + fuzz_random() % 4;
+    for (int i = 0; i < count; i++)
+    {
+        size_t pos = len ? fuzz_random() % len : 0;
+        uint8_t byte = fuzz_random() % 2 ? (uint8_t)s_dict[fuzz_random() % (sizeof(s_dict) - 1)] : fuzz_random();
+        switch (fuzz_random() % 6)
+        {
+        case 0:
+            if (len)
+            {
+                buf[pos] ^= 1 << (fuzz_random() % 8);
+            }
+            break;
+        case 1:
+            if (len)
+            {
+                buf[pos] = byte;
+            }
+            break;
+        case 2:
+            if (len < FUZZ_MAX_LEN)
+            {
+                memmove(buf + pos + 1, buf + pos, len - pos);
+                buf[pos] = byte;
+                len++;
+            }
+            break;
+        case 3:
+            if (len)
+            {
+                memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                len--;
+            }
+            break;
+        case 4:
+            len = pos;
+            break;
+        default:
+        {
+            // 拼上另一个种子的后半段
+            uint8_t other[FUZZ_MAX_LEN];
+            size_t other_len = fuzz_seed(fuzz_random() % FUZZ_SEED_NUM, other);
+            size_t from = fuzz_random() % (other_len + 1);
+            size_t n = other_len - from;
+            if (pos + n > FUZZ_MAX_LEN)
+            {
+                n = FUZZ_MAX_LEN - pos;
+            }
+            memcpy(buf + pos, other + from, n);
+            len = pos + n;
+            break;
+        }
+        }
+    }
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = 200000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--iterations") == 0)
+        {
+            iterations = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            s_rng = strtoul(argv[i + 1], NULL, 0);
+        }
+    }
+    if (iterations <= 0 || s_rng == 0 || argc % 2 == 0)
+    {
+        fprintf(stderr, "usage: %s [--iterations N] [--seed N]\n", argv[0]);
+        return 2;
+    }
+
+    for (size_t i = 0; i < sizeof(s_bad) / sizeof(s_bad[0]); i++)
+    {
+        size_t len = s_bad[i].len ? s_bad[i].len : strlen(s_bad[i].data);
+        gree_state_t state = s_initial;
+        CHECK(ir_gree_cmd_parse(s_bad[i].data, len, &state, NULL) != IR_GREE_CMD_OK, "bad command %zu accepted", i);
+        fuzz_one((const uint8_t *)s_bad[i].data, len);
+    }
+
+    uint8_t buf[FUZZ_MAX_LEN];
+    size_t seed_ok = 0;
+    for (size_t i = 0; i < FUZZ_SEED_NUM; i++)
+    {
+        size_t len = fuzz_seed(i, buf);
+        gree_state_t state = s_initial;
+        seed_ok += ir_gree_cmd_parse((const char *)buf, len, &state, NULL) == IR_GREE_CMD_OK;
+        fuzz_one(buf, len);
+    }
+    CHECK(seed_ok == FUZZ_SEED_NUM, "%zu of %zu seeds accepted", seed_ok, (size_t)FUZZ_SEED_NUM);
+
+    long accepted = 0;
+    for (long n = 0; n < iterations && s_failures < 20; n++)
+    {
+        size_t len = fuzz_seed(fuzz_random() % FUZZ_SEED_NUM, buf);
+        len = fuzz_mutate(buf, len);
+        gree_state_t state = s_initial;
+        accepted += ir_gree_cmd_parse((const char *)buf, len, &state, NULL) == IR_GREE_CMD_OK;
+        fuzz_one(buf, len);
+    }
+
+    printf("%ld inputs, %ld accepted, %d failures\n", iterations, accepted, s_failures);
+    return s_failures ? 1 : 0;
+}
+
+#endif
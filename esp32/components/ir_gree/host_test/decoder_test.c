@@ -0,0 +1,321 @@
+/*
+ * 解码器的主机测试，输入ir_gree_packed_render渲染的mark/space序列
+ *
+ *   完整的帧，以及在长连接码处被接收超时分成两段的帧，解出的扫描码与渲染的相同
+ *   接收头把mark拉长或缩短、周期在窗口内抖动时仍能解出
+ *   在任意位置截断（最后一个周期没有下降沿）、插入无效周期或者在帧中间重新开始时
+ *   不输出错误的帧，之后的完整帧照常解出
+ *   长连接码之后不是引导码时丢弃前半帧，后半帧不会拼到前半帧上
+ *
+ * 前半帧出错时，后半帧与在长连接码处分段的前半帧没有区别，解码器会把下一个引导码当作后半帧的开始。
+ * 这种情况由接收任务在IR_RX_FRAME_TIMEOUT_US的空闲后重新初始化解码器，测试中在下一帧之前同样初始化
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_gree_decoder.h"
+
+#define TEST_RANDOM_FRAMES 200
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            s_failures++;                               \
+        }                                               \
+    } while (0)
+
+// 与frame_test.c相同，最初的Arduino程序发送的扫描码
+static const ir_gree_scan_code_t s_arduino = {0x50200900, 0x30000000, 0x70200900, 0x30000000};
+
+static uint32_t s_rng = 1;
+
+static uint32_t test_random(void)
+{
+    // xorshift32
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static size_t test_render(const ir_gree_scan_code_t *scan_code, ir_gree_pulse_t *pulses)
+{
+    ir_gree_packed_t packed;
+    ir_gree_pack(scan_code, &packed);
+    size_t n = ir_gree_packed_render(&packed, pulses);
+    CHECK(n == IR_GREE_FRAME_PULSES, "rendered %zu pulses", n);
+    return n;
+}
+
+typedef struct
+{
+    int frames;
+    size_t last; // 最后一帧在这次输入的第几个周期解出
+    ir_gree_scan_code_t scan_code;
+} test_result_t;
+
+static void test_feed(ir_gree_decoder_t *decoder, const ir_gree_pulse_t *pulses, size_t n, test_result_t *result)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        ir_gree_scan_code_t scan_code;
+        if (ir_gree_decoder_feed(decoder, pulses[i].mark, pulses[i].space, &scan_code))
+        {
+            result->frames++;
+            result->last = i;
+            result->scan_code = scan_code;
+        }
+    }
+}
+
+static bool test_equal(const ir_gree_scan_code_t *a, const ir_gree_scan_code_t *b)
+{
+    return a->data1 == b->data1 && a->data2 == b->data2 && a->data3 == b->data3 && a->data4 == b->data4;
+}
+
+// 解出一帧，扫描码与渲染的相同。最后一位的周期结束于结束码的下降沿，在最后一位解出
+static void test_expect_frame(const char *what, const test_result_t *result, const ir_gree_scan_code_t *expect)
+{
+    CHECK(result->frames == 1, "%s: %d frames", what, result->frames);
+    CHECK(result->last == IR_GREE_FRAME_PULSES - 2, "%s: frame at pulse %zu", what, result->last);
+    CHECK(test_equal(&result->scan_code, expect), "%s: %08x %08x %08x %08x, expected %08x %08x %08x %08x", what,
+          (unsigned)result->scan_code.data1, (unsigned)result->scan_code.data2, (unsigned)result->scan_code.data3,
+          (unsigned)result->scan_code.data4, (unsigned)expect->data1, (unsigned)expect->data2, (unsigned)expect->data3,
+          (unsigned)expect->data4);
+}
+
+// 长连接码在第几个周期
+static size_t test_long_connect(const ir_gree_pulse_t *pulses, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (pulses[i].space == IR_GREE_LONG_CONNECT_SPACE_US)
+        {
+            return i;
+        }
+    }
+    CHECK(false, "no long connect");
+    return 0;
+}
+
+static void test_clean(const ir_gree_scan_code_t *scan_code)
+{
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(scan_code, pulses);
+    ir_gree_decoder_t decoder;
+    test_result_t result = {0};
+    ir_gree_decoder_init(&decoder, NULL);
+    test_feed(&decoder, pulses, n, &result);
+    test_expect_frame("clean", &result, scan_code);
+
+    // 40ms的长连接码超过接收超时，前半帧的最后一个周期没有下降沿
+    pulses[test_long_connect(pulses, n)].space = 0;
+    memset(&result, 0, sizeof(result));
+    test_feed(&decoder, pulses, n, &result);
+    test_expect_frame("split", &result, scan_code);
+
+    // 连续两帧
+    memset(&result, 0, sizeof(result));
+    test_feed(&decoder, pulses, n, &result);
+    test_feed(&decoder, pulses, n, &result);
+    CHECK(result.frames == 2 && test_equal(&result.scan_code, scan_code), "repeated: %d frames", result.frames);
+}
+
+// 接收头输出的mark比发射的长或者短，space相应变化，周期不变；周期再随机抖动，不超出窗口
+static void test_jitter(const ir_gree_scan_code_t *scan_code)
+{
+    static const int s_stretch[] = {-200, -100, 0, 100, 200};
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(scan_code, pulses);
+    for (size_t s = 0; s < sizeof(s_stretch) / sizeof(s_stretch[0]); s++)
+    {
+        ir_gree_pulse_t jittered[IR_GREE_FRAME_PULSES];
+        for (size_t i = 0; i < n; i++)
+        {
+            int jitter = (int)(test_random() % 201) - 100;
+            jittered[i].mark = pulses[i].mark + s_stretch[s];
+            jittered[i].space = pulses[i].space ? pulses[i].space - s_stretch[s] + jitter : 0;
+        }
+        ir_gree_decoder_t decoder;
+        test_result_t result = {0};
+        ir_gree_decoder_init(&decoder, NULL);
+        test_feed(&decoder, jittered, n, &result);
+        test_expect_frame("jitter", &result, scan_code);
+    }
+}
+
+// 在第cut个周期截断，这个周期后面没有下降沿，接着是一帧完整的
+static void test_truncated(const ir_gree_scan_code_t *first, const ir_gree_scan_code_t *second)
+{
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    ir_gree_pulse_t next[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(first, pulses);
+    test_render(second, next);
+    size_t long_connect = test_long_connect(pulses, n);
+    for (size_t cut = 0; cut + 1 < n; cut++)
+    {
+        // 在长连接码处截断与接收超时分段完全相同，下一个引导码被当作后半帧的开始
+        if (cut == long_connect)
+        {
+            continue;
+        }
+        ir_gree_decoder_t decoder;
+        test_result_t result = {0};
+        ir_gree_pulse_t saved = pulses[cut];
+        ir_gree_decoder_init(&decoder, NULL);
+        pulses[cut].space = 0;
+        test_feed(&decoder, pulses, cut + 1, &result);
+        pulses[cut] = saved;
+        CHECK(result.frames == 0, "cut %zu: frame from a truncated stream", cut);
+        test_feed(&decoder, next, n, &result);
+        char what[32];
+        snprintf(what, sizeof(what), "cut %zu", cut);
+        test_expect_frame(what, &result, second);
+    }
+}
+
+// 在第at个周期之前插入一个周期
+static void test_insert(const ir_gree_scan_code_t *scan_code, const ir_gree_scan_code_t *second, uint16_t mark, uint16_t space,
+                        const char *name)
+{
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES + 1];
+    ir_gree_pulse_t next[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(scan_code, pulses);
+    size_t long_connect = test_long_connect(pulses, n);
+    test_render(second, next);
+    // 结束码之前插入时整帧已经解出
+    for (size_t at = 1; at + 1 < n; at++)
+    {
+        ir_gree_pulse_t stream[IR_GREE_FRAME_PULSES + 1];
+        memcpy(stream, pulses, at * sizeof(stream[0]));
+        stream[at] = (ir_gree_pulse_t){mark, space};
+        memcpy(stream + at + 1, pulses + at, (n - at) * sizeof(stream[0]));
+
+        ir_gree_decoder_t decoder;
+        test_result_t result = {0};
+        ir_gree_decoder_init(&decoder, NULL);
+        test_feed(&decoder, stream, n + 1, &result);
+        CHECK(result.frames == 0, "%s at %zu: frame from a corrupted stream", name, at);
+        // 后半帧被当作前半帧，等接收任务的空闲超时
+        if (at <= long_connect + 1)
+        {
+            ir_gree_decoder_init(&decoder, NULL);
+        }
+        test_feed(&decoder, next, n, &result);
+        char what[48];
+        snprintf(what, sizeof(what), "%s at %zu", name, at);
+        test_expect_frame(what, &result, second);
+    }
+}
+
+// 帧中间收到引导码时从头开始，前面收到的丢弃
+static void test_restart(const ir_gree_scan_code_t *first, const ir_gree_scan_code_t *second)
+{
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    ir_gree_pulse_t next[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(first, pulses);
+    test_render(second, next);
+    size_t long_connect = test_long_connect(pulses, n);
+    for (size_t cut = 1; cut + 1 < n; cut++)
+    {
+        // 刚收完长连接码时的引导码就是后半帧的开始
+        if (cut == long_connect + 1)
+        {
+            continue;
+        }
+        ir_gree_decoder_t decoder;
+        test_result_t result = {0};
+        ir_gree_decoder_init(&decoder, NULL);
+        test_feed(&decoder, pulses, cut, &result);
+        test_feed(&decoder, next, n, &result);
+        char what[32];
+        snprintf(what, sizeof(what), "restart %zu", cut);
+        test_expect_frame(what, &result, second);
+    }
+}
+
+// 长连接码之后、后半帧的引导码之前出现别的周期，整帧丢弃
+static void test_leader_resync(const ir_gree_scan_code_t *scan_code)
+{
+    static const ir_gree_pulse_t s_noise[] = {
+        {IR_GREE_ZERO_MARK_US, IR_GREE_ZERO_SPACE_US},
+        {IR_GREE_ONE_MARK_US, IR_GREE_ONE_SPACE_US},
+        {IR_GREE_CONNECT_MARK_US, IR_GREE_CONNECT_SPACE_US},
+        {IR_GREE_LONG_CONNECT_MARK_US, IR_GREE_LONG_CONNECT_SPACE_US},
+        {300, 300},
+        {IR_GREE_END_MARK_US, 0},
+    };
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(scan_code, pulses);
+    size_t half = test_long_connect(pulses, n) + 1;
+    for (size_t i = 0; i < sizeof(s_noise) / sizeof(s_noise[0]); i++)
+    {
+        ir_gree_decoder_t decoder;
+        test_result_t result = {0};
+        ir_gree_decoder_init(&decoder, NULL);
+        test_feed(&decoder, pulses, half, &result);
+        test_feed(&decoder, &s_noise[i], 1, &result);
+        test_feed(&decoder, pulses + half, n - half, &result);
+        CHECK(result.frames == 0, "noise %zu after the long connect: second half joined to the first", i);
+        ir_gree_decoder_init(&decoder, NULL);
+        test_feed(&decoder, pulses, n, &result);
+        test_expect_frame("after noise", &result, scan_code);
+    }
+}
+
+// 窗口为开区间
+static void test_windows(void)
+{
+    const ir_gree_windows_t *w = &ir_gree_default_windows;
+    CHECK(ir_gree_classify(w, w->zero.min) == IR_GREE_SYM_INVALID, "zero min");
+    CHECK(ir_gree_classify(w, w->zero.min + 1) == IR_GREE_SYM_ZERO, "zero min + 1");
+    CHECK(ir_gree_classify(w, w->one.max - 1) == IR_GREE_SYM_ONE, "one max - 1");
+    CHECK(ir_gree_classify(w, w->one.max) == IR_GREE_SYM_INVALID, "one max");
+    CHECK(ir_gree_classify(w, IR_GREE_LEADER_MARK_US + IR_GREE_LEADER_SPACE_US) == IR_GREE_SYM_LEADER, "leader");
+    CHECK(ir_gree_classify(w, IR_GREE_CONNECT_MARK_US + IR_GREE_CONNECT_SPACE_US) == IR_GREE_SYM_CONNECT, "connect");
+    CHECK(ir_gree_classify(w, IR_GREE_LONG_CONNECT_MARK_US + IR_GREE_LONG_CONNECT_SPACE_US) == IR_GREE_SYM_LONG_CONNECT, "long connect");
+
+    // 一个周期刚好落在窗口边界上，整帧丢弃
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    size_t n = test_render(&s_arduino, pulses);
+    pulses[1].space = w->zero.min - pulses[1].mark;
+    ir_gree_decoder_t decoder;
+    test_result_t result = {0};
+    ir_gree_decoder_init(&decoder, NULL);
+    test_feed(&decoder, pulses, n, &result);
+    CHECK(result.frames == 0, "period on the window edge accepted");
+}
+
+int main(void)
+{
+    ir_gree_scan_code_t codes[TEST_RANDOM_FRAMES + 2] = {s_arduino, {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}};
+    for (size_t i = 2; i < TEST_RANDOM_FRAMES + 2; i++)
+    {
+        codes[i] = (ir_gree_scan_code_t){test_random(), test_random(), test_random(), test_random()};
+    }
+
+    test_windows();
+    for (size_t i = 0; i < TEST_RANDOM_FRAMES + 2; i++)
+    {
+        test_clean(&codes[i]);
+        test_jitter(&codes[i]);
+    }
+    test_truncated(&s_arduino, &codes[2]);
+    test_truncated(&codes[3], &codes[1]);
+    test_insert(&s_arduino, &codes[4], 300, 300, "glitch");
+    test_insert(&s_arduino, &codes[4], IR_GREE_END_MARK_US, 0, "timeout");
+    test_restart(&s_arduino, &codes[5]);
+    test_leader_resync(&s_arduino);
+    test_leader_resync(&codes[6]);
+
+    printf("%d failures\n", s_failures);
+    return s_failures ? 1 : 0;
+}
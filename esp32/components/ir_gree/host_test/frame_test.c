@@ -0,0 +1,311 @@
+/*
+ * 扫描码 → 打包帧 → mark/space序列的金标准测试
+ *
+ * 参考帧来自最初的Arduino程序（arduino/38khz/38khz.ino的first/second/third/four数组），
+ * 那里逐位写出了扫描码0x50200900 0x30000000 0x70200900 0x30000000，35位段的后3位为010。
+ * 按它的发送顺序拼出整帧，与ir_gree_frame_render、ir_gree_packed_render和ir_gree_packed_next的结果逐个比较。
+ * 当时1的空闲写的是1640us，协议描述中定为1680us，时长统一用ir_gree_protocol.h中的值
+ *
+ * 状态与扫描码的转换：每个字段取最小值和最大值打包再解包，两个手算了校验和的扫描码，
+ * 超出范围的温度和定时取边界，校验和不对时解包失败
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_gree_frame.h"
+#include "ir_gree_state.h"
+
+static const uint8_t s_first[35] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0};
+static const uint8_t s_second[32] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0};
+static const uint8_t s_third[35] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 1, 0};
+static const uint8_t s_four[32] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0};
+
+static const ir_gree_scan_code_t s_scan_code = {0x50200900, 0x30000000, 0x70200900, 0x30000000};
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)               \
+    do                                 \
+    {                                  \
+        if (!(cond))                   \
+        {                              \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);       \
+            printf("\n");              \
+            s_failures++;              \
+        }                              \
+    } while (0)
+
+static size_t add(ir_gree_pulse_t *pulses, size_t n, uint16_t mark, uint16_t space)
+{
+    pulses[n].mark = mark;
+    pulses[n].space = space;
+    return n + 1;
+}
+
+static size_t add_bits(ir_gree_pulse_t *pulses, size_t n, const uint8_t *bits, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        n = bits[i] ? add(pulses, n, IR_GREE_ONE_MARK_US, IR_GREE_ONE_SPACE_US) : add(pulses, n, IR_GREE_ZERO_MARK_US, IR_GREE_ZERO_SPACE_US);
+    }
+    return n;
+}
+
+// 与Arduino程序的loop()相同的顺序
+static size_t build_golden(ir_gree_pulse_t *pulses)
+{
+    size_t n = 0;
+    n = add(pulses, n, IR_GREE_LEADER_MARK_US, IR_GREE_LEADER_SPACE_US);
+    n = add_bits(pulses, n, s_first, sizeof(s_first));
+    n = add(pulses, n, IR_GREE_CONNECT_MARK_US, IR_GREE_CONNECT_SPACE_US);
+    n = add_bits(pulses, n, s_second, sizeof(s_second));
+    n = add(pulses, n, IR_GREE_LONG_CONNECT_MARK_US, IR_GREE_LONG_CONNECT_SPACE_US);
+    n = add(pulses, n, IR_GREE_LEADER_MARK_US, IR_GREE_LEADER_SPACE_US);
+    n = add_bits(pulses, n, s_third, sizeof(s_third));
+    n = add(pulses, n, IR_GREE_CONNECT_MARK_US, IR_GREE_CONNECT_SPACE_US);
+    n = add_bits(pulses, n, s_four, sizeof(s_four));
+    n = add(pulses, n, IR_GREE_END_MARK_US, 0);
+    return n;
+}
+
+static void compare(const char *what, const ir_gree_pulse_t *pulses, size_t count, const ir_gree_pulse_t *golden, size_t golden_count)
+{
+    CHECK(count == golden_count, "%s: %zu pulses, expected %zu", what, count, golden_count);
+    for (size_t i = 0; i < count && i < golden_count; i++)
+    {
+        CHECK(pulses[i].mark == golden[i].mark && pulses[i].space == golden[i].space,
+              "%s: pulse %zu is %u/%u, expected %u/%u", what, i, pulses[i].mark, pulses[i].space, golden[i].mark, golden[i].space);
+    }
+}
+
+// 35位段后3位是010，两个35位段后是短连接码，第一个32位段后是长连接码
+static void check_structure(const ir_gree_pulse_t *pulses)
+{
+    static const size_t tails[] = {1 + 32, 1 + 35 + 1 + 32 + 1 + 1 + 32};
+    for (size_t i = 0; i < sizeof(tails) / sizeof(tails[0]); i++)
+    {
+        CHECK(pulses[tails[i]].space == IR_GREE_ZERO_SPACE_US && pulses[tails[i] + 1].space == IR_GREE_ONE_SPACE_US &&
+                  pulses[tails[i] + 2].space == IR_GREE_ZERO_SPACE_US,
+              "tail bits at %zu are not 010", tails[i]);
+        CHECK(pulses[tails[i] + 3].space == IR_GREE_CONNECT_SPACE_US, "no connect gap after tail at %zu", tails[i]);
+    }
+    CHECK(pulses[1 + 35 + 1 + 32].space == IR_GREE_LONG_CONNECT_SPACE_US, "no long connect gap after segment 2");
+    CHECK(pulses[IR_GREE_FRAME_PULSES - 1].space == 0, "end mark has a space");
+}
+
+static bool state_equal(const gree_state_t *a, const gree_state_t *b)
+{
+    return a->power == b->power && a->mode == b->mode && a->temperature == b->temperature && a->fan == b->fan &&
+           a->swing == b->swing && a->light == b->light && a->turbo == b->turbo && a->sleep == b->sleep && a->timer == b->timer;
+}
+
+static void print_state(const char *what, const gree_state_t *state)
+{
+    printf("  %s: power %u mode %u temp %u fan %u swing %u light %u turbo %u sleep %u timer %u\n", what, state->power, state->mode,
+           state->temperature, state->fan, state->swing, state->light, state->turbo, state->sleep, state->timer);
+}
+
+static void check_state_roundtrip(const char *what, const gree_state_t *state, const gree_state_t *expect)
+{
+    ir_gree_scan_code_t scan_code;
+    gree_state_t unpacked;
+    gree_state_pack(state, &scan_code);
+    bool ok = gree_state_unpack(&scan_code, &unpacked);
+    CHECK(ok, "%s: checksum of the packed state does not match", what);
+    CHECK(ok && state_equal(&unpacked, expect), "%s: unpacked state differs", what);
+    if (ok && !state_equal(&unpacked, expect))
+    {
+        print_state("unpacked", &unpacked);
+        print_state("expected", expect);
+    }
+    // 两个数据块只有字节3和校验和不同
+    CHECK(((scan_code.data1 ^ scan_code.data3) & 0x0FFFFFFF) == 0 && scan_code.data2 << 4 == scan_code.data4 << 4,
+          "%s: blocks differ: %08x %08x %08x %08x", what, (unsigned)scan_code.data1, (unsigned)scan_code.data2, (unsigned)scan_code.data3,
+          (unsigned)scan_code.data4);
+}
+
+// 每个字段单独取最小值和最大值，其余字段为基准值；再全部取最小值、全部取最大值
+static void check_state_fields(void)
+{
+    static const gree_state_t s_base = {
+        .power = 1, .mode = GREE_MODE_COOL, .temperature = 24, .fan = GREE_FAN_LOW, .timer = 3,
+    };
+    static const gree_state_t s_min = {
+        .power = 0, .mode = GREE_MODE_AUTO, .temperature = GREE_TEMP_MIN, .fan = GREE_FAN_AUTO, .swing = 0,
+        .light = 0, .turbo = 0, .sleep = 0, .timer = 0,
+    };
+    static const gree_state_t s_max = {
+        .power = 1, .mode = GREE_MODE_HEAT, .temperature = GREE_TEMP_MAX, .fan = GREE_FAN_HIGH, .swing = 1,
+        .light = 1, .turbo = 1, .sleep = 1, .timer = GREE_TIMER_MAX,
+    };
+    static const struct
+    {
+        const char *name;
+        size_t offset;
+    } s_fields[] = {
+        {"power", offsetof(gree_state_t, power)}, {"mode", offsetof(gree_state_t, mode)},
+        {"temperature", offsetof(gree_state_t, temperature)}, {"fan", offsetof(gree_state_t, fan)},
+        {"swing", offsetof(gree_state_t, swing)}, {"light", offsetof(gree_state_t, light)},
+        {"turbo", offsetof(gree_state_t, turbo)}, {"sleep", offsetof(gree_state_t, sleep)},
+        {"timer", offsetof(gree_state_t, timer)},
+    };
+    for (size_t i = 0; i < sizeof(s_fields) / sizeof(s_fields[0]); i++)
+    {
+        const gree_state_t *bounds[] = {&s_min, &s_max};
+        for (size_t b = 0; b < 2; b++)
+        {
+            gree_state_t state = s_base;
+            ((uint8_t *)&state)[s_fields[i].offset] = ((const uint8_t *)bounds[b])[s_fields[i].offset];
+            char what[32];
+            snprintf(what, sizeof(what), "%s %s", s_fields[i].name, b ? "max" : "min");
+            check_state_roundtrip(what, &state, &state);
+        }
+    }
+    check_state_roundtrip("all min", &s_min, &s_min);
+    check_state_roundtrip("all max", &s_max, &s_max);
+
+    // 定时的每个值，半小时位、个位和十位
+    for (uint8_t timer = 0; timer <= GREE_TIMER_MAX; timer++)
+    {
+        gree_state_t state = s_base;
+        state.timer = timer;
+        check_state_roundtrip("timer", &state, &state);
+    }
+}
+
+// 校验和按字节0~3的低4位、字节4~6的高4位加10手算
+static void check_state_golden(void)
+{
+    // Arduino程序发送的帧：关机，自动，25度，灯光
+    const gree_state_t arduino = {.power = 0, .mode = GREE_MODE_AUTO, .temperature = 25, .light = 1};
+    ir_gree_scan_code_t scan_code;
+    gree_state_pack(&arduino, &scan_code);
+    CHECK(memcmp(&scan_code, &s_scan_code, sizeof(scan_code)) == 0, "arduino state packs to %08x %08x %08x %08x",
+          (unsigned)scan_code.data1, (unsigned)scan_code.data2, (unsigned)scan_code.data3, (unsigned)scan_code.data4);
+    gree_state_t unpacked;
+    CHECK(gree_state_unpack(&s_scan_code, &unpacked) && state_equal(&unpacked, &arduino), "arduino frame unpacks to another state");
+
+    // 字节0 = 1 | 1 << 3 | 2 << 4 | 1 << 6 | 1 << 7 = E9，字节1 = 10 | 1 << 4 | 1 << 7 = 9A，字节2 = 2 | 1 << 4 | 1 << 5 = 32，
+    // 字节4 = 01，校验和 = 10 + 9 + A + 2 + 0 = 31，低4位为F
+    const gree_state_t full = {
+        .power = 1, .mode = GREE_MODE_COOL, .temperature = 26, .fan = GREE_FAN_MEDIUM, .swing = 1,
+        .light = 1, .turbo = 1, .sleep = 1, .timer = 5,
+    };
+    const ir_gree_scan_code_t expect = {0x50329AE9, 0xF0000001, 0x70329AE9, 0xF0000001};
+    gree_state_pack(&full, &scan_code);
+    CHECK(memcmp(&scan_code, &expect, sizeof(scan_code)) == 0, "full state packs to %08x %08x %08x %08x", (unsigned)scan_code.data1,
+          (unsigned)scan_code.data2, (unsigned)scan_code.data3, (unsigned)scan_code.data4);
+
+    const uint8_t block[8] = {0xE9, 0x9A, 0x32, 0x50, 0x01, 0x00, 0x00, 0x00};
+    CHECK(gree_checksum(block) == 0xF0, "checksum %02x", gree_checksum(block));
+}
+
+// 温度和定时超出范围时取边界，不按位截断成范围内的另一个值
+static void check_state_clamp(void)
+{
+    static const struct
+    {
+        uint8_t temperature;
+        uint8_t timer;
+        uint8_t expect_temperature;
+        uint8_t expect_timer;
+    } s_cases[] = {
+        {0, 0, GREE_TEMP_MIN, 0},
+        {GREE_TEMP_MIN - 1, GREE_TIMER_MAX + 1, GREE_TEMP_MIN, GREE_TIMER_MAX},
+        {GREE_TEMP_MAX + 1, 80, GREE_TEMP_MAX, GREE_TIMER_MAX},
+        {GREE_TEMP_MIN + 16, 200, GREE_TEMP_MAX, GREE_TIMER_MAX},
+        {255, 255, GREE_TEMP_MAX, GREE_TIMER_MAX},
+    };
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++)
+    {
+        gree_state_t state = {.power = 1, .mode = GREE_MODE_COOL, .temperature = s_cases[i].temperature, .timer = s_cases[i].timer};
+        gree_state_t expect = state;
+        expect.temperature = s_cases[i].expect_temperature;
+        expect.timer = s_cases[i].expect_timer;
+        char what[32];
+        snprintf(what, sizeof(what), "clamp %u/%u", s_cases[i].temperature, s_cases[i].timer);
+        check_state_roundtrip(what, &state, &expect);
+    }
+}
+
+// 参与校验的任何一位不对时解包失败，state不变
+static void check_state_bad_checksum(void)
+{
+    for (int bit = 0; bit < 64; bit++)
+    {
+        // 字节7的低4位不参与校验
+        if (bit >= 56 && bit < 60)
+        {
+            continue;
+        }
+        ir_gree_scan_code_t scan_code = s_scan_code;
+        if (bit < 32)
+        {
+            scan_code.data1 ^= 1UL << bit;
+        }
+        else
+        {
+            scan_code.data2 ^= 1UL << (bit - 32);
+        }
+        gree_state_t state = {.temperature = 99};
+        bool ok = gree_state_unpack(&scan_code, &state);
+        // 校验和只加字节0~3的低4位和字节4~6的高4位
+        bool ignored = bit < 32 ? bit % 8 >= 4 : bit % 8 < 4;
+        CHECK(ok == ignored, "bit %d flipped: unpack returned %d", bit, ok);
+        CHECK(ok || state.temperature == 99, "bit %d flipped: state changed on a bad checksum", bit);
+    }
+}
+
+int main(void)
+{
+    ir_gree_pulse_t golden[IR_GREE_FRAME_PULSES + 1];
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES + 1];
+    size_t golden_count = build_golden(golden);
+    CHECK(golden_count == IR_GREE_FRAME_PULSES, "golden frame has %zu pulses", golden_count);
+    check_structure(golden);
+
+    size_t count = ir_gree_frame_render(&s_scan_code, pulses);
+    compare("ir_gree_frame_render", pulses, count, golden, golden_count);
+
+    ir_gree_packed_t packed;
+    ir_gree_pack(&s_scan_code, &packed);
+    count = ir_gree_packed_render(&packed, pulses);
+    compare("ir_gree_packed_render", pulses, count, golden, golden_count);
+
+    // 打包帧的位与数组逐位相同
+    const uint8_t *arrays[] = {s_first, s_second, s_third, s_four};
+    size_t offset = 0;
+    for (int segment = 0; segment < IR_GREE_SEGMENT_NUM; segment++)
+    {
+        for (int bit = 0; bit < ir_gree_segments[segment].bits; bit++, offset++)
+        {
+            CHECK(ir_gree_packed_bit(&packed, offset) == arrays[segment][bit], "packed bit %zu (segment %d bit %d)", offset, segment, bit);
+        }
+    }
+    CHECK(offset == IR_GREE_PACKED_BITS, "packed frame has %zu bits", offset);
+
+    ir_gree_cursor_t cursor = {0};
+    ir_gree_sym_t sym;
+    count = 0;
+    while ((sym = ir_gree_packed_next(&packed, &cursor)) != IR_GREE_SYM_INVALID && count <= IR_GREE_FRAME_PULSES)
+    {
+        pulses[count++] = ir_gree_sym_pulse(sym);
+    }
+    compare("ir_gree_packed_next", pulses, count, golden, golden_count);
+
+    ir_gree_scan_code_t unpacked;
+    ir_gree_unpack(&packed, &unpacked);
+    CHECK(memcmp(&unpacked, &s_scan_code, sizeof(unpacked)) == 0, "unpack gives %08x %08x %08x %08x",
+          (unsigned)unpacked.data1, (unsigned)unpacked.data2, (unsigned)unpacked.data3, (unsigned)unpacked.data4);
+
+    check_state_fields();
+    check_state_golden();
+    check_state_clamp();
+    check_state_bad_checksum();
+
+    printf("%s: %d failures\n", s_failures ? "FAILED" : "OK", s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/*
+ * 状态日志的主机测试，flash用ram_flash模拟
+ *
+ * 按固定的随机序列追加，每一步都和一份内存中的期望状态比较，覆盖：
+ *   空区域挂载、追加后重新挂载、相同状态不写flash
+ *   CRC不对的记录被跳过，恢复为同一设备更早的记录
+ *   扇区写满后整理到另一个扇区，多次轮换
+ *   第N次写失败（没写进去、写了一半、整条写进去但返回错误），之后继续追加，不丢后面的记录
+ *   整理到一半写失败后，设备改回失败前的状态
+ *   第N次写到一半掉电，重新挂载后状态正确，并且可以继续追加
+ * 追加失败的那台设备恢复为旧状态或新状态都算正确
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_gree_journal.h"
+#include "ram_flash.h"
+
+// 每扇区16条记录，很快就要整理
+#define TEST_SECTOR_SIZE 256
+#define TEST_DEVICES 5
+#define TEST_STEPS 300
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            s_failures++;                               \
+        }                                               \
+    } while (0)
+
+// 期望的状态，pending为追加失败、结果不确定的状态
+typedef struct
+{
+    bool valid[TEST_DEVICES];
+    gree_state_t states[TEST_DEVICES];
+    bool pending[TEST_DEVICES];
+    gree_state_t pending_states[TEST_DEVICES];
+} test_model_t;
+
+typedef struct
+{
+    uint8_t device;
+    gree_state_t state;
+} test_step_t;
+
+static test_step_t s_steps[TEST_STEPS];
+
+static uint32_t s_rng = 1;
+
+static uint32_t test_random(void)
+{
+    // xorshift32
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+// 温度只在几个值中取，同一设备经常收到相同的状态
+static void test_make_steps(void)
+{
+    for (int i = 0; i < TEST_STEPS; i++)
+    {
+        s_steps[i].device = test_random() % TEST_DEVICES;
+        s_steps[i].state = (gree_state_t){
+            .power = 1,
+            .mode = GREE_MODE_COOL,
+            .temperature = GREE_TEMP_MIN + test_random() % 3,
+            .fan = test_random() % 2,
+        };
+    }
+}
+
+static bool test_state_eq(const gree_state_t *a, const gree_state_t *b)
+{
+    return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+static void test_model_apply(test_model_t *model, const test_step_t *step, ir_gree_journal_err_t err)
+{
+    if (err == IR_GREE_JOURNAL_OK)
+    {
+        model->valid[step->device] = true;
+        model->states[step->device] = step->state;
+        model->pending[step->device] = false;
+    }
+    else
+    {
+        model->pending[step->device] = true;
+        model->pending_states[step->device] = step->state;
+    }
+}
+
+// 重新挂载，与期望的状态比较
+static void test_check_mount(ram_flash_t *ram, const test_model_t *model, ir_gree_journal_t *journal, const char *what, long at)
+{
+    CHECK(ir_gree_journal_mount(journal, &ram->flash) == IR_GREE_JOURNAL_OK, "%s %ld: mount failed", what, at);
+    for (uint8_t i = 0; i < TEST_DEVICES; i++)
+    {
+        gree_state_t state;
+        bool valid = ir_gree_journal_get(journal, i, &state);
+        bool ok = valid == model->valid[i] && (!valid || test_state_eq(&state, &model->states[i]));
+        if (model->pending[i])
+        {
+            ok = ok || (valid && test_state_eq(&state, &model->pending_states[i]));
+        }
+        CHECK(ok, "%s %ld: device %u restored %s temp %u, expected %s temp %u", what, at, i,
+              valid ? "valid" : "invalid", valid ? state.temperature : 0,
+              model->valid[i] ? "valid" : "invalid", model->states[i].temperature);
+    }
+    CHECK(ram->overwrites == 0, "%s %ld: %u writes over programmed bits", what, at, ram->overwrites);
+}
+
+static void test_empty(void)
+{
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    test_model_t model = {0};
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    test_check_mount(&ram, &model, &journal, "empty", 0);
+    CHECK(journal.seq == 0 && journal.next == 0, "empty: seq %u next %u", journal.seq, journal.next);
+
+    ram_flash_t small;
+    ram_flash_init(&small, TEST_SECTOR_SIZE / 2, IR_GREE_JOURNAL_SECTOR_NUM);
+    CHECK(ir_gree_journal_mount(&journal, &small.flash) == IR_GREE_JOURNAL_ERR_ARG, "small sector accepted");
+    ram_flash_free(&small);
+    ram_flash_free(&ram);
+}
+
+// 正常追加，每一步都重新挂载
+static void test_append(void)
+{
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    ir_gree_journal_t mounted;
+    test_model_t model = {0};
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    ir_gree_journal_mount(&journal, &ram.flash);
+
+    for (int i = 0; i < TEST_STEPS; i++)
+    {
+        long writes = ram.writes;
+        bool same = model.valid[s_steps[i].device] && test_state_eq(&model.states[s_steps[i].device], &s_steps[i].state);
+        ir_gree_journal_err_t err = ir_gree_journal_append(&journal, s_steps[i].device, &s_steps[i].state);
+        CHECK(err == IR_GREE_JOURNAL_OK, "append %d failed: %d", i, err);
+        CHECK(!same || ram.writes == writes, "append %d: same state written", i);
+        test_model_apply(&model, &s_steps[i], err);
+        test_check_mount(&ram, &model, &mounted, "append", i);
+        CHECK(mounted.seq == journal.seq && mounted.sector == journal.sector && mounted.next == journal.next,
+              "append %d: mounted at seq %u sector %d next %u, journal at seq %u sector %d next %u", i,
+              mounted.seq, mounted.sector, mounted.next, journal.seq, journal.sector, journal.next);
+    }
+    CHECK(journal.compactions > 10, "only %u compactions", journal.compactions);
+    CHECK(ram.erases == journal.compactions, "%u erases for %u compactions", ram.erases, journal.compactions);
+    ram_flash_free(&ram);
+}
+
+// 改坏最后一条记录，恢复为同一设备的上一条
+static void test_crc(void)
+{
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    test_model_t model = {0};
+    gree_state_t a = {.power = 1, .temperature = 20};
+    gree_state_t b = {.power = 1, .temperature = 25};
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    ir_gree_journal_mount(&journal, &ram.flash);
+    ir_gree_journal_append(&journal, 0, &a);
+    ir_gree_journal_append(&journal, 1, &a);
+    ir_gree_journal_append(&journal, 0, &b);
+
+    // 第3条记录中温度的一位从1变成0
+    ram.data[2 * IR_GREE_JOURNAL_RECORD_SIZE + 5 + offsetof(gree_state_t, temperature)] &= ~0x01;
+    model.valid[0] = model.valid[1] = true;
+    model.states[0] = model.states[1] = a;
+    test_check_mount(&ram, &model, &journal, "crc", 0);
+    CHECK(journal.next == 3 * IR_GREE_JOURNAL_RECORD_SIZE, "crc: next %u, bad record not skipped", journal.next);
+
+    // 再追加时写在坏记录之后
+    CHECK(ir_gree_journal_append(&journal, 0, &b) == IR_GREE_JOURNAL_OK, "crc: append failed");
+    model.states[0] = b;
+    test_check_mount(&ram, &model, &journal, "crc", 1);
+    ram_flash_free(&ram);
+}
+
+// 整理时设备0的新状态写进去了，之后设备1的记录写失败，设备0再改回旧状态时必须写入
+static void test_failed_compaction(void)
+{
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    test_model_t model = {0};
+    gree_state_t a = {.power = 1, .temperature = 20};
+    gree_state_t b = {.power = 1, .temperature = 25};
+    const uint32_t records = TEST_SECTOR_SIZE / IR_GREE_JOURNAL_RECORD_SIZE;
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    ir_gree_journal_mount(&journal, &ram.flash);
+    ir_gree_journal_append(&journal, 0, &a);
+    for (uint32_t i = 1; i < records; i++)
+    {
+        ir_gree_journal_append(&journal, 1, i % 2 ? &a : &b);
+    }
+    model.valid[0] = model.valid[1] = true;
+    model.states[0] = a;
+    model.states[1] = records % 2 ? b : a;
+
+    // 第records次写是整理时设备0的记录，下一次是设备1的
+    ram.fail_at = records + 1;
+    CHECK(ir_gree_journal_append(&journal, 0, &b) == IR_GREE_JOURNAL_ERR_FLASH, "failed compaction: append succeeded");
+    CHECK(journal.compactions == 1, "failed compaction: %u compactions", journal.compactions);
+    CHECK(ir_gree_journal_append(&journal, 0, &a) == IR_GREE_JOURNAL_OK, "failed compaction: append failed");
+    test_check_mount(&ram, &model, &journal, "failed compaction", 0);
+    ram_flash_free(&ram);
+}
+
+// 第fail_at次写失败，torn_bytes为写进去的字节数，之后继续追加到最后
+static void test_failed_write(long fail_at, size_t torn_bytes)
+{
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    test_model_t model = {0};
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    ram.fail_at = fail_at;
+    ram.torn_bytes = torn_bytes;
+    ir_gree_journal_mount(&journal, &ram.flash);
+
+    for (int i = 0; i < TEST_STEPS / 3; i++)
+    {
+        ir_gree_journal_err_t err = ir_gree_journal_append(&journal, s_steps[i].device, &s_steps[i].state);
+        test_model_apply(&model, &s_steps[i], err);
+    }
+    ir_gree_journal_t mounted;
+    test_check_mount(&ram, &model, &mounted, "failed write", fail_at * 100 + torn_bytes);
+    ram_flash_free(&ram);
+}
+
+// 第fail_at次写到一半掉电，重新挂载后再继续追加
+static void test_power_loss(long fail_at, size_t torn_bytes)
+{
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    test_model_t model = {0};
+    int i = 0;
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    ram.fail_at = fail_at;
+    ram.torn_bytes = torn_bytes;
+    ram.power_loss = true;
+    ir_gree_journal_mount(&journal, &ram.flash);
+
+    for (; i < TEST_STEPS / 3 && !ram.dead; i++)
+    {
+        ir_gree_journal_err_t err = ir_gree_journal_append(&journal, s_steps[i].device, &s_steps[i].state);
+        test_model_apply(&model, &s_steps[i], err);
+    }
+    ram_flash_power_on(&ram);
+    test_check_mount(&ram, &model, &journal, "power loss", fail_at * 100 + torn_bytes);
+
+    for (; i < TEST_STEPS / 3 * 2; i++)
+    {
+        ir_gree_journal_err_t err = ir_gree_journal_append(&journal, s_steps[i].device, &s_steps[i].state);
+        CHECK(err == IR_GREE_JOURNAL_OK, "power loss %ld: append %d after remount failed", fail_at, i);
+        test_model_apply(&model, &s_steps[i], err);
+    }
+    test_check_mount(&ram, &model, &journal, "power loss again", fail_at * 100 + torn_bytes);
+    ram_flash_free(&ram);
+}
+
+int main(void)
+{
+    test_make_steps();
+    test_empty();
+    test_append();
+    test_crc();
+    test_failed_compaction();
+
+    // 前TEST_STEPS / 3步中的每一次写，包括整理时的写
+    ram_flash_t ram;
+    ir_gree_journal_t journal;
+    ram_flash_init(&ram, TEST_SECTOR_SIZE, IR_GREE_JOURNAL_SECTOR_NUM);
+    ir_gree_journal_mount(&journal, &ram.flash);
+    for (int i = 0; i < TEST_STEPS / 3; i++)
+    {
+        ir_gree_journal_append(&journal, s_steps[i].device, &s_steps[i].state);
+    }
+    long writes = ram.writes;
+    CHECK(journal.compactions >= 2, "fault tests cover only %u compactions", journal.compactions);
+    ram_flash_free(&ram);
+
+    static const size_t s_torn[] = {0, 1, 7, IR_GREE_JOURNAL_RECORD_SIZE - 1, IR_GREE_JOURNAL_RECORD_SIZE};
+    for (long n = 0; n < writes; n++)
+    {
+        for (size_t t = 0; t < sizeof(s_torn) / sizeof(s_torn[0]); t++)
+        {
+            test_failed_write(n, s_torn[t]);
+            test_power_loss(n, s_torn[t]);
+        }
+    }
+
+    printf("%ld fault points, %d failures\n", writes, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ram_flash.h"
+
+static int ram_flash_read(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    ram_flash_t *ram = ctx;
+    if (ram->dead || offset + len > ram->size)
+    {
+        return -1;
+    }
+    memcpy(buf, ram->data + offset, len);
+    return 0;
+}
+
+static int ram_flash_write(void *ctx, uint32_t offset, const void *buf, size_t len)
+{
+    ram_flash_t *ram = ctx;
+    const uint8_t *src = buf;
+    if (ram->dead || offset + len > ram->size)
+    {
+        return -1;
+    }
+    bool fail = ram->writes++ == ram->fail_at;
+    if (fail && ram->torn_bytes < len)
+    {
+        len = ram->torn_bytes;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (src[i] & ~ram->data[offset + i])
+        {
+            ram->overwrites++;
+        }
+        ram->data[offset + i] &= src[i];
+    }
+    if (fail)
+    {
+        ram->dead = ram->power_loss;
+        return -1;
+    }
+    return 0;
+}
+
+static int ram_flash_erase(void *ctx, uint32_t offset, size_t len)
+{
+    ram_flash_t *ram = ctx;
+    if (ram->dead || offset % ram->flash.sector_size != 0 || len % ram->flash.sector_size != 0 || offset + len > ram->size)
+    {
+        return -1;
+    }
+    memset(ram->data + offset, 0xFF, len);
+    ram->erases++;
+    return 0;
+}
+
+bool ram_flash_init(ram_flash_t *ram, uint32_t sector_size, uint32_t sector_num)
+{
+    memset(ram, 0, sizeof(*ram));
+    ram->size = sector_size * sector_num;
+    ram->data = malloc(ram->size);
+    if (!ram->data)
+    {
+        return false;
+    }
+    memset(ram->data, 0xFF, ram->size);
+    ram->fail_at = -1;
+    ram->flash = (ir_gree_flash_t){
+        .read = ram_flash_read,
+        .write = ram_flash_write,
+        .erase = ram_flash_erase,
+        .ctx = ram,
+        .sector_size = sector_size,
+    };
+    return true;
+}
+
+void ram_flash_free(ram_flash_t *ram)
+{
+    free(ram->data);
+    ram->data = NULL;
+}
+
+void ram_flash_power_on(ram_flash_t *ram)
+{
+    ram->dead = false;
+    ram->fail_at = -1;
+}
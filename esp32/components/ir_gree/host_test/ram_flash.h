@@ -0,0 +1,42 @@
+/*
+ * 用内存模拟日志区域的flash，行为同NOR flash：写只能把1变成0，擦除把整个扇区写成0xFF
+ *
+ * 可以让第N次写失败，失败时只写进去记录的前几个字节，用于模拟：
+ *   写失败：返回错误，之后的读写正常
+ *   掉电：写到一半后所有操作都失败，直到重新ram_flash_power_on
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ir_gree_journal.h"
+
+typedef struct
+{
+    uint8_t *data;
+    uint32_t size;
+    ir_gree_flash_t flash;
+    // 写操作的计数，等于fail_at的那次失败，-1为不失败
+    long writes;
+    long fail_at;
+    size_t torn_bytes; // 失败时写进去的字节数，等于记录长度时整条写进去了但仍然返回错误
+    bool power_loss;   // 失败后是否掉电
+    bool dead;
+    uint32_t erases;
+    uint32_t overwrites; // 试图把0写回1的次数，日志正常时应为0
+} ram_flash_t;
+
+/**
+ * 分配sector_num个扇区并擦除
+ */
+bool ram_flash_init(ram_flash_t *ram, uint32_t sector_size, uint32_t sector_num);
+
+void ram_flash_free(ram_flash_t *ram);
+
+/**
+ * 重新上电，清除掉电状态和失败设置
+ */
+void ram_flash_power_on(ram_flash_t *ram);
@@ -0,0 +1,240 @@
+/*
+ * 定时命令的主机测试
+ *
+ *   解析：省略的字段取默认值，各种出错的返回值，出错时sched不变
+ *   下一次执行：星期掩码、不含now、跨午夜和跨年、只执行一次的定时命令
+ *   夏令时：切换前后每天在同一个本地时间执行，跳过的时刻和重复的时刻都只执行一次
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir_gree_sched.h"
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            s_failures++;                               \
+        }                                               \
+    } while (0)
+
+static void test_tz(const char *tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+// 当前时区的本地时间
+static time_t test_time(int year, int mon, int mday, int hour, int min, int sec)
+{
+    struct tm tm = {
+        .tm_year = year - 1900,
+        .tm_mon = mon - 1,
+        .tm_mday = mday,
+        .tm_hour = hour,
+        .tm_min = min,
+        .tm_sec = sec,
+        .tm_isdst = -1,
+    };
+    return mktime(&tm);
+}
+
+static ir_gree_sched_t test_parse(const char *json)
+{
+    ir_gree_sched_t sched;
+    ir_gree_sched_err_t err = ir_gree_sched_parse(json, strlen(json), &sched);
+    CHECK(err == IR_GREE_SCHED_OK, "%s: %d", json, err);
+    return sched;
+}
+
+// 检查下一次执行的本地时间
+static void test_next(const char *json, time_t now, int year, int mon, int mday, int hour, int min)
+{
+    ir_gree_sched_t sched = test_parse(json);
+    time_t next = ir_gree_sched_next(&sched, now);
+    struct tm tm;
+    localtime_r(&next, &tm);
+    CHECK(tm.tm_year + 1900 == year && tm.tm_mon + 1 == mon && tm.tm_mday == mday && tm.tm_hour == hour && tm.tm_min == min &&
+              tm.tm_sec == 0,
+          "%s: next %04d-%02d-%02d %02d:%02d:%02d, expected %04d-%02d-%02d %02d:%02d", json, tm.tm_year + 1900, tm.tm_mon + 1,
+          tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, year, mon, mday, hour, min);
+}
+
+static void test_parse_fields(void)
+{
+    ir_gree_sched_t sched = test_parse("{\"id\":\"evening\",\"at\":\"18:05\",\"power\":1,\"mode\":\"cool\",\"temp\":26}");
+    CHECK(strcmp(sched.id, "evening") == 0, "id %s", sched.id);
+    CHECK(sched.minute == 18 * 60 + 5, "minute %u", sched.minute);
+    CHECK(sched.days == IR_GREE_SCHED_ALL_DAYS && !sched.once, "days %02x once %d", sched.days, sched.once);
+
+    // 整个对象原样保存，到时交给ir_gree_cmd_parse
+    const char *json = "{\"id\":\"w\",\"at\":\"7:3\",\"days\":\"1350\",\"once\":true,\"power\":0}";
+    sched = test_parse(json);
+    CHECK(sched.minute == 7 * 60 + 3, "minute %u", sched.minute);
+    CHECK(sched.days == 0x2B && sched.once, "days %02x once %d", sched.days, sched.once);
+    CHECK(sched.len == strlen(json) && memcmp(sched.cmd, json, sched.len) == 0, "cmd %.*s", sched.len, sched.cmd);
+
+    sched = test_parse("{\"id\":\"a\",\"at\":\"00:00\",\"once\":false,\"power\":1}");
+    CHECK(sched.minute == 0 && !sched.once, "minute %u once %d", sched.minute, sched.once);
+    sched = test_parse("{\"id\":\"a\",\"at\":\"23:59\",\"power\":1}");
+    CHECK(sched.minute == 23 * 60 + 59, "minute %u", sched.minute);
+}
+
+static void test_parse_errors(void)
+{
+    static const struct
+    {
+        const char *json;
+        ir_gree_sched_err_t err;
+    } s_cases[] = {
+        {"{\"at\":\"18:00\",\"power\":1}", IR_GREE_SCHED_ERR_FORMAT},
+        {"{\"id\":\"\",\"at\":\"18:00\",\"power\":1}", IR_GREE_SCHED_ERR_FORMAT},
+        {"{\"id\":\"a\",\"power\":1}", IR_GREE_SCHED_ERR_FORMAT},
+        {"not json", IR_GREE_SCHED_ERR_FORMAT},
+        {"{\"id\":\"0123456789abcdef\",\"at\":\"18:00\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"24:00\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"12:60\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"1200\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"123:00\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\":00\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"12:00\",\"days\":\"7\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"12:00\",\"days\":\"\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"12:00\",\"days\":\"1-5\",\"power\":1}", IR_GREE_SCHED_ERR_RANGE},
+        {"{\"id\":\"a\",\"at\":\"12:00\",\"temp\":99}", IR_GREE_SCHED_ERR_CMD},
+        {"{\"id\":\"a\",\"at\":\"12:00\",\"mode\":\"warp\"}", IR_GREE_SCHED_ERR_CMD},
+    };
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++)
+    {
+        ir_gree_sched_t sched = {.id = "keep", .minute = 1, .days = 1};
+        ir_gree_sched_err_t err = ir_gree_sched_parse(s_cases[i].json, strlen(s_cases[i].json), &sched);
+        CHECK(err == s_cases[i].err, "%s: %d, expected %d", s_cases[i].json, err, s_cases[i].err);
+        CHECK(strcmp(sched.id, "keep") == 0 && sched.minute == 1 && sched.days == 1, "%s: sched changed on error", s_cases[i].json);
+    }
+
+    // 超过IR_GREE_SCHED_CMD_MAX，刚好IR_GREE_SCHED_CMD_MAX可以
+    char json[IR_GREE_SCHED_CMD_MAX + 2];
+    const char *head = "{\"id\":\"a\",\"at\":\"12:00\",\"power\":1,\"pad\":\"";
+    for (size_t len = IR_GREE_SCHED_CMD_MAX; len <= IR_GREE_SCHED_CMD_MAX + 1; len++)
+    {
+        size_t pad = len - strlen(head) - 2;
+        strcpy(json, head);
+        memset(json + strlen(head), 'x', pad);
+        strcpy(json + strlen(head) + pad, "\"}");
+        ir_gree_sched_t sched;
+        ir_gree_sched_err_t err = ir_gree_sched_parse(json, len, &sched);
+        CHECK(err == (len > IR_GREE_SCHED_CMD_MAX ? IR_GREE_SCHED_ERR_SIZE : IR_GREE_SCHED_OK), "len %zu: %d", len, err);
+    }
+}
+
+static void test_days(void)
+{
+    test_tz("UTC0");
+    // 2024-01-01为周一
+    time_t monday = test_time(2024, 1, 1, 10, 0, 0);
+    test_next("{\"id\":\"a\",\"at\":\"18:00\",\"power\":1}", monday, 2024, 1, 1, 18, 0);
+    test_next("{\"id\":\"a\",\"at\":\"09:00\",\"power\":1}", monday, 2024, 1, 2, 9, 0);
+    test_next("{\"id\":\"a\",\"at\":\"09:00\",\"days\":\"12345\",\"power\":1}", monday, 2024, 1, 2, 9, 0);
+    test_next("{\"id\":\"a\",\"at\":\"09:00\",\"days\":\"60\",\"power\":1}", monday, 2024, 1, 6, 9, 0);
+    test_next("{\"id\":\"a\",\"at\":\"09:00\",\"days\":\"0\",\"power\":1}", monday, 2024, 1, 7, 9, 0);
+    // 当天已过、只有当天的星期，下一周
+    test_next("{\"id\":\"a\",\"at\":\"09:00\",\"days\":\"1\",\"power\":1}", monday, 2024, 1, 8, 9, 0);
+    test_next("{\"id\":\"a\",\"at\":\"11:00\",\"days\":\"1\",\"power\":1}", monday, 2024, 1, 1, 11, 0);
+    // 不含now，同一分钟内的下一秒也不再执行
+    test_next("{\"id\":\"a\",\"at\":\"10:00\",\"power\":1}", monday, 2024, 1, 2, 10, 0);
+    test_next("{\"id\":\"a\",\"at\":\"10:00\",\"power\":1}", monday - 1, 2024, 1, 1, 10, 0);
+    test_next("{\"id\":\"a\",\"at\":\"10:00\",\"power\":1}", monday + 30, 2024, 1, 2, 10, 0);
+    // 只执行一次的与每天的算法相同，执行后由调用者删除
+    test_next("{\"id\":\"a\",\"at\":\"12:30\",\"days\":\"3\",\"once\":true,\"power\":1}", monday, 2024, 1, 3, 12, 30);
+
+    // 从一个时间一直往后算，每次都在掩码中的星期的06:15，间隔不超过三天
+    ir_gree_sched_t sched = test_parse("{\"id\":\"a\",\"at\":\"06:15\",\"days\":\"135\",\"power\":1}");
+    time_t t = monday;
+    for (int i = 0; i < 30; i++)
+    {
+        time_t next = ir_gree_sched_next(&sched, t);
+        struct tm tm;
+        localtime_r(&next, &tm);
+        CHECK(next > t && next - t <= 3 * 86400, "step %d: %lld", i, (long long)(next - t));
+        CHECK((sched.days & (1 << tm.tm_wday)) && tm.tm_hour == 6 && tm.tm_min == 15, "step %d: wday %d %02d:%02d", i, tm.tm_wday,
+              tm.tm_hour, tm.tm_min);
+        t = next;
+    }
+}
+
+static void test_midnight(void)
+{
+    test_tz("UTC0");
+    time_t before = test_time(2024, 1, 1, 23, 59, 59);
+    test_next("{\"id\":\"a\",\"at\":\"00:00\",\"power\":1}", before, 2024, 1, 2, 0, 0);
+    CHECK(ir_gree_sched_next(&(ir_gree_sched_t){.minute = 0, .days = IR_GREE_SCHED_ALL_DAYS}, before) == before + 1, "midnight");
+    test_next("{\"id\":\"a\",\"at\":\"23:59\",\"power\":1}", before, 2024, 1, 2, 23, 59);
+    test_next("{\"id\":\"a\",\"at\":\"00:00\",\"power\":1}", test_time(2024, 1, 2, 0, 0, 0), 2024, 1, 3, 0, 0);
+    // 跨月、跨年、闰日
+    test_next("{\"id\":\"a\",\"at\":\"00:01\",\"power\":1}", test_time(2023, 12, 31, 23, 0, 0), 2024, 1, 1, 0, 1);
+    test_next("{\"id\":\"a\",\"at\":\"07:00\",\"power\":1}", test_time(2024, 2, 28, 8, 0, 0), 2024, 2, 29, 7, 0);
+    test_next("{\"id\":\"a\",\"at\":\"07:00\",\"power\":1}", test_time(2024, 2, 29, 8, 0, 0), 2024, 3, 1, 7, 0);
+    // 2023-12-31为周日，下一个周一在下一年
+    test_next("{\"id\":\"a\",\"at\":\"07:00\",\"days\":\"1\",\"power\":1}", test_time(2023, 12, 31, 8, 0, 0), 2024, 1, 1, 7, 0);
+
+    // 东八区的午夜不是UTC的午夜
+    test_tz("CST-8");
+    test_next("{\"id\":\"a\",\"at\":\"00:30\",\"days\":\"2\",\"power\":1}", test_time(2024, 1, 1, 23, 0, 0), 2024, 1, 2, 0, 30);
+}
+
+static void test_dst(void)
+{
+    // 中欧时间，2024-03-31 02:00跳到03:00，2024-10-27 03:00回到02:00
+    test_tz("CET-1CEST,M3.5.0,M10.5.0/3");
+
+    // 每天08:00，切换前后都是本地08:00，切换那天前后间隔23或25小时
+    ir_gree_sched_t sched = test_parse("{\"id\":\"a\",\"at\":\"08:00\",\"power\":1}");
+    time_t t = test_time(2024, 3, 29, 8, 0, 0);
+    time_t next = ir_gree_sched_next(&sched, t);
+    CHECK(next - t == 86400, "before spring: %lld", (long long)(next - t));
+    t = next;
+    next = ir_gree_sched_next(&sched, t);
+    CHECK(next - t == 23 * 3600, "spring forward: %lld", (long long)(next - t));
+    test_next("{\"id\":\"a\",\"at\":\"08:00\",\"power\":1}", t, 2024, 3, 31, 8, 0);
+    t = test_time(2024, 10, 26, 8, 0, 0);
+    next = ir_gree_sched_next(&sched, t);
+    CHECK(next - t == 25 * 3600, "fall back: %lld", (long long)(next - t));
+    test_next("{\"id\":\"a\",\"at\":\"08:00\",\"power\":1}", t, 2024, 10, 27, 8, 0);
+
+    // 跳过的02:30当天仍然执行一次，在跳变之后、当天结束之前
+    sched = test_parse("{\"id\":\"a\",\"at\":\"02:30\",\"power\":1}");
+    t = test_time(2024, 3, 30, 12, 0, 0);
+    next = ir_gree_sched_next(&sched, t);
+    time_t gap = test_time(2024, 3, 31, 3, 0, 0);
+    CHECK(next >= gap && next < test_time(2024, 4, 1, 0, 0, 0), "spring 02:30: %+lld s after the gap", (long long)(next - gap));
+    // 之后的一次在第二天的02:30
+    test_next("{\"id\":\"a\",\"at\":\"02:30\",\"power\":1}", next, 2024, 4, 1, 2, 30);
+
+    // 重复的02:30只执行一次，下一次在第二天
+    t = test_time(2024, 10, 26, 12, 0, 0);
+    next = ir_gree_sched_next(&sched, t);
+    struct tm tm;
+    localtime_r(&next, &tm);
+    CHECK(tm.tm_mday == 27 && tm.tm_hour == 2 && tm.tm_min == 30, "fall 02:30: %02d %02d:%02d", tm.tm_mday, tm.tm_hour, tm.tm_min);
+    test_next("{\"id\":\"a\",\"at\":\"02:30\",\"power\":1}", next, 2024, 10, 28, 2, 30);
+    test_next("{\"id\":\"a\",\"at\":\"02:30\",\"power\":1}", next + 3600, 2024, 10, 28, 2, 30);
+}
+
+int main(void)
+{
+    test_parse_fields();
+    test_parse_errors();
+    test_days();
+    test_midnight();
+    test_dst();
+
+    printf("%d failures\n", s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * 时间轮的主机测试
+ *
+ *   挂在每一层边界两侧的节点逐层降下来，都在expires那个tick到期
+ *   超过IR_GREE_WHEEL_SPAN的节点先挂在最远处，到时重新挂，仍在expires到期
+ *   摘下槽链表头、中间、尾部的节点，以及降过层的节点，其余节点不受影响
+ *   已经过期的节点在下一个tick到期，回调中重新挂上的节点按新的时间到期
+ *   按固定的随机序列增删和前进，与逐个节点记下到期时间的模型比较，包括tick回绕
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_gree_wheel.h"
+
+#define TEST_NODES 64
+#define TEST_STEPS 10000
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            s_failures++;                               \
+        }                                               \
+    } while (0)
+
+typedef struct
+{
+    ir_gree_wheel_t wheel;
+    ir_gree_wheel_node_t nodes[TEST_NODES];
+    // 每个节点到期时的tick和到期次数
+    uint32_t fired_at[TEST_NODES];
+    int fired[TEST_NODES];
+    // 大于0时，节点到期后在这么多个tick之后重新挂上
+    uint32_t period[TEST_NODES];
+} test_wheel_t;
+
+static void test_fire(void *ctx, uint16_t index)
+{
+    test_wheel_t *t = ctx;
+    CHECK(index < TEST_NODES, "index %u", index);
+    CHECK(!t->nodes[index].pending, "node %u still pending in callback", index);
+    t->fired_at[index] = t->wheel.now;
+    t->fired[index]++;
+    if (t->period[index])
+    {
+        ir_gree_wheel_add(&t->wheel, index, t->wheel.now + t->period[index]);
+    }
+}
+
+static void test_init(test_wheel_t *t, uint32_t now)
+{
+    memset(t, 0, sizeof(*t));
+    ir_gree_wheel_init(&t->wheel, t->nodes, TEST_NODES, now);
+}
+
+// 每层边界两侧的到期时间，从不同的起点开始，低位进位的情况都覆盖
+static void test_cascade(uint32_t start)
+{
+    static const uint32_t s_deltas[] = {
+        1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 4160, 262143, 262144, 262145, 266240,
+        1000000, IR_GREE_WHEEL_SPAN - 2, IR_GREE_WHEEL_SPAN - 1,
+    };
+    const size_t count = sizeof(s_deltas) / sizeof(s_deltas[0]);
+    test_wheel_t t;
+    test_init(&t, start);
+    for (size_t i = 0; i < count; i++)
+    {
+        ir_gree_wheel_add(&t.wheel, i, start + s_deltas[i]);
+    }
+    CHECK(t.nodes[0].level == 0 && t.nodes[3].level == 1 && t.nodes[8].level == 2 && t.nodes[12].level == 3,
+          "levels %u %u %u %u", t.nodes[0].level, t.nodes[3].level, t.nodes[8].level, t.nodes[12].level);
+
+    // 分几段前进，段尾正好在一些到期时间上
+    ir_gree_wheel_advance(&t.wheel, start + 64, test_fire, &t);
+    ir_gree_wheel_advance(&t.wheel, start + 4096, test_fire, &t);
+    ir_gree_wheel_advance(&t.wheel, start + IR_GREE_WHEEL_SPAN, test_fire, &t);
+    for (size_t i = 0; i < count; i++)
+    {
+        CHECK(t.fired[i] == 1 && t.fired_at[i] == start + s_deltas[i], "start %08x delta %u: fired %d at +%u", (unsigned)start,
+              (unsigned)s_deltas[i], t.fired[i], (unsigned)(t.fired_at[i] - start));
+    }
+}
+
+// 超出跨度的先挂在最远处，降下来时按原来的expires重新挂
+static void test_clamp(void)
+{
+    static const uint32_t s_deltas[] = {
+        IR_GREE_WHEEL_SPAN, IR_GREE_WHEEL_SPAN + 1, IR_GREE_WHEEL_SPAN + 12345, 2 * IR_GREE_WHEEL_SPAN + 77, 5 * IR_GREE_WHEEL_SPAN,
+    };
+    const size_t count = sizeof(s_deltas) / sizeof(s_deltas[0]);
+    const uint32_t start = 1000;
+    test_wheel_t t;
+    test_init(&t, start);
+    for (size_t i = 0; i < count; i++)
+    {
+        ir_gree_wheel_add(&t.wheel, i, start + s_deltas[i]);
+        CHECK(t.nodes[i].pending && t.nodes[i].level == IR_GREE_WHEEL_LEVELS - 1, "delta %u: level %u", (unsigned)s_deltas[i],
+              t.nodes[i].level);
+        CHECK(t.nodes[i].expires == start + s_deltas[i], "delta %u: expires changed", (unsigned)s_deltas[i]);
+    }
+    ir_gree_wheel_advance(&t.wheel, start + IR_GREE_WHEEL_SPAN - 1, test_fire, &t);
+    for (size_t i = 0; i < count; i++)
+    {
+        CHECK(t.fired[i] == 0, "delta %u fired early at +%u", (unsigned)s_deltas[i], (unsigned)(t.fired_at[i] - start));
+    }
+    ir_gree_wheel_advance(&t.wheel, start + 5 * IR_GREE_WHEEL_SPAN, test_fire, &t);
+    for (size_t i = 0; i < count; i++)
+    {
+        CHECK(t.fired[i] == 1 && t.fired_at[i] == start + s_deltas[i], "delta %u: fired %d at +%u", (unsigned)s_deltas[i],
+              t.fired[i], (unsigned)(t.fired_at[i] - start));
+    }
+}
+
+static void test_del(void)
+{
+    test_wheel_t t;
+    test_init(&t, 0);
+
+    // 同一个槽中的0~4，链表顺序为4 3 2 1 0，摘下中间、头、尾
+    for (uint16_t i = 0; i < 5; i++)
+    {
+        ir_gree_wheel_add(&t.wheel, i, 10);
+    }
+    ir_gree_wheel_del(&t.wheel, 2);
+    ir_gree_wheel_del(&t.wheel, 4);
+    ir_gree_wheel_del(&t.wheel, 0);
+    CHECK(!t.nodes[2].pending && !t.nodes[4].pending && !t.nodes[0].pending, "deleted nodes still pending");
+    // 不在轮上时什么也不做
+    ir_gree_wheel_del(&t.wheel, 2);
+    ir_gree_wheel_del(&t.wheel, 20);
+
+    // 高层的槽中摘下一个以后，剩下的降层时不受影响
+    ir_gree_wheel_add(&t.wheel, 5, 5000);
+    ir_gree_wheel_add(&t.wheel, 6, 5000);
+    ir_gree_wheel_add(&t.wheel, 7, 5001);
+    ir_gree_wheel_del(&t.wheel, 6);
+
+    // 已经降过层的节点
+    ir_gree_wheel_add(&t.wheel, 8, 4200);
+    ir_gree_wheel_add(&t.wheel, 9, 4200);
+
+    ir_gree_wheel_advance(&t.wheel, 4100, test_fire, &t);
+    CHECK(t.fired[1] == 1 && t.fired_at[1] == 10 && t.fired[3] == 1 && t.fired_at[3] == 10, "remaining slot nodes");
+    CHECK(t.nodes[8].pending && t.nodes[8].level == 1, "node 8 level %u after cascade", t.nodes[8].level);
+    ir_gree_wheel_del(&t.wheel, 8);
+    // 摘下以后重新挂上，按新的时间到期
+    ir_gree_wheel_add(&t.wheel, 2, 4150);
+
+    ir_gree_wheel_advance(&t.wheel, 6000, test_fire, &t);
+    CHECK(t.fired[0] == 0 && t.fired[4] == 0 && t.fired[6] == 0 && t.fired[8] == 0, "deleted node fired");
+    CHECK(t.fired[2] == 1 && t.fired_at[2] == 4150, "re-added node fired %d at %u", t.fired[2], (unsigned)t.fired_at[2]);
+    CHECK(t.fired[5] == 1 && t.fired_at[5] == 5000 && t.fired[7] == 1 && t.fired_at[7] == 5001, "level 2 neighbours");
+    CHECK(t.fired[9] == 1 && t.fired_at[9] == 4200, "level 1 neighbour");
+}
+
+static void test_past_and_periodic(void)
+{
+    test_wheel_t t;
+    test_init(&t, 100);
+    // 已经过期或者就是当前tick的，在下一个tick到期
+    ir_gree_wheel_add(&t.wheel, 0, 50);
+    ir_gree_wheel_add(&t.wheel, 1, 100);
+    t.period[2] = 7;
+    ir_gree_wheel_add(&t.wheel, 2, 103);
+    // 不前进时什么也不做
+    ir_gree_wheel_advance(&t.wheel, 100, test_fire, &t);
+    ir_gree_wheel_advance(&t.wheel, 90, test_fire, &t);
+    CHECK(t.fired[0] == 0 && t.wheel.now == 100, "advance backwards");
+
+    ir_gree_wheel_advance(&t.wheel, 101, test_fire, &t);
+    CHECK(t.fired[0] == 1 && t.fired_at[0] == 101 && t.fired[1] == 1 && t.fired_at[1] == 101, "past nodes");
+    ir_gree_wheel_advance(&t.wheel, 103 + 7 * 1000, test_fire, &t);
+    CHECK(t.fired[2] == 1001 && t.fired_at[2] == 103 + 7 * 1000, "periodic fired %d", t.fired[2]);
+}
+
+static uint32_t s_rng = 1;
+
+static uint32_t test_random(void)
+{
+    // xorshift32
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+// 到期的距离在各层中随机取，偶尔超出跨度
+static uint32_t test_random_delta(void)
+{
+    switch (test_random() % 6)
+    {
+    case 0:
+        return test_random() % 64;
+    case 1:
+        return test_random() % 4096;
+    case 2:
+        return test_random() % 262144;
+    case 3:
+        return test_random() % IR_GREE_WHEEL_SPAN;
+    case 4:
+        return IR_GREE_WHEEL_SPAN + test_random() % IR_GREE_WHEEL_SPAN;
+    default:
+        return 0;
+    }
+}
+
+// 模型中每个节点记下应该到期的tick，每次前进以后比较到期的节点和时间
+static void test_model(uint32_t start)
+{
+    test_wheel_t t;
+    bool pending[TEST_NODES] = {0};
+    uint32_t due[TEST_NODES];
+    test_init(&t, start);
+
+    for (int step = 0; step < TEST_STEPS; step++)
+    {
+        uint16_t index = test_random() % TEST_NODES;
+        uint32_t op = test_random() % 8;
+        if (op < 4)
+        {
+            uint32_t expires = t.wheel.now + test_random_delta();
+            if (test_random() % 8 == 0)
+            {
+                expires = t.wheel.now - test_random() % 100;
+            }
+            ir_gree_wheel_add(&t.wheel, index, expires);
+            pending[index] = true;
+            due[index] = (int32_t)(expires - t.wheel.now) > 0 ? expires : t.wheel.now + 1;
+        }
+        else if (op < 6)
+        {
+            ir_gree_wheel_del(&t.wheel, index);
+            pending[index] = false;
+        }
+        else
+        {
+            // 多数时候前进几个tick，偶尔跳到某个节点到期或者走到第2层以外，
+            // 逐个tick前进，更远的由test_cascade和test_clamp覆盖
+            uint32_t now = t.wheel.now + test_random() % 300;
+            if (op == 7 && pending[index] && due[index] - t.wheel.now <= 262144)
+            {
+                now = due[index];
+            }
+            else if (op == 7)
+            {
+                now = t.wheel.now + test_random() % 300000;
+            }
+            memset(t.fired, 0, sizeof(t.fired));
+            uint32_t from = t.wheel.now;
+            ir_gree_wheel_advance(&t.wheel, now, test_fire, &t);
+            for (int i = 0; i < TEST_NODES; i++)
+            {
+                bool expect = pending[i] && due[i] - from - 1 < now - from;
+                CHECK(t.fired[i] == expect, "start %08x step %d node %d: fired %d, expected %d", (unsigned)start, step, i, t.fired[i],
+                      expect);
+                if (expect)
+                {
+                    CHECK(t.fired_at[i] == due[i], "start %08x step %d node %d: fired at %u, due %u", (unsigned)start, step, i,
+                          (unsigned)t.fired_at[i], (unsigned)due[i]);
+                    pending[i] = false;
+                }
+                CHECK(t.nodes[i].pending == pending[i], "start %08x step %d node %d: pending %d", (unsigned)start, step, i,
+                      t.nodes[i].pending);
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    test_cascade(0);
+    test_cascade(12345);
+    test_cascade(0xFFFFFFC0);
+    test_cascade(0xFFFFF000 - 3);
+    test_clamp();
+    test_del();
+    test_past_and_periodic();
+    test_model(0);
+    test_model(0xFFFF0000);
+
+    printf("%d failures\n", s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * 接收窗口自动校准
+ *
+ * 把周期（mark + space）放进对数直方图，每个倍频程分IR_GREE_CALIB_STEPS格，每格记个数和总和，只需一遍
+ * 求解时以协议的标称周期为初始中心，按对数距离把各格分给最近的类，反复迭代到中心不再变化
+ * 每类的窗口为它的格（不算样本很少的格）覆盖的范围再放宽IR_GREE_CALIB_MARGIN_PCT，不超过与相邻类中心的几何平均
+ * 样本太少的类保留默认窗口
+ *
+ * 与ir_gree/calib.py的算法相同
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ir_gree_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 直方图覆盖512us ~ 65.5ms
+#define IR_GREE_CALIB_MIN_US 512
+#define IR_GREE_CALIB_OCTAVES 7
+#define IR_GREE_CALIB_STEPS 16
+#define IR_GREE_CALIB_BINS (IR_GREE_CALIB_OCTAVES * IR_GREE_CALIB_STEPS)
+// 样本数达到这么多时全部减半，旧的样本逐渐淡出
+#define IR_GREE_CALIB_TOTAL_MAX 4096
+// 少于这么多样本的类不校准，一帧只有一个长连接码
+#define IR_GREE_CALIB_MIN_COUNT 1
+// 数据码0和1至少要有一段的位数才算校准成功
+#define IR_GREE_CALIB_MIN_BITS IR_GREE_DATA_BITS
+// 与类中心相差超过这个比例的格认为是干扰
+#define IR_GREE_CALIB_OUTLIER_PCT 35
+#define IR_GREE_CALIB_MARGIN_PCT 10
+
+// 按周期从短到长
+typedef enum
+{
+    IR_GREE_CALIB_ZERO,
+    IR_GREE_CALIB_ONE,
+    IR_GREE_CALIB_LEADER,
+    IR_GREE_CALIB_CONNECT,
+    IR_GREE_CALIB_LONG_CONNECT,
+    IR_GREE_CALIB_CLASS_NUM,
+} ir_gree_calib_class_t;
+
+typedef struct
+{
+    uint16_t counts[IR_GREE_CALIB_BINS];
+    uint32_t sums[IR_GREE_CALIB_BINS];
+    uint32_t total;
+    uint32_t outliers; // 超出直方图范围的周期
+} ir_gree_calib_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t center; // 平均周期，没有样本时为标称周期
+    ir_gree_window_t window;
+} ir_gree_calib_stat_t;
+
+void ir_gree_calib_init(ir_gree_calib_t *calib);
+
+/**
+ * 加入一个周期（us）
+ */
+void ir_gree_calib_add(ir_gree_calib_t *calib, uint32_t period);
+
+/**
+ * 聚类并求出窗口，stats可以为NULL
+ * 引导码、数据码0和1都有样本，且数据码不少于IR_GREE_CALIB_MIN_BITS个时返回true，否则windows不变
+ */
+bool ir_gree_calib_solve(const ir_gree_calib_t *calib, ir_gree_windows_t *windows, ir_gree_calib_stat_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
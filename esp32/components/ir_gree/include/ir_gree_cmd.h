@@ -0,0 +1,90 @@
+/*
+ * MQTT命令格式，直接在收到的数据上解析，不分配内存也不拷贝
+ *
+ * 二进制格式，固定长度，包含完整状态：
+ *   版本1：'G' 1 power mode temperature fan swing light turbo sleep timer
+ *   版本2：'G' 2 power mode temperature fan swing light turbo sleep timer repeat gap_ms(小端2字节)
+ *
+ * JSON格式，只修改出现的字段，例如：
+ *   {"power":1,"mode":"cool","temp":26,"fan":"auto","swing":true}
+ *   mode: auto/cool/dry/fan/heat，fan: auto/low/medium/high，也可以直接用数字
+ *   timer以半小时为单位，0为关闭
+ *
+ * repeat和gap_ms（别名gap）只对本条命令有效，不属于空调状态：
+ *   {"temp":24,"repeat":2,"gap_ms":100} 发送后再重复2次，每次间隔100ms
+ *
+ * 反过来，状态也可以按JSON格式写出，用于把遥控器改的字段发布到MQTT，写出的内容可以直接作为命令
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "ir_gree_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IR_GREE_CMD_MAGIC 'G'
+#define IR_GREE_CMD_VERSION 1
+#define IR_GREE_CMD_BINARY_SIZE 11
+#define IR_GREE_CMD_VERSION_2 2
+#define IR_GREE_CMD_BINARY_V2_SIZE 14
+
+// 重复次数和帧间隔的上限
+#define IR_GREE_CMD_REPEAT_MAX 5
+#define IR_GREE_CMD_GAP_MAX_MS 1000
+
+// 状态的字段数，ir_gree_cmd_diff的位图中第i位对应第i个字段，顺序同二进制格式
+#define IR_GREE_CMD_STATE_FIELDS 9
+#define IR_GREE_CMD_STATE_ALL ((1u << IR_GREE_CMD_STATE_FIELDS) - 1)
+
+typedef enum
+{
+    IR_GREE_CMD_OK = 0,
+    IR_GREE_CMD_ERR_FORMAT, // 不是合法的二进制或JSON命令
+    IR_GREE_CMD_ERR_RANGE,  // 字段取值超出范围
+} ir_gree_cmd_err_t;
+
+// 命令的发送选项，调用者先填好默认值，命令中没有出现的保持不变
+typedef struct
+{
+    uint8_t repeat;  // 第一帧之后再重复的次数
+    uint16_t gap_ms; // 重复帧之间的间隔
+} ir_gree_cmd_opts_t;
+
+/**
+ * 解析一条命令并更新state和opts，出错时都保持不变，opts可以为NULL
+ */
+ir_gree_cmd_err_t ir_gree_cmd_parse(const char *data, size_t len, gree_state_t *state, ir_gree_cmd_opts_t *opts);
+
+/**
+ * 在JSON对象中找key的值，字符串不带引号，数字和true/false为原样的文本，
+ * 找不到或者不是JSON对象时返回false，只看最外层，值不能是对象或数组
+ */
+bool ir_gree_cmd_lookup(const char *data, size_t len, const char *key, const char **value, size_t *value_len);
+
+/**
+ * 比较两个状态，返回不同字段的位图
+ */
+uint16_t ir_gree_cmd_diff(const gree_state_t *a, const gree_state_t *b);
+
+/**
+ * 第index个字段的名字，超出范围返回NULL
+ */
+const char *ir_gree_cmd_key(size_t index);
+
+/**
+ * 写出第index个字段的值，mode和fan用名字（带引号），其他为数字，返回值同snprintf
+ */
+int ir_gree_cmd_format_value(const gree_state_t *state, size_t index, char *buf, size_t size);
+
+/**
+ * 写出mask中的字段，例如 {"temp":26,"fan":"low"}，返回值同snprintf
+ */
+int ir_gree_cmd_format(const gree_state_t *state, uint16_t mask, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * 格力空调红外解码
+ * 与ir_gree/pd.py一致，按下降沿到下降沿的周期（mark + space）分类，窗口为开区间
+ * 按ir_gree_segments逐段解码，窗口和段的结构都来自ir_gree_protocol.h
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ir_gree_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    uint32_t min;
+    uint32_t max;
+} ir_gree_window_t;
+
+typedef struct
+{
+    ir_gree_window_t leader;
+    ir_gree_window_t connect;
+    ir_gree_window_t long_connect;
+    ir_gree_window_t zero;
+    ir_gree_window_t one;
+} ir_gree_windows_t;
+
+// 默认窗口，单位us
+extern const ir_gree_windows_t ir_gree_default_windows;
+
+typedef struct
+{
+    const ir_gree_windows_t *windows;
+    int state;
+    int segment; // 当前段
+    int bits;    // 当前段已经收到的位数
+    uint32_t data[IR_GREE_SEGMENT_NUM];
+} ir_gree_decoder_t;
+
+ir_gree_sym_t ir_gree_classify(const ir_gree_windows_t *windows, uint32_t period);
+
+/**
+ * 初始化解码器，windows为NULL时使用ir_gree_default_windows
+ */
+void ir_gree_decoder_init(ir_gree_decoder_t *decoder, const ir_gree_windows_t *windows);
+
+/**
+ * 输入一个已经分类的周期，解出完整的一帧时写入scan_code并返回true
+ * 收到引导码时总是重新同步，中间出现无效周期则丢弃当前帧
+ */
+bool ir_gree_decoder_feed_symbol(ir_gree_decoder_t *decoder, ir_gree_sym_t sym, ir_gree_scan_code_t *scan_code);
+
+/**
+ * 输入一对mark/space，space为0表示后面没有下降沿
+ */
+bool ir_gree_decoder_feed(ir_gree_decoder_t *decoder, uint32_t mark, uint32_t space, ir_gree_scan_code_t *scan_code);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,111 @@
+/*
+ * 格力空调遥控器（YAPOF）帧结构，不依赖IDF
+ * 编码格式为：引导码 + 35位数据码 + 短连接码 + 32位数据码 + 长连接码 + 引导码 + 35位数据码 + 短连接码 + 32位数据码 + 结束码
+ * 这里的mark为发射（接收端低电平），space为空闲（接收端高电平），单位us
+ * 时长、窗口和段的结构在ir_gree_protocol.h中，由tools/gen_protocol.py生成
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ir_gree_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 一共4段数据码，第一段和第三段都是35位，其中后3位是固定的
+// 每段数据低字节在前，每个字节低位在前
+typedef struct
+{
+    uint32_t data1;
+    uint32_t data2;
+    uint32_t data3;
+    uint32_t data4;
+} ir_gree_scan_code_t;
+
+typedef struct
+{
+    uint16_t mark;
+    uint16_t space;
+} ir_gree_pulse_t;
+
+typedef enum
+{
+    IR_GREE_SYM_INVALID,
+    IR_GREE_SYM_LEADER,
+    IR_GREE_SYM_ZERO,
+    IR_GREE_SYM_ONE,
+    IR_GREE_SYM_CONNECT,
+    IR_GREE_SYM_LONG_CONNECT,
+    // 发送时为结束码；接收时为一段脉冲后面没有下降沿（接收超时或结束码）
+    IR_GREE_SYM_END,
+    IR_GREE_SYM_NUM,
+} ir_gree_sym_t;
+
+// 打包帧：各段数据码按发送顺序逐位存放，低位在前，35位段固定的后3位也在其中
+// 134位共17字节，前4字节正好是data1的小端表示
+#define IR_GREE_PACKED_BYTES ((IR_GREE_PACKED_BITS + 7) / 8)
+
+typedef struct
+{
+    uint8_t bits[IR_GREE_PACKED_BYTES];
+} ir_gree_packed_t;
+
+// 段的位数和段后的符号，长连接码之后重新发引导码
+typedef struct
+{
+    uint8_t bits;
+    ir_gree_sym_t gap;
+} ir_gree_segment_t;
+
+extern const ir_gree_segment_t ir_gree_segments[IR_GREE_SEGMENT_NUM];
+
+// 逐个符号遍历打包帧，初始化为全0
+typedef struct
+{
+    uint8_t stage;
+    uint8_t segment;
+    uint8_t bit;
+    uint8_t offset;
+} ir_gree_cursor_t;
+
+static inline bool ir_gree_packed_bit(const ir_gree_packed_t *packed, size_t index)
+{
+    return (packed->bits[index >> 3] >> (index & 7)) & 1;
+}
+
+/**
+ * 把扫描码渲染成mark/space序列
+ *
+ * pulses至少要有IR_GREE_FRAME_PULSES个元素，返回写入的个数
+ */
+size_t ir_gree_frame_render(const ir_gree_scan_code_t *scan_code, ir_gree_pulse_t *pulses);
+
+/**
+ * 扫描码与打包帧互相转换，打包时35位段的后3位填IR_GREE_TAIL_BITS
+ */
+void ir_gree_pack(const ir_gree_scan_code_t *scan_code, ir_gree_packed_t *packed);
+void ir_gree_unpack(const ir_gree_packed_t *packed, ir_gree_scan_code_t *scan_code);
+
+/**
+ * 返回打包帧的下一个符号，整帧结束后返回IR_GREE_SYM_INVALID
+ */
+ir_gree_sym_t ir_gree_packed_next(const ir_gree_packed_t *packed, ir_gree_cursor_t *cursor);
+
+/**
+ * 符号对应的mark/space，结束码的space为0
+ */
+ir_gree_pulse_t ir_gree_sym_pulse(ir_gree_sym_t sym);
+
+/**
+ * 把打包帧渲染成mark/space序列，pulses至少要有IR_GREE_FRAME_PULSES个元素
+ */
+size_t ir_gree_packed_render(const ir_gree_packed_t *packed, ir_gree_pulse_t *pulses);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+/*
+ * 空调状态日志，保存每台设备最后一次命令的状态，重启后恢复
+ *
+ * 日志区域为两个扇区，轮流使用，每条记录16字节：
+ *   seq(4字节，小端) device(1) gree_state_t(9) crc16(2，小端)
+ * 只追加不改写，当前扇区写满时擦除另一个扇区，把每台设备的最新状态写过去再继续追加
+ * 整条记录为0xFF表示空位，写失败会在中间留下空位，恢复时扫描整个扇区，跳过空位和CRC不对的记录（写到一半掉电）
+ * 恢复时取每台设备seq最大的记录，所以整理到一半掉电也不会丢状态
+ *
+ * flash的读写通过ir_gree_flash_t，不依赖IDF，主机上可以用内存模拟
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ir_gree_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IR_GREE_JOURNAL_RECORD_SIZE 16
+#define IR_GREE_JOURNAL_SECTOR_NUM 2
+// 最多记录的设备数，整理时一个扇区要放得下所有设备
+#define IR_GREE_JOURNAL_DEVICE_MAX 8
+
+typedef enum
+{
+    IR_GREE_JOURNAL_OK = 0,
+    IR_GREE_JOURNAL_ERR_ARG,   // 设备号超出范围或扇区大小不合适
+    IR_GREE_JOURNAL_ERR_FLASH, // flash读写失败
+} ir_gree_journal_err_t;
+
+// flash操作，offset相对于日志区域起点，成功返回0
+// write只会把1写成0，erase把整个扇区写成0xFF
+typedef struct
+{
+    int (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *buf, size_t len);
+    int (*erase)(void *ctx, uint32_t offset, size_t len);
+    void *ctx;
+    uint32_t sector_size;
+} ir_gree_flash_t;
+
+typedef struct
+{
+    const ir_gree_flash_t *flash;
+    uint32_t seq;     // 下一条记录的seq
+    int sector;       // 当前追加的扇区
+    uint32_t next;    // 当前扇区中下一个空位的偏移
+    uint32_t valid;   // 有记录的设备，按位
+    uint32_t stale;   // 追加失败的设备，flash中可能是新状态也可能是旧状态，下次追加时一定写入
+    uint32_t appends; // 写入的记录数，不包括整理
+    uint32_t compactions;
+    gree_state_t states[IR_GREE_JOURNAL_DEVICE_MAX];
+} ir_gree_journal_t;
+
+/**
+ * 扫描两个扇区，恢复每台设备的最新状态
+ */
+ir_gree_journal_err_t ir_gree_journal_mount(ir_gree_journal_t *journal, const ir_gree_flash_t *flash);
+
+/**
+ * 取出设备最后记录的状态，没有记录时返回false
+ */
+bool ir_gree_journal_get(const ir_gree_journal_t *journal, uint8_t device, gree_state_t *state);
+
+/**
+ * 追加一条记录，与最后记录的状态相同时不写flash，必要时先整理
+ * 失败时记录的状态不变，state可能写进去了也可能没有，恢复时可能得到其中任何一个
+ */
+ir_gree_journal_err_t ir_gree_journal_append(ir_gree_journal_t *journal, uint8_t device, const gree_state_t *state);
+
+#ifdef __cplusplus
+}
+#endif
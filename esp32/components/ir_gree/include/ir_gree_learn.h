@@ -0,0 +1,78 @@
+/*
+ * 学习模式：压缩任意遥控器的mark/space序列，不限于格力的帧结构
+ *
+ * 大部分红外帧只用到4~6种时长，mark和space各自聚类成字典，每对mark/space用一个字节：
+ *   头部：'L' 版本 mark字典长度 space字典长度 mark/space对数(小端2字节)
+ *   字典：mark字典、space字典，每项小端2字节，单位us
+ *   数据：高4位为mark的序号，低4位为space的序号
+ *         高4位为0xF时表示重复前一对，低4位+1为重复次数
+ * 最后一对的space为0，表示后面没有下降沿
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ir_gree_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IR_GREE_LEARN_MAGIC 'L'
+#define IR_GREE_LEARN_VERSION 1
+#define IR_GREE_LEARN_HEADER_SIZE 6
+// 序号0xF留给重复
+#define IR_GREE_LEARN_DICT_MAX 15
+#define IR_GREE_LEARN_RUN_MAX 16
+// 同一类时长允许的偏差，取两者中较大的
+#define IR_GREE_LEARN_TOLERANCE_US 100
+#define IR_GREE_LEARN_TOLERANCE_PCT 15
+// 空闲超过这个时间认为是下一次按键
+#define IR_GREE_LEARN_IDLE_US (100 * 1000)
+
+// count对mark/space压缩后的最大字节数
+#define IR_GREE_LEARN_MAX_SIZE(count) (IR_GREE_LEARN_HEADER_SIZE + 4 * IR_GREE_LEARN_DICT_MAX + (count))
+
+typedef enum
+{
+    IR_GREE_LEARN_OK = 0,
+    IR_GREE_LEARN_ERR_DICT,   // 不同的时长太多，放不进字典
+    IR_GREE_LEARN_ERR_SIZE,   // 输出缓冲太小或者对数太多
+    IR_GREE_LEARN_ERR_FORMAT, // 不是合法的压缩数据
+} ir_gree_learn_err_t;
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint16_t marks[IR_GREE_LEARN_DICT_MAX];
+    uint16_t spaces[IR_GREE_LEARN_DICT_MAX];
+    uint8_t mark_num;
+    uint8_t space_num;
+    uint16_t remaining; // 还没有输出的对数
+    uint8_t repeat;     // 前一对还要重复的次数
+    ir_gree_pulse_t last;
+} ir_gree_learn_reader_t;
+
+/**
+ * 压缩count对mark/space，写入out，out_len为实际长度
+ */
+ir_gree_learn_err_t ir_gree_learn_compress(const ir_gree_pulse_t *pulses, size_t count, uint8_t *out, size_t size, size_t *out_len);
+
+/**
+ * 检查头部和字典，准备逐对展开
+ */
+ir_gree_learn_err_t ir_gree_learn_reader_init(ir_gree_learn_reader_t *reader, const uint8_t *data, size_t len);
+
+/**
+ * 输出下一对mark/space，全部输出完或者数据不完整、序号超出字典时返回false，
+ * 返回false后remaining不为0说明数据有问题，不要使用已经输出的部分
+ */
+bool ir_gree_learn_next(ir_gree_learn_reader_t *reader, ir_gree_pulse_t *pulse);
+
+#ifdef __cplusplus
+}
+#endif
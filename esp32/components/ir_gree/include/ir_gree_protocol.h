@@ -0,0 +1,60 @@
+/*
+ * 由tools/gen_protocol.py根据protocols/gree_yapof.json生成，不要手动修改
+ * 格力空调遥控器YAPOF，时长单位us
+ * MIN/MAX为接收时周期（mark + space）的窗口，开区间
+ */
+
+#pragma once
+
+// 引导码
+#define IR_GREE_LEADER_MARK_US 9000
+#define IR_GREE_LEADER_SPACE_US 4500
+#define IR_GREE_LEADER_MIN_US 12000
+#define IR_GREE_LEADER_MAX_US 15000
+
+// 数据码 0
+#define IR_GREE_ZERO_MARK_US 660
+#define IR_GREE_ZERO_SPACE_US 540
+#define IR_GREE_ZERO_MIN_US 1080
+#define IR_GREE_ZERO_MAX_US 1440
+
+// 数据码 1
+#define IR_GREE_ONE_MARK_US 660
+#define IR_GREE_ONE_SPACE_US 1680
+#define IR_GREE_ONE_MIN_US 2080
+#define IR_GREE_ONE_MAX_US 2550
+
+// 短连接码
+#define IR_GREE_CONNECT_MARK_US 660
+#define IR_GREE_CONNECT_SPACE_US 20000
+#define IR_GREE_CONNECT_MIN_US 20500
+#define IR_GREE_CONNECT_MAX_US 20800
+
+// 长连接码
+#define IR_GREE_LONG_CONNECT_MARK_US 660
+#define IR_GREE_LONG_CONNECT_SPACE_US 40000
+#define IR_GREE_LONG_CONNECT_MIN_US 40000
+#define IR_GREE_LONG_CONNECT_MAX_US 41500
+
+// 结束码，后面没有空闲
+#define IR_GREE_END_MARK_US 660
+
+// 每段的数据位数，带固定尾部的段后面还有3位010（低位先发）
+#define IR_GREE_DATA_BITS 32
+#define IR_GREE_TAIL_BITS 0x2
+#define IR_GREE_TAIL_BIT_COUNT 3
+
+#define IR_GREE_SEGMENT_NUM 4
+// 所有段的位数，包括固定尾部
+#define IR_GREE_PACKED_BITS 134
+// 整帧的mark/space对数
+#define IR_GREE_FRAME_PULSES 140
+
+// ir_gree_segments的初始值：段的位数和段后的符号
+#define IR_GREE_SEGMENTS_INIT \
+    { \
+        {35, IR_GREE_SYM_CONNECT}, \
+        {32, IR_GREE_SYM_LONG_CONNECT}, \
+        {35, IR_GREE_SYM_CONNECT}, \
+        {32, IR_GREE_SYM_END}, \
+    }
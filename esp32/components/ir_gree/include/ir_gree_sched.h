@@ -0,0 +1,60 @@
+/*
+ * 定时命令，每条是一个JSON对象，定时字段和空调字段放在一起：
+ *   {"id":"evening","at":"18:00","days":"12345","power":1,"mode":"cool","temp":26}
+ *
+ *   id: 名字，最长IR_GREE_SCHED_ID_MAX个字符，同名的覆盖
+ *   at: 本地时间 时:分
+ *   days: 星期几，0为周日，省略时每天
+ *   once: true时只执行一次，执行后删除
+ *
+ * 其余字段为命令，格式见ir_gree_cmd.h，到时整个对象交给ir_gree_cmd_parse，定时字段作为不认识的字段跳过
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IR_GREE_SCHED_ID_MAX 15
+// JSON的最大长度
+#define IR_GREE_SCHED_CMD_MAX 128
+#define IR_GREE_SCHED_ALL_DAYS 0x7F
+
+typedef enum
+{
+    IR_GREE_SCHED_OK = 0,
+    IR_GREE_SCHED_ERR_FORMAT, // 不是JSON对象，或者缺少id、at
+    IR_GREE_SCHED_ERR_RANGE,  // 时间、星期或者id超出范围
+    IR_GREE_SCHED_ERR_CMD,    // 命令字段不合法
+    IR_GREE_SCHED_ERR_SIZE,   // 超过IR_GREE_SCHED_CMD_MAX
+} ir_gree_sched_err_t;
+
+typedef struct
+{
+    char id[IR_GREE_SCHED_ID_MAX + 1];
+    uint16_t minute; // 一天中的第几分钟
+    uint8_t days;    // bit0为周日 ~ bit6为周六
+    bool once;
+    uint16_t len;
+    char cmd[IR_GREE_SCHED_CMD_MAX]; // 完整的JSON，不以0结尾
+} ir_gree_sched_t;
+
+/**
+ * 解析并检查一条定时命令，出错时sched保持不变
+ */
+ir_gree_sched_err_t ir_gree_sched_parse(const char *data, size_t len, ir_gree_sched_t *sched);
+
+/**
+ * now之后（不含now）下一次执行的时间，按本地时区（TZ）计算
+ */
+time_t ir_gree_sched_next(const ir_gree_sched_t *sched, time_t now);
+
+#ifdef __cplusplus
+}
+#endif
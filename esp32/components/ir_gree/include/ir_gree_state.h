@@ -0,0 +1,76 @@
+/*
+ * 格力空调状态与扫描码之间的转换
+ * 每个数据块8字节：data1为字节0~3，data2为字节4~7（data3/data4同理）
+ * 字节0：bit0~2模式，bit3开关，bit4~5风速，bit6扫风，bit7睡眠
+ * 字节1：bit0~3温度-16，bit4定时半小时，bit5~6定时十位，bit7定时开启
+ * 字节2：bit0~3定时个位，bit4强劲，bit5灯光
+ * 字节3：固定，第一块为0x50，第二块为0x70
+ * 字节4：bit0~3上下扫风
+ * 字节7：bit4~7校验和
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ir_gree_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GREE_TEMP_MIN 16
+#define GREE_TEMP_MAX 30
+// 定时单位为半小时，最长24小时
+#define GREE_TIMER_MAX 48
+
+typedef enum
+{
+    GREE_MODE_AUTO = 0,
+    GREE_MODE_COOL = 1,
+    GREE_MODE_DRY = 2,
+    GREE_MODE_FAN = 3,
+    GREE_MODE_HEAT = 4,
+} gree_mode_t;
+
+typedef enum
+{
+    GREE_FAN_AUTO = 0,
+    GREE_FAN_LOW = 1,
+    GREE_FAN_MEDIUM = 2,
+    GREE_FAN_HIGH = 3,
+} gree_fan_t;
+
+typedef struct
+{
+    uint8_t power;       // 0 关，1 开
+    uint8_t mode;        // gree_mode_t
+    uint8_t temperature; // 摄氏度，GREE_TEMP_MIN ~ GREE_TEMP_MAX
+    uint8_t fan;         // gree_fan_t
+    uint8_t swing;       // 0 关，1 自动扫风
+    uint8_t light;
+    uint8_t turbo;
+    uint8_t sleep;
+    uint8_t timer; // 半小时为单位，0为关闭
+} gree_state_t;
+
+/**
+ * 计算一个数据块的校验和，返回值已经移到高4位，直接放进字节7
+ */
+uint8_t gree_checksum(const uint8_t block[8]);
+
+/**
+ * 把状态打包成扫描码，包括固定位和校验和
+ * 温度和定时超出范围时取最近的边界（GREE_TEMP_MIN ~ GREE_TEMP_MAX、0 ~ GREE_TIMER_MAX），其余字段按位截断
+ */
+void gree_state_pack(const gree_state_t *state, ir_gree_scan_code_t *scan_code);
+
+/**
+ * 从扫描码解出状态，只看第一个数据块，校验和不对时返回false
+ */
+bool gree_state_unpack(const ir_gree_scan_code_t *scan_code, gree_state_t *state);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+/*
+ * 分层时间轮，定时任务按到期的tick挂在槽中，插入、删除和每个tick的到期处理都是O(1)
+ *
+ * 4层，每层64个槽：第0层每槽1个tick，第1层64个tick，第2层4096个tick，第3层262144个tick，
+ * 以秒为tick时最远约194天。离到期越远挂在越高的层，高层的槽轮到时整槽降到下面的层（cascade）
+ *
+ * 节点由调用者提供，按序号引用，不分配内存；时间轮只管到期，不关心tick对应的时间
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IR_GREE_WHEEL_BITS 6
+#define IR_GREE_WHEEL_SLOTS (1 << IR_GREE_WHEEL_BITS)
+#define IR_GREE_WHEEL_LEVELS 4
+// 最远能挂多少个tick之后，更远的先挂在最远处，到时重新挂
+#define IR_GREE_WHEEL_SPAN ((uint32_t)1 << (IR_GREE_WHEEL_BITS * IR_GREE_WHEEL_LEVELS))
+#define IR_GREE_WHEEL_NONE 0xFFFF
+
+typedef struct
+{
+    uint32_t expires;
+    uint16_t prev;
+    uint16_t next;
+    // 挂在哪一层的哪个槽，不在轮上时pending为false
+    uint8_t level;
+    uint8_t slot;
+    bool pending;
+} ir_gree_wheel_node_t;
+
+typedef struct
+{
+    ir_gree_wheel_node_t *nodes;
+    size_t node_num;
+    // 最后处理完的tick
+    uint32_t now;
+    uint16_t slots[IR_GREE_WHEEL_LEVELS][IR_GREE_WHEEL_SLOTS];
+} ir_gree_wheel_t;
+
+// 到期回调，调用时节点已经摘下，可以在回调中重新挂上
+typedef void (*ir_gree_wheel_cb_t)(void *ctx, uint16_t index);
+
+/**
+ * 初始化时间轮，nodes中的节点都不在轮上，now为当前tick
+ */
+void ir_gree_wheel_init(ir_gree_wheel_t *wheel, ir_gree_wheel_node_t *nodes, size_t node_num, uint32_t now);
+
+/**
+ * 把节点挂在expires到期，已经挂上的先摘下；expires不晚于now时在下一个tick到期
+ */
+void ir_gree_wheel_add(ir_gree_wheel_t *wheel, uint16_t index, uint32_t expires);
+
+/**
+ * 摘下节点，不在轮上时什么也不做
+ */
+void ir_gree_wheel_del(ir_gree_wheel_t *wheel, uint16_t index);
+
+/**
+ * 逐个tick前进到now，对到期的节点调用cb，now不晚于当前tick时什么也不做
+ */
+void ir_gree_wheel_advance(ir_gree_wheel_t *wheel, uint32_t now, ir_gree_wheel_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,199 @@
+#include <string.h>
+
+#include "ir_gree_calib.h"
+
+// 中心不再变化就提前结束，一般两三次
+#define IR_GREE_CALIB_ITERATIONS 8
+// 样本数不到所属类的1/32的格不计入窗口
+#define IR_GREE_CALIB_SPARSE_RATIO 32
+
+static const uint32_t s_nominal[IR_GREE_CALIB_CLASS_NUM] = {
+    [IR_GREE_CALIB_ZERO] = IR_GREE_ZERO_MARK_US + IR_GREE_ZERO_SPACE_US,
+    [IR_GREE_CALIB_ONE] = IR_GREE_ONE_MARK_US + IR_GREE_ONE_SPACE_US,
+    [IR_GREE_CALIB_LEADER] = IR_GREE_LEADER_MARK_US + IR_GREE_LEADER_SPACE_US,
+    [IR_GREE_CALIB_CONNECT] = IR_GREE_CONNECT_MARK_US + IR_GREE_CONNECT_SPACE_US,
+    [IR_GREE_CALIB_LONG_CONNECT] = IR_GREE_LONG_CONNECT_MARK_US + IR_GREE_LONG_CONNECT_SPACE_US,
+};
+
+static int ir_gree_calib_msb(uint32_t value)
+{
+    return 31 - __builtin_clz(value);
+}
+
+// 格的下边界，bin为IR_GREE_CALIB_BINS时为直方图的上边界
+static uint32_t ir_gree_calib_bin_start(int bin)
+{
+    int octave = bin / IR_GREE_CALIB_STEPS;
+    int step = bin % IR_GREE_CALIB_STEPS;
+    return (uint32_t)(IR_GREE_CALIB_STEPS + step) * (IR_GREE_CALIB_MIN_US << octave) / IR_GREE_CALIB_STEPS;
+}
+
+static uint32_t ir_gree_calib_isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    for (uint64_t bit = 1ULL << 62; bit; bit >>= 2)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+// 按对数距离取最近的类，分界为相邻中心的几何平均，离中心太远返回-1
+static int ir_gree_calib_nearest(const uint32_t *centers, uint32_t period)
+{
+    int k = 0;
+    while (k + 1 < IR_GREE_CALIB_CLASS_NUM && (uint64_t)period * period > (uint64_t)centers[k] * centers[k + 1])
+    {
+        k++;
+    }
+    uint32_t diff = period > centers[k] ? period - centers[k] : centers[k] - period;
+    return (uint64_t)diff * 100 > (uint64_t)centers[k] * IR_GREE_CALIB_OUTLIER_PCT ? -1 : k;
+}
+
+void ir_gree_calib_init(ir_gree_calib_t *calib)
+{
+    memset(calib, 0, sizeof(*calib));
+}
+
+void ir_gree_calib_add(ir_gree_calib_t *calib, uint32_t period)
+{
+    if (period < IR_GREE_CALIB_MIN_US || period >= ir_gree_calib_bin_start(IR_GREE_CALIB_BINS))
+    {
+        calib->outliers++;
+        return;
+    }
+    if (calib->total >= IR_GREE_CALIB_TOTAL_MAX)
+    {
+        calib->total = 0;
+        for (int i = 0; i < IR_GREE_CALIB_BINS; i++)
+        {
+            calib->counts[i] /= 2;
+            calib->sums[i] /= 2;
+            calib->total += calib->counts[i];
+        }
+    }
+
+    int msb = ir_gree_calib_msb(period);
+    int octave = msb - ir_gree_calib_msb(IR_GREE_CALIB_MIN_US);
+    int step = (uint64_t)(period - (1UL << msb)) * IR_GREE_CALIB_STEPS >> msb;
+    int bin = octave * IR_GREE_CALIB_STEPS + step;
+    calib->counts[bin]++;
+    calib->sums[bin] += period;
+    calib->total++;
+}
+
+bool ir_gree_calib_solve(const ir_gree_calib_t *calib, ir_gree_windows_t *windows, ir_gree_calib_stat_t *stats)
+{
+    uint32_t centers[IR_GREE_CALIB_CLASS_NUM];
+    uint64_t sums[IR_GREE_CALIB_CLASS_NUM];
+    uint32_t counts[IR_GREE_CALIB_CLASS_NUM];
+    uint32_t lows[IR_GREE_CALIB_CLASS_NUM];
+    uint32_t highs[IR_GREE_CALIB_CLASS_NUM];
+
+    memcpy(centers, s_nominal, sizeof(centers));
+    for (int iteration = 0; iteration < IR_GREE_CALIB_ITERATIONS; iteration++)
+    {
+        memset(sums, 0, sizeof(sums));
+        memset(counts, 0, sizeof(counts));
+        for (int bin = 0; bin < IR_GREE_CALIB_BINS; bin++)
+        {
+            if (calib->counts[bin] == 0)
+            {
+                continue;
+            }
+            int k = ir_gree_calib_nearest(centers, calib->sums[bin] / calib->counts[bin]);
+            if (k < 0)
+            {
+                continue;
+            }
+            sums[k] += calib->sums[bin];
+            counts[k] += calib->counts[bin];
+        }
+
+        bool changed = false;
+        for (int k = 0; k < IR_GREE_CALIB_CLASS_NUM; k++)
+        {
+            uint32_t center = counts[k] ? (sums[k] + counts[k] / 2) / counts[k] : centers[k];
+            changed |= center != centers[k];
+            centers[k] = center;
+        }
+        if (!changed)
+        {
+            break;
+        }
+    }
+
+    // 类的范围只算样本较多的格，零星的干扰不会把窗口撑大
+    memset(highs, 0, sizeof(highs));
+    memset(lows, 0xFF, sizeof(lows));
+    for (int bin = 0; bin < IR_GREE_CALIB_BINS; bin++)
+    {
+        if (calib->counts[bin] == 0)
+        {
+            continue;
+        }
+        int k = ir_gree_calib_nearest(centers, calib->sums[bin] / calib->counts[bin]);
+        if (k < 0 || (uint32_t)calib->counts[bin] * IR_GREE_CALIB_SPARSE_RATIO < counts[k])
+        {
+            continue;
+        }
+        uint32_t start = ir_gree_calib_bin_start(bin);
+        uint32_t end = ir_gree_calib_bin_start(bin + 1);
+        lows[k] = start < lows[k] ? start : lows[k];
+        highs[k] = end > highs[k] ? end : highs[k];
+    }
+
+    ir_gree_windows_t result = *windows;
+    ir_gree_window_t *targets[IR_GREE_CALIB_CLASS_NUM] = {
+        [IR_GREE_CALIB_ZERO] = &result.zero,
+        [IR_GREE_CALIB_ONE] = &result.one,
+        [IR_GREE_CALIB_LEADER] = &result.leader,
+        [IR_GREE_CALIB_CONNECT] = &result.connect,
+        [IR_GREE_CALIB_LONG_CONNECT] = &result.long_connect,
+    };
+    for (int k = 0; k < IR_GREE_CALIB_CLASS_NUM; k++)
+    {
+        if (counts[k] >= IR_GREE_CALIB_MIN_COUNT)
+        {
+            uint32_t margin = centers[k] * IR_GREE_CALIB_MARGIN_PCT / 100;
+            uint32_t min = lows[k] - margin;
+            uint32_t max = highs[k] + margin;
+            // 窗口为开区间，分界上的周期归较短的一类
+            if (k > 0)
+            {
+                uint32_t limit = ir_gree_calib_isqrt((uint64_t)centers[k - 1] * centers[k]);
+                min = min > limit ? min : limit;
+            }
+            if (k + 1 < IR_GREE_CALIB_CLASS_NUM)
+            {
+                uint32_t limit = ir_gree_calib_isqrt((uint64_t)centers[k] * centers[k + 1]) + 1;
+                max = max < limit ? max : limit;
+            }
+            targets[k]->min = min;
+            targets[k]->max = max;
+        }
+        if (stats)
+        {
+            stats[k].count = counts[k];
+            stats[k].center = centers[k];
+            stats[k].window = *targets[k];
+        }
+    }
+
+    if (counts[IR_GREE_CALIB_ZERO] < IR_GREE_CALIB_MIN_COUNT || counts[IR_GREE_CALIB_ONE] < IR_GREE_CALIB_MIN_COUNT ||
+        counts[IR_GREE_CALIB_LEADER] < IR_GREE_CALIB_MIN_COUNT ||
+        counts[IR_GREE_CALIB_ZERO] + counts[IR_GREE_CALIB_ONE] < IR_GREE_CALIB_MIN_BITS)
+    {
+        return false;
+    }
+    *windows = result;
+    return true;
+}
@@ -0,0 +1,465 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_gree_cmd.h"
+
+typedef struct
+{
+    const char *p;
+    const char *end;
+} ir_gree_cmd_reader_t;
+
+typedef struct
+{
+    const char *name;
+    uint8_t value;
+} ir_gree_cmd_name_t;
+
+static const ir_gree_cmd_name_t s_mode_names[] = {
+    {"auto", GREE_MODE_AUTO},
+    {"cool", GREE_MODE_COOL},
+    {"dry", GREE_MODE_DRY},
+    {"fan", GREE_MODE_FAN},
+    {"heat", GREE_MODE_HEAT},
+    {NULL, 0},
+};
+
+static const ir_gree_cmd_name_t s_fan_names[] = {
+    {"auto", GREE_FAN_AUTO},
+    {"low", GREE_FAN_LOW},
+    {"medium", GREE_FAN_MEDIUM},
+    {"high", GREE_FAN_HIGH},
+    {NULL, 0},
+};
+
+// 命令中的字段，顺序即二进制格式中的顺序，size为字段的字节数（1或2）
+typedef struct
+{
+    const char *key;
+    const char *alias;
+    size_t offset;
+    uint8_t size;
+    uint16_t min;
+    uint16_t max;
+    const ir_gree_cmd_name_t *names;
+} ir_gree_cmd_field_t;
+
+// gree_state_t中的字段
+static const ir_gree_cmd_field_t s_fields[] = {
+    {"power", NULL, offsetof(gree_state_t, power), 1, 0, 1, NULL},
+    {"mode", NULL, offsetof(gree_state_t, mode), 1, GREE_MODE_AUTO, GREE_MODE_HEAT, s_mode_names},
+    {"temp", "temperature", offsetof(gree_state_t, temperature), 1, GREE_TEMP_MIN, GREE_TEMP_MAX, NULL},
+    {"fan", NULL, offsetof(gree_state_t, fan), 1, GREE_FAN_AUTO, GREE_FAN_HIGH, s_fan_names},
+    {"swing", NULL, offsetof(gree_state_t, swing), 1, 0, 1, NULL},
+    {"light", NULL, offsetof(gree_state_t, light), 1, 0, 1, NULL},
+    {"turbo", NULL, offsetof(gree_state_t, turbo), 1, 0, 1, NULL},
+    {"sleep", NULL, offsetof(gree_state_t, sleep), 1, 0, 1, NULL},
+    {"timer", NULL, offsetof(gree_state_t, timer), 1, 0, GREE_TIMER_MAX, NULL},
+};
+
+// ir_gree_cmd_opts_t中的字段，二进制格式版本2中跟在状态后面
+static const ir_gree_cmd_field_t s_opt_fields[] = {
+    {"repeat", NULL, offsetof(ir_gree_cmd_opts_t, repeat), 1, 0, IR_GREE_CMD_REPEAT_MAX, NULL},
+    {"gap_ms", "gap", offsetof(ir_gree_cmd_opts_t, gap_ms), 2, 0, IR_GREE_CMD_GAP_MAX_MS, NULL},
+};
+
+#define IR_GREE_CMD_FIELD_NUM (sizeof(s_fields) / sizeof(s_fields[0]))
+#define IR_GREE_CMD_OPT_FIELD_NUM (sizeof(s_opt_fields) / sizeof(s_opt_fields[0]))
+
+_Static_assert(IR_GREE_CMD_FIELD_NUM == IR_GREE_CMD_STATE_FIELDS, "IR_GREE_CMD_STATE_FIELDS");
+
+static bool ir_gree_cmd_token_eq(const char *token, size_t len, const char *name)
+{
+    return strlen(name) == len && memcmp(token, name, len) == 0;
+}
+
+static const ir_gree_cmd_field_t *ir_gree_cmd_find(const ir_gree_cmd_field_t *fields, size_t num, const char *key, size_t len)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        if (ir_gree_cmd_token_eq(key, len, fields[i].key) ||
+            (fields[i].alias && ir_gree_cmd_token_eq(key, len, fields[i].alias)))
+        {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+static int ir_gree_cmd_load(const void *base, const ir_gree_cmd_field_t *field)
+{
+    if (field->size == 2)
+    {
+        uint16_t v;
+        memcpy(&v, (const uint8_t *)base + field->offset, sizeof(v));
+        return v;
+    }
+    return *((const uint8_t *)base + field->offset);
+}
+
+// 检查范围后写入字段
+static ir_gree_cmd_err_t ir_gree_cmd_store(void *base, const ir_gree_cmd_field_t *field, int value)
+{
+    if (value < field->min || value > field->max)
+    {
+        return IR_GREE_CMD_ERR_RANGE;
+    }
+    if (field->size == 2)
+    {
+        uint16_t v = value;
+        memcpy((uint8_t *)base + field->offset, &v, sizeof(v));
+    }
+    else
+    {
+        *((uint8_t *)base + field->offset) = value;
+    }
+    return IR_GREE_CMD_OK;
+}
+
+static void ir_gree_cmd_skip_ws(ir_gree_cmd_reader_t *r)
+{
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\r' || *r->p == '\n'))
+    {
+        r->p++;
+    }
+}
+
+static bool ir_gree_cmd_expect(ir_gree_cmd_reader_t *r, char c)
+{
+    ir_gree_cmd_skip_ws(r);
+    if (r->p < r->end && *r->p == c)
+    {
+        r->p++;
+        return true;
+    }
+    return false;
+}
+
+// 命令中的字符串不需要转义，遇到转义直接当作格式错误
+static bool ir_gree_cmd_string(ir_gree_cmd_reader_t *r, const char **str, size_t *len)
+{
+    if (!ir_gree_cmd_expect(r, '"'))
+    {
+        return false;
+    }
+    *str = r->p;
+    while (r->p < r->end && *r->p != '"')
+    {
+        if (*r->p == '\\')
+        {
+            return false;
+        }
+        r->p++;
+    }
+    if (r->p == r->end)
+    {
+        return false;
+    }
+    *len = r->p - *str;
+    r->p++;
+    return true;
+}
+
+// 解析数字、true/false或名字，结果限制在0~65535，超出范围交给调用者判断
+static ir_gree_cmd_err_t ir_gree_cmd_value(ir_gree_cmd_reader_t *r, const ir_gree_cmd_name_t *names, int *value)
+{
+    ir_gree_cmd_skip_ws(r);
+    if (r->p == r->end)
+    {
+        return IR_GREE_CMD_ERR_FORMAT;
+    }
+
+    if (*r->p == '"')
+    {
+        const char *str;
+        size_t len;
+        if (!ir_gree_cmd_string(r, &str, &len))
+        {
+            return IR_GREE_CMD_ERR_FORMAT;
+        }
+        for (; names && names->name; names++)
+        {
+            if (ir_gree_cmd_token_eq(str, len, names->name))
+            {
+                *value = names->value;
+                return IR_GREE_CMD_OK;
+            }
+        }
+        return IR_GREE_CMD_ERR_RANGE;
+    }
+
+    if (*r->p >= '0' && *r->p <= '9')
+    {
+        int v = 0;
+        bool overflow = false;
+        // 超出范围也要读完整个数字，不认识的字段才能继续跳过
+        while (r->p < r->end && *r->p >= '0' && *r->p <= '9')
+        {
+            v = v * 10 + (*r->p - '0');
+            if (v > 0xFFFF)
+            {
+                overflow = true;
+                v = 0xFFFF;
+            }
+            r->p++;
+        }
+        *value = v;
+        return overflow ? IR_GREE_CMD_ERR_RANGE : IR_GREE_CMD_OK;
+    }
+
+    const char *word = r->p;
+    while (r->p < r->end && *r->p >= 'a' && *r->p <= 'z')
+    {
+        r->p++;
+    }
+    if (ir_gree_cmd_token_eq(word, r->p - word, "true"))
+    {
+        *value = 1;
+        return IR_GREE_CMD_OK;
+    }
+    if (ir_gree_cmd_token_eq(word, r->p - word, "false"))
+    {
+        *value = 0;
+        return IR_GREE_CMD_OK;
+    }
+    return IR_GREE_CMD_ERR_FORMAT;
+}
+
+static ir_gree_cmd_err_t ir_gree_cmd_parse_json(ir_gree_cmd_reader_t *r, gree_state_t *state, ir_gree_cmd_opts_t *opts)
+{
+    if (!ir_gree_cmd_expect(r, '{'))
+    {
+        return IR_GREE_CMD_ERR_FORMAT;
+    }
+    if (ir_gree_cmd_expect(r, '}'))
+    {
+        goto done;
+    }
+
+    do
+    {
+        const char *key;
+        size_t key_len;
+        int value;
+        const ir_gree_cmd_field_t *field;
+        void *base = state;
+
+        if (!ir_gree_cmd_string(r, &key, &key_len) || !ir_gree_cmd_expect(r, ':'))
+        {
+            return IR_GREE_CMD_ERR_FORMAT;
+        }
+        field = ir_gree_cmd_find(s_fields, IR_GREE_CMD_FIELD_NUM, key, key_len);
+        if (!field)
+        {
+            field = ir_gree_cmd_find(s_opt_fields, IR_GREE_CMD_OPT_FIELD_NUM, key, key_len);
+            base = opts;
+        }
+        ir_gree_cmd_err_t err = ir_gree_cmd_value(r, field ? field->names : NULL, &value);
+        // 不认识的字段跳过，但值的格式必须正确
+        if (!field)
+        {
+            if (err == IR_GREE_CMD_ERR_FORMAT)
+            {
+                return err;
+            }
+            continue;
+        }
+        if (err == IR_GREE_CMD_OK)
+        {
+            err = ir_gree_cmd_store(base, field, value);
+        }
+        if (err != IR_GREE_CMD_OK)
+        {
+            return err;
+        }
+    } while (ir_gree_cmd_expect(r, ','));
+
+    if (!ir_gree_cmd_expect(r, '}'))
+    {
+        return IR_GREE_CMD_ERR_FORMAT;
+    }
+done:
+    ir_gree_cmd_skip_ws(r);
+    return r->p == r->end ? IR_GREE_CMD_OK : IR_GREE_CMD_ERR_FORMAT;
+}
+
+// 依次解析fields中的字段，多字节字段为小端，返回读取的字节数，出错返回0
+static size_t ir_gree_cmd_parse_fields(const uint8_t *data, const ir_gree_cmd_field_t *fields, size_t num, void *base, ir_gree_cmd_err_t *err)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < num; i++)
+    {
+        int value = p[0];
+        if (fields[i].size == 2)
+        {
+            value |= p[1] << 8;
+        }
+        p += fields[i].size;
+        *err = ir_gree_cmd_store(base, &fields[i], value);
+        if (*err != IR_GREE_CMD_OK)
+        {
+            return 0;
+        }
+    }
+    return p - data;
+}
+
+static ir_gree_cmd_err_t ir_gree_cmd_parse_binary(const uint8_t *data, size_t len, gree_state_t *state, ir_gree_cmd_opts_t *opts)
+{
+    ir_gree_cmd_err_t err = IR_GREE_CMD_OK;
+    size_t expected = data[1] == IR_GREE_CMD_VERSION ? IR_GREE_CMD_BINARY_SIZE : IR_GREE_CMD_BINARY_V2_SIZE;
+
+    if ((data[1] != IR_GREE_CMD_VERSION && data[1] != IR_GREE_CMD_VERSION_2) || len != expected)
+    {
+        return IR_GREE_CMD_ERR_FORMAT;
+    }
+    size_t used = ir_gree_cmd_parse_fields(data + 2, s_fields, IR_GREE_CMD_FIELD_NUM, state, &err);
+    if (err == IR_GREE_CMD_OK && data[1] == IR_GREE_CMD_VERSION_2)
+    {
+        ir_gree_cmd_parse_fields(data + 2 + used, s_opt_fields, IR_GREE_CMD_OPT_FIELD_NUM, opts, &err);
+    }
+    return err;
+}
+
+ir_gree_cmd_err_t ir_gree_cmd_parse(const char *data, size_t len, gree_state_t *state, ir_gree_cmd_opts_t *opts)
+{
+    // 先解析到副本，成功后再整体更新
+    gree_state_t next = *state;
+    ir_gree_cmd_opts_t next_opts = {0};
+    ir_gree_cmd_err_t err;
+
+    if (opts)
+    {
+        next_opts = *opts;
+    }
+    if (len >= 2 && data[0] == IR_GREE_CMD_MAGIC)
+    {
+        err = ir_gree_cmd_parse_binary((const uint8_t *)data, len, &next, &next_opts);
+    }
+    else
+    {
+        ir_gree_cmd_reader_t reader = {
+            .p = data,
+            .end = data + len,
+        };
+        err = ir_gree_cmd_parse_json(&reader, &next, &next_opts);
+    }
+
+    if (err == IR_GREE_CMD_OK)
+    {
+        *state = next;
+        if (opts)
+        {
+            *opts = next_opts;
+        }
+    }
+    return err;
+}
+
+bool ir_gree_cmd_lookup(const char *data, size_t len, const char *key, const char **value, size_t *value_len)
+{
+    ir_gree_cmd_reader_t reader = {
+        .p = data,
+        .end = data + len,
+    };
+    ir_gree_cmd_reader_t *r = &reader;
+    if (!ir_gree_cmd_expect(r, '{') || ir_gree_cmd_expect(r, '}'))
+    {
+        return false;
+    }
+
+    do
+    {
+        const char *k;
+        size_t k_len;
+        const char *v;
+        size_t v_len;
+        if (!ir_gree_cmd_string(r, &k, &k_len) || !ir_gree_cmd_expect(r, ':'))
+        {
+            return false;
+        }
+        ir_gree_cmd_skip_ws(r);
+        if (r->p < r->end && *r->p == '"')
+        {
+            if (!ir_gree_cmd_string(r, &v, &v_len))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            v = r->p;
+            while (r->p < r->end && ((*r->p >= '0' && *r->p <= '9') || (*r->p >= 'a' && *r->p <= 'z')))
+            {
+                r->p++;
+            }
+            v_len = r->p - v;
+            if (v_len == 0)
+            {
+                return false;
+            }
+        }
+        if (ir_gree_cmd_token_eq(k, k_len, key))
+        {
+            *value = v;
+            *value_len = v_len;
+            return true;
+        }
+    } while (ir_gree_cmd_expect(r, ','));
+    return false;
+}
+
+uint16_t ir_gree_cmd_diff(const gree_state_t *a, const gree_state_t *b)
+{
+    uint16_t mask = 0;
+    for (size_t i = 0; i < IR_GREE_CMD_FIELD_NUM; i++)
+    {
+        if (ir_gree_cmd_load(a, &s_fields[i]) != ir_gree_cmd_load(b, &s_fields[i]))
+        {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+const char *ir_gree_cmd_key(size_t index)
+{
+    return index < IR_GREE_CMD_FIELD_NUM ? s_fields[index].key : NULL;
+}
+
+int ir_gree_cmd_format_value(const gree_state_t *state, size_t index, char *buf, size_t size)
+{
+    if (index >= IR_GREE_CMD_FIELD_NUM)
+    {
+        return -1;
+    }
+    const ir_gree_cmd_field_t *field = &s_fields[index];
+    int value = ir_gree_cmd_load(state, field);
+    for (const ir_gree_cmd_name_t *name = field->names; name && name->name; name++)
+    {
+        if (name->value == value)
+        {
+            return snprintf(buf, size, "\"%s\"", name->name);
+        }
+    }
+    return snprintf(buf, size, "%d", value);
+}
+
+int ir_gree_cmd_format(const gree_state_t *state, uint16_t mask, char *buf, size_t size)
+{
+    // 同snprintf，空间不够时截断，返回完整的长度
+    size_t len = snprintf(buf, size, "{");
+    for (size_t i = 0; i < IR_GREE_CMD_FIELD_NUM; i++)
+    {
+        char value[16];
+        if (!(mask & (1u << i)))
+        {
+            continue;
+        }
+        ir_gree_cmd_format_value(state, i, value, sizeof(value));
+        len += snprintf(len < size ? buf + len : NULL, len < size ? size - len : 0, "%s\"%s\":%s",
+                        len > 1 ? "," : "", s_fields[i].key, value);
+    }
+    len += snprintf(len < size ? buf + len : NULL, len < size ? size - len : 0, "}");
+    return len;
+}
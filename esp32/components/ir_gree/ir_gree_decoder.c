@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "ir_gree_decoder.h"
+
+// 与ir_gree/pd.py相同，都由protocols/gree_yapof.json生成
+const ir_gree_windows_t ir_gree_default_windows = {
+    .leader = {IR_GREE_LEADER_MIN_US, IR_GREE_LEADER_MAX_US},
+    .connect = {IR_GREE_CONNECT_MIN_US, IR_GREE_CONNECT_MAX_US},
+    .long_connect = {IR_GREE_LONG_CONNECT_MIN_US, IR_GREE_LONG_CONNECT_MAX_US},
+    .zero = {IR_GREE_ZERO_MIN_US, IR_GREE_ZERO_MAX_US},
+    .one = {IR_GREE_ONE_MIN_US, IR_GREE_ONE_MAX_US},
+};
+
+enum
+{
+    IR_GREE_DEC_IDLE,   // 等待第一个引导码
+    IR_GREE_DEC_BITS,   // 接收当前段的数据码
+    IR_GREE_DEC_GAP,    // 等待当前段后的连接码
+    IR_GREE_DEC_LEADER, // 长连接码之后，等待下一段前的引导码
+};
+
+static bool ir_gree_in_window(const ir_gree_window_t *window, uint32_t period)
+{
+    return period > window->min && period < window->max;
+}
+
+ir_gree_sym_t ir_gree_classify(const ir_gree_windows_t *windows, uint32_t period)
+{
+    if (ir_gree_in_window(&windows->zero, period))
+    {
+        return IR_GREE_SYM_ZERO;
+    }
+    if (ir_gree_in_window(&windows->one, period))
+    {
+        return IR_GREE_SYM_ONE;
+    }
+    if (ir_gree_in_window(&windows->leader, period))
+    {
+        return IR_GREE_SYM_LEADER;
+    }
+    if (ir_gree_in_window(&windows->connect, period))
+    {
+        return IR_GREE_SYM_CONNECT;
+    }
+    if (ir_gree_in_window(&windows->long_connect, period))
+    {
+        return IR_GREE_SYM_LONG_CONNECT;
+    }
+    return IR_GREE_SYM_INVALID;
+}
+
+void ir_gree_decoder_init(ir_gree_decoder_t *decoder, const ir_gree_windows_t *windows)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->windows = windows ? windows : &ir_gree_default_windows;
+    decoder->state = IR_GREE_DEC_IDLE;
+}
+
+static void ir_gree_decoder_next(ir_gree_decoder_t *decoder, int state, int segment)
+{
+    decoder->state = state;
+    decoder->segment = segment;
+    decoder->bits = 0;
+    if (segment < IR_GREE_SEGMENT_NUM)
+    {
+        decoder->data[segment] = 0;
+    }
+}
+
+bool ir_gree_decoder_feed_symbol(ir_gree_decoder_t *decoder, ir_gree_sym_t sym, ir_gree_scan_code_t *scan_code)
+{
+    const ir_gree_segment_t *segment = &ir_gree_segments[decoder->segment];
+
+    if (sym == IR_GREE_SYM_LEADER)
+    {
+        // 长连接码之后的引导码开始下一段，其他情况都从头开始
+        ir_gree_decoder_next(decoder, IR_GREE_DEC_BITS, decoder->state == IR_GREE_DEC_LEADER ? decoder->segment : 0);
+        return false;
+    }
+
+    switch (decoder->state)
+    {
+    case IR_GREE_DEC_BITS:
+        if (sym != IR_GREE_SYM_ZERO && sym != IR_GREE_SYM_ONE)
+        {
+            break;
+        }
+        // 低位先发，带固定尾部的段后几位不保存
+        if (sym == IR_GREE_SYM_ONE && decoder->bits < IR_GREE_DATA_BITS)
+        {
+            decoder->data[decoder->segment] |= 1UL << decoder->bits;
+        }
+        if (++decoder->bits < segment->bits)
+        {
+            return false;
+        }
+        if (segment->gap == IR_GREE_SYM_END)
+        {
+            // 最后一位的周期结束于结束码的下降沿，到这里整帧已经收完
+            scan_code->data1 = decoder->data[0];
+            scan_code->data2 = decoder->data[1];
+            scan_code->data3 = decoder->data[2];
+            scan_code->data4 = decoder->data[3];
+            ir_gree_decoder_next(decoder, IR_GREE_DEC_IDLE, 0);
+            return true;
+        }
+        decoder->state = IR_GREE_DEC_GAP;
+        return false;
+    case IR_GREE_DEC_GAP:
+        if (segment->gap == IR_GREE_SYM_CONNECT && sym == IR_GREE_SYM_CONNECT)
+        {
+            ir_gree_decoder_next(decoder, IR_GREE_DEC_BITS, decoder->segment + 1);
+            return false;
+        }
+        // 40ms超过了接收超时，长连接码常常表现为一段脉冲的结束
+        if (segment->gap == IR_GREE_SYM_LONG_CONNECT && (sym == IR_GREE_SYM_LONG_CONNECT || sym == IR_GREE_SYM_END))
+        {
+            ir_gree_decoder_next(decoder, IR_GREE_DEC_LEADER, decoder->segment + 1);
+            return false;
+        }
+        break;
+    case IR_GREE_DEC_LEADER:
+        // 长连接码之后只能是引导码，其他都丢弃当前帧，后半帧不会拼到前半帧上
+        break;
+    default:
+        return false;
+    }
+
+    ir_gree_decoder_next(decoder, IR_GREE_DEC_IDLE, 0);
+    return false;
+}
+
+bool ir_gree_decoder_feed(ir_gree_decoder_t *decoder, uint32_t mark, uint32_t space, ir_gree_scan_code_t *scan_code)
+{
+    ir_gree_sym_t sym = space ? ir_gree_classify(decoder->windows, mark + space) : IR_GREE_SYM_END;
+    return ir_gree_decoder_feed_symbol(decoder, sym, scan_code);
+}
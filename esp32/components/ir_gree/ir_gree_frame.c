@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "ir_gree_frame.h"
+
+// 注意数据段3和4，不是1和2的重复，有不同内容
+const ir_gree_segment_t ir_gree_segments[IR_GREE_SEGMENT_NUM] = IR_GREE_SEGMENTS_INIT;
+
+static const ir_gree_pulse_t s_sym_pulses[IR_GREE_SYM_NUM] = {
+    [IR_GREE_SYM_LEADER] = {IR_GREE_LEADER_MARK_US, IR_GREE_LEADER_SPACE_US},
+    [IR_GREE_SYM_ZERO] = {IR_GREE_ZERO_MARK_US, IR_GREE_ZERO_SPACE_US},
+    [IR_GREE_SYM_ONE] = {IR_GREE_ONE_MARK_US, IR_GREE_ONE_SPACE_US},
+    [IR_GREE_SYM_CONNECT] = {IR_GREE_CONNECT_MARK_US, IR_GREE_CONNECT_SPACE_US},
+    [IR_GREE_SYM_LONG_CONNECT] = {IR_GREE_LONG_CONNECT_MARK_US, IR_GREE_LONG_CONNECT_SPACE_US},
+    [IR_GREE_SYM_END] = {IR_GREE_END_MARK_US, 0},
+};
+
+enum
+{
+    IR_GREE_CURSOR_LEADER,
+    IR_GREE_CURSOR_BITS,
+    IR_GREE_CURSOR_DONE,
+};
+
+ir_gree_pulse_t ir_gree_sym_pulse(ir_gree_sym_t sym)
+{
+    return s_sym_pulses[sym < IR_GREE_SYM_NUM ? sym : IR_GREE_SYM_INVALID];
+}
+
+void ir_gree_pack(const ir_gree_scan_code_t *scan_code, ir_gree_packed_t *packed)
+{
+    const uint32_t data[IR_GREE_SEGMENT_NUM] = {scan_code->data1, scan_code->data2, scan_code->data3, scan_code->data4};
+    size_t offset = 0;
+
+    memset(packed, 0, sizeof(*packed));
+    for (int i = 0; i < IR_GREE_SEGMENT_NUM; i++)
+    {
+        for (int bit = 0; bit < ir_gree_segments[i].bits; bit++, offset++)
+        {
+            uint32_t value = bit < IR_GREE_DATA_BITS ? data[i] >> bit : (uint32_t)IR_GREE_TAIL_BITS >> (bit - IR_GREE_DATA_BITS);
+            if (value & 1)
+            {
+                packed->bits[offset >> 3] |= 1 << (offset & 7);
+            }
+        }
+    }
+}
+
+void ir_gree_unpack(const ir_gree_packed_t *packed, ir_gree_scan_code_t *scan_code)
+{
+    uint32_t data[IR_GREE_SEGMENT_NUM] = {0};
+    size_t offset = 0;
+
+    for (int i = 0; i < IR_GREE_SEGMENT_NUM; i++)
+    {
+        for (int bit = 0; bit < ir_gree_segments[i].bits; bit++, offset++)
+        {
+            if (bit < IR_GREE_DATA_BITS && ir_gree_packed_bit(packed, offset))
+            {
+                data[i] |= 1UL << bit;
+            }
+        }
+    }
+    scan_code->data1 = data[0];
+    scan_code->data2 = data[1];
+    scan_code->data3 = data[2];
+    scan_code->data4 = data[3];
+}
+
+ir_gree_sym_t ir_gree_packed_next(const ir_gree_packed_t *packed, ir_gree_cursor_t *cursor)
+{
+    switch (cursor->stage)
+    {
+    case IR_GREE_CURSOR_LEADER:
+        cursor->stage = IR_GREE_CURSOR_BITS;
+        return IR_GREE_SYM_LEADER;
+    case IR_GREE_CURSOR_BITS:
+    {
+        const ir_gree_segment_t *segment = &ir_gree_segments[cursor->segment];
+        if (cursor->bit < segment->bits)
+        {
+            cursor->bit++;
+            return ir_gree_packed_bit(packed, cursor->offset++) ? IR_GREE_SYM_ONE : IR_GREE_SYM_ZERO;
+        }
+        // 一段结束，输出段后的符号
+        cursor->segment++;
+        cursor->bit = 0;
+        if (segment->gap == IR_GREE_SYM_END || cursor->segment >= IR_GREE_SEGMENT_NUM)
+        {
+            cursor->stage = IR_GREE_CURSOR_DONE;
+        }
+        else if (segment->gap == IR_GREE_SYM_LONG_CONNECT)
+        {
+            cursor->stage = IR_GREE_CURSOR_LEADER;
+        }
+        return segment->gap;
+    }
+    default:
+        return IR_GREE_SYM_INVALID;
+    }
+}
+
+size_t ir_gree_packed_render(const ir_gree_packed_t *packed, ir_gree_pulse_t *pulses)
+{
+    ir_gree_cursor_t cursor = {0};
+    ir_gree_pulse_t *p = pulses;
+    ir_gree_sym_t sym;
+
+    while ((sym = ir_gree_packed_next(packed, &cursor)) != IR_GREE_SYM_INVALID)
+    {
+        *p++ = s_sym_pulses[sym];
+    }
+    return p - pulses;
+}
+
+size_t ir_gree_frame_render(const ir_gree_scan_code_t *scan_code, ir_gree_pulse_t *pulses)
+{
+    ir_gree_packed_t packed;
+
+    ir_gree_pack(scan_code, &packed);
+    return ir_gree_packed_render(&packed, pulses);
+}
@@ -0,0 +1,246 @@
+#include <string.h>
+
+#include "ir_gree_journal.h"
+
+// 记录中各字段的偏移
+#define IR_GREE_JOURNAL_SEQ 0
+#define IR_GREE_JOURNAL_DEVICE 4
+#define IR_GREE_JOURNAL_STATE 5
+#define IR_GREE_JOURNAL_CRC 14
+
+// 恢复时每次读取的记录数
+#define IR_GREE_JOURNAL_READ_RECORDS 16
+
+// CRC-16/CCITT-FALSE，查表计算，恢复时要校验整个日志区域
+static const uint16_t s_crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint16_t ir_gree_journal_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = (crc << 8) ^ s_crc16_table[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+static bool ir_gree_journal_erased(const uint8_t *record)
+{
+    for (int i = 0; i < IR_GREE_JOURNAL_RECORD_SIZE; i++)
+    {
+        if (record[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ir_gree_journal_encode(uint8_t *record, uint32_t seq, uint8_t device, const gree_state_t *state)
+{
+    record[IR_GREE_JOURNAL_SEQ] = seq;
+    record[IR_GREE_JOURNAL_SEQ + 1] = seq >> 8;
+    record[IR_GREE_JOURNAL_SEQ + 2] = seq >> 16;
+    record[IR_GREE_JOURNAL_SEQ + 3] = seq >> 24;
+    record[IR_GREE_JOURNAL_DEVICE] = device;
+    memcpy(record + IR_GREE_JOURNAL_STATE, state, sizeof(*state));
+    uint16_t crc = ir_gree_journal_crc16(record, IR_GREE_JOURNAL_CRC);
+    record[IR_GREE_JOURNAL_CRC] = crc;
+    record[IR_GREE_JOURNAL_CRC + 1] = crc >> 8;
+}
+
+static bool ir_gree_journal_decode(const uint8_t *record, uint32_t *seq, uint8_t *device, gree_state_t *state)
+{
+    uint16_t crc = record[IR_GREE_JOURNAL_CRC] | record[IR_GREE_JOURNAL_CRC + 1] << 8;
+    if (crc != ir_gree_journal_crc16(record, IR_GREE_JOURNAL_CRC))
+    {
+        return false;
+    }
+    *seq = record[IR_GREE_JOURNAL_SEQ] | record[IR_GREE_JOURNAL_SEQ + 1] << 8 |
+           record[IR_GREE_JOURNAL_SEQ + 2] << 16 | (uint32_t)record[IR_GREE_JOURNAL_SEQ + 3] << 24;
+    *device = record[IR_GREE_JOURNAL_DEVICE];
+    memcpy(state, record + IR_GREE_JOURNAL_STATE, sizeof(*state));
+    return *device < IR_GREE_JOURNAL_DEVICE_MAX;
+}
+
+static ir_gree_journal_err_t ir_gree_journal_write(ir_gree_journal_t *journal, uint8_t device, const gree_state_t *state)
+{
+    uint8_t record[IR_GREE_JOURNAL_RECORD_SIZE];
+    ir_gree_journal_encode(record, journal->seq, device, state);
+    uint32_t offset = journal->sector * journal->flash->sector_size + journal->next;
+    // 写失败的位置可能已经不是0xFF，也可能整条都写进去了，不管成功与否位置和seq都跳过，
+    // 恢复时跳过这里留下的空位，后面的记录seq更大
+    journal->next += IR_GREE_JOURNAL_RECORD_SIZE;
+    journal->seq++;
+    if (journal->flash->write(journal->flash->ctx, offset, record, sizeof(record)) != 0)
+    {
+        return IR_GREE_JOURNAL_ERR_FLASH;
+    }
+    return IR_GREE_JOURNAL_OK;
+}
+
+// 擦除另一个扇区，写入每台设备的最新状态，device的状态用state代替
+static ir_gree_journal_err_t ir_gree_journal_compact(ir_gree_journal_t *journal, uint8_t device, const gree_state_t *state)
+{
+    const ir_gree_flash_t *flash = journal->flash;
+    int sector = journal->sector ^ 1;
+
+    if (flash->erase(flash->ctx, sector * flash->sector_size, flash->sector_size) != 0)
+    {
+        return IR_GREE_JOURNAL_ERR_FLASH;
+    }
+    journal->sector = sector;
+    journal->next = 0;
+    journal->compactions++;
+    for (uint8_t i = 0; i < IR_GREE_JOURNAL_DEVICE_MAX; i++)
+    {
+        if (i != device && !(journal->valid & (1u << i)))
+        {
+            continue;
+        }
+        ir_gree_journal_err_t err = ir_gree_journal_write(journal, i, i == device ? state : &journal->states[i]);
+        if (err != IR_GREE_JOURNAL_OK)
+        {
+            return err;
+        }
+    }
+    return IR_GREE_JOURNAL_OK;
+}
+
+ir_gree_journal_err_t ir_gree_journal_mount(ir_gree_journal_t *journal, const ir_gree_flash_t *flash)
+{
+    uint8_t buf[IR_GREE_JOURNAL_READ_RECORDS * IR_GREE_JOURNAL_RECORD_SIZE];
+    uint32_t seqs[IR_GREE_JOURNAL_DEVICE_MAX];
+    uint32_t used[IR_GREE_JOURNAL_SECTOR_NUM] = {0};
+    bool found = false;
+    uint32_t max_seq = 0;
+
+    memset(journal, 0, sizeof(*journal));
+    journal->flash = flash;
+    if (flash->sector_size % sizeof(buf) != 0 ||
+        flash->sector_size < IR_GREE_JOURNAL_DEVICE_MAX * IR_GREE_JOURNAL_RECORD_SIZE)
+    {
+        return IR_GREE_JOURNAL_ERR_ARG;
+    }
+
+    for (int sector = 0; sector < IR_GREE_JOURNAL_SECTOR_NUM; sector++)
+    {
+        for (uint32_t offset = 0; offset < flash->sector_size; offset += sizeof(buf))
+        {
+            if (flash->read(flash->ctx, sector * flash->sector_size + offset, buf, sizeof(buf)) != 0)
+            {
+                return IR_GREE_JOURNAL_ERR_FLASH;
+            }
+            for (size_t i = 0; i < sizeof(buf); i += IR_GREE_JOURNAL_RECORD_SIZE)
+            {
+                // 写失败会在中间留下空位，要扫描整个扇区，追加从最后一条记录之后开始
+                if (ir_gree_journal_erased(buf + i))
+                {
+                    continue;
+                }
+                used[sector] = offset + i + IR_GREE_JOURNAL_RECORD_SIZE;
+
+                uint32_t seq;
+                uint8_t device;
+                gree_state_t state;
+                if (!ir_gree_journal_decode(buf + i, &seq, &device, &state))
+                {
+                    continue;
+                }
+                if (!(journal->valid & (1u << device)) || seq > seqs[device])
+                {
+                    journal->valid |= 1u << device;
+                    seqs[device] = seq;
+                    journal->states[device] = state;
+                }
+                if (!found || seq > max_seq)
+                {
+                    found = true;
+                    max_seq = seq;
+                    journal->sector = sector;
+                }
+            }
+        }
+    }
+
+    journal->seq = found ? max_seq + 1 : 0;
+    journal->next = used[journal->sector];
+    return IR_GREE_JOURNAL_OK;
+}
+
+bool ir_gree_journal_get(const ir_gree_journal_t *journal, uint8_t device, gree_state_t *state)
+{
+    if (device >= IR_GREE_JOURNAL_DEVICE_MAX || !(journal->valid & (1u << device)))
+    {
+        return false;
+    }
+    *state = journal->states[device];
+    return true;
+}
+
+ir_gree_journal_err_t ir_gree_journal_append(ir_gree_journal_t *journal, uint8_t device, const gree_state_t *state)
+{
+    ir_gree_journal_err_t err;
+
+    if (device >= IR_GREE_JOURNAL_DEVICE_MAX)
+    {
+        return IR_GREE_JOURNAL_ERR_ARG;
+    }
+    if ((journal->valid & ~journal->stale & (1u << device)) && memcmp(&journal->states[device], state, sizeof(*state)) == 0)
+    {
+        return IR_GREE_JOURNAL_OK;
+    }
+
+    if (journal->next + IR_GREE_JOURNAL_RECORD_SIZE > journal->flash->sector_size)
+    {
+        err = ir_gree_journal_compact(journal, device, state);
+    }
+    else
+    {
+        err = ir_gree_journal_write(journal, device, state);
+        journal->appends++;
+    }
+    if (err != IR_GREE_JOURNAL_OK)
+    {
+        // 整理时device的新状态可能已经写进去了，flash和内存中的不一定相同
+        journal->stale |= 1u << device;
+        return err;
+    }
+    journal->valid |= 1u << device;
+    journal->stale &= ~(1u << device);
+    journal->states[device] = *state;
+    return IR_GREE_JOURNAL_OK;
+}
@@ -0,0 +1,218 @@
+#include <string.h>
+
+#include "ir_gree_learn.h"
+
+#define IR_GREE_LEARN_RUN 0xF
+
+typedef struct
+{
+    uint32_t sum;
+    uint32_t count;
+} ir_gree_learn_cluster_t;
+
+static uint16_t ir_gree_learn_center(const ir_gree_learn_cluster_t *cluster)
+{
+    return (cluster->sum + cluster->count / 2) / cluster->count;
+}
+
+// 0只和0归为一类，它表示帧结束，不是一个时长
+static bool ir_gree_learn_match(uint16_t duration, uint16_t center)
+{
+    if (duration == 0 || center == 0)
+    {
+        return duration == center;
+    }
+    uint32_t diff = duration > center ? duration - center : center - duration;
+    uint32_t tolerance = (uint32_t)center * IR_GREE_LEARN_TOLERANCE_PCT / 100;
+    return diff <= (tolerance > IR_GREE_LEARN_TOLERANCE_US ? tolerance : IR_GREE_LEARN_TOLERANCE_US);
+}
+
+// 把duration归到已有的类中，没有相近的类就新建一个，字典满了返回false
+static bool ir_gree_learn_add(ir_gree_learn_cluster_t *clusters, int *num, uint16_t duration)
+{
+    for (int i = 0; i < *num; i++)
+    {
+        if (ir_gree_learn_match(duration, ir_gree_learn_center(&clusters[i])))
+        {
+            clusters[i].sum += duration;
+            clusters[i].count++;
+            return true;
+        }
+    }
+    if (*num == IR_GREE_LEARN_DICT_MAX)
+    {
+        return false;
+    }
+    clusters[*num].sum = duration;
+    clusters[*num].count = 1;
+    (*num)++;
+    return true;
+}
+
+static int ir_gree_learn_nearest(const uint16_t *dict, int num, uint16_t duration)
+{
+    int best = 0;
+    uint32_t best_diff = UINT32_MAX;
+    for (int i = 0; i < num; i++)
+    {
+        uint32_t diff = duration > dict[i] ? duration - dict[i] : dict[i] - duration;
+        if (diff < best_diff)
+        {
+            best = i;
+            best_diff = diff;
+        }
+    }
+    return best;
+}
+
+static uint8_t ir_gree_learn_pair(const uint16_t *marks, int mark_num, const uint16_t *spaces, int space_num, ir_gree_pulse_t pulse)
+{
+    return ir_gree_learn_nearest(marks, mark_num, pulse.mark) << 4 | ir_gree_learn_nearest(spaces, space_num, pulse.space);
+}
+
+static uint8_t *ir_gree_learn_put_dict(uint8_t *p, const ir_gree_learn_cluster_t *clusters, int num, uint16_t *dict)
+{
+    for (int i = 0; i < num; i++)
+    {
+        dict[i] = ir_gree_learn_center(&clusters[i]);
+        *p++ = dict[i];
+        *p++ = dict[i] >> 8;
+    }
+    return p;
+}
+
+ir_gree_learn_err_t ir_gree_learn_compress(const ir_gree_pulse_t *pulses, size_t count, uint8_t *out, size_t size, size_t *out_len)
+{
+    ir_gree_learn_cluster_t mark_clusters[IR_GREE_LEARN_DICT_MAX];
+    ir_gree_learn_cluster_t space_clusters[IR_GREE_LEARN_DICT_MAX];
+    uint16_t marks[IR_GREE_LEARN_DICT_MAX];
+    uint16_t spaces[IR_GREE_LEARN_DICT_MAX];
+    int mark_num = 0;
+    int space_num = 0;
+
+    if (count == 0 || count > UINT16_MAX)
+    {
+        return IR_GREE_LEARN_ERR_SIZE;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!ir_gree_learn_add(mark_clusters, &mark_num, pulses[i].mark) ||
+            !ir_gree_learn_add(space_clusters, &space_num, pulses[i].space))
+        {
+            return IR_GREE_LEARN_ERR_DICT;
+        }
+    }
+    if (size < IR_GREE_LEARN_HEADER_SIZE + 2 * (size_t)(mark_num + space_num))
+    {
+        return IR_GREE_LEARN_ERR_SIZE;
+    }
+
+    uint8_t *p = out;
+    uint8_t *end = out + size;
+    *p++ = IR_GREE_LEARN_MAGIC;
+    *p++ = IR_GREE_LEARN_VERSION;
+    *p++ = mark_num;
+    *p++ = space_num;
+    *p++ = count;
+    *p++ = count >> 8;
+    p = ir_gree_learn_put_dict(p, mark_clusters, mark_num, marks);
+    p = ir_gree_learn_put_dict(p, space_clusters, space_num, spaces);
+
+    // 均值在聚类过程中会移动，最后按最近的中心重新分配
+    size_t i = 0;
+    while (i < count)
+    {
+        uint8_t pair = ir_gree_learn_pair(marks, mark_num, spaces, space_num, pulses[i++]);
+        size_t run = 0;
+        while (i < count && ir_gree_learn_pair(marks, mark_num, spaces, space_num, pulses[i]) == pair)
+        {
+            run++;
+            i++;
+        }
+        if (p == end)
+        {
+            return IR_GREE_LEARN_ERR_SIZE;
+        }
+        *p++ = pair;
+        while (run > 0)
+        {
+            size_t n = run > IR_GREE_LEARN_RUN_MAX ? IR_GREE_LEARN_RUN_MAX : run;
+            if (p == end)
+            {
+                return IR_GREE_LEARN_ERR_SIZE;
+            }
+            *p++ = IR_GREE_LEARN_RUN << 4 | (n - 1);
+            run -= n;
+        }
+    }
+
+    *out_len = p - out;
+    return IR_GREE_LEARN_OK;
+}
+
+ir_gree_learn_err_t ir_gree_learn_reader_init(ir_gree_learn_reader_t *reader, const uint8_t *data, size_t len)
+{
+    if (len < IR_GREE_LEARN_HEADER_SIZE || data[0] != IR_GREE_LEARN_MAGIC || data[1] != IR_GREE_LEARN_VERSION)
+    {
+        return IR_GREE_LEARN_ERR_FORMAT;
+    }
+    int mark_num = data[2];
+    int space_num = data[3];
+    if (mark_num > IR_GREE_LEARN_DICT_MAX || space_num > IR_GREE_LEARN_DICT_MAX ||
+        len < IR_GREE_LEARN_HEADER_SIZE + 2 * (size_t)(mark_num + space_num))
+    {
+        return IR_GREE_LEARN_ERR_FORMAT;
+    }
+
+    memset(reader, 0, sizeof(*reader));
+    reader->mark_num = mark_num;
+    reader->space_num = space_num;
+    reader->remaining = data[4] | data[5] << 8;
+    const uint8_t *p = data + IR_GREE_LEARN_HEADER_SIZE;
+    for (int i = 0; i < mark_num; i++, p += 2)
+    {
+        reader->marks[i] = p[0] | p[1] << 8;
+    }
+    for (int i = 0; i < space_num; i++, p += 2)
+    {
+        reader->spaces[i] = p[0] | p[1] << 8;
+    }
+    reader->p = p;
+    reader->end = data + len;
+    return IR_GREE_LEARN_OK;
+}
+
+bool ir_gree_learn_next(ir_gree_learn_reader_t *reader, ir_gree_pulse_t *pulse)
+{
+    if (reader->remaining == 0)
+    {
+        return false;
+    }
+    if (reader->repeat == 0)
+    {
+        if (reader->p == reader->end)
+        {
+            return false;
+        }
+        uint8_t token = *reader->p++;
+        if (token >> 4 == IR_GREE_LEARN_RUN)
+        {
+            reader->repeat = (token & 0xF) + 1;
+        }
+        else if ((token >> 4) >= reader->mark_num || (token & 0xF) >= reader->space_num)
+        {
+            // 序号超出字典，数据损坏，不读字典外面的内容，remaining保留下来表示没有正常结束
+            return false;
+        }
+        else
+        {
+            reader->last.mark = reader->marks[token >> 4];
+            reader->last.space = reader->spaces[token & 0xF];
+            reader->repeat = 1;
+        }
+    }
+    reader->repeat--;
+    reader->remaining--;
+    *pulse = reader->last;
+    return true;
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "ir_gree_cmd.h"
+#include "ir_gree_sched.h"
+
+// 一周之内一定有下一次，夏令时切换时多看一天
+#define IR_GREE_SCHED_LOOKAHEAD_DAYS 8
+
+static bool ir_gree_sched_digits(const char *p, size_t len, int *value)
+{
+    if (len == 0 || len > 2)
+    {
+        return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (p[i] < '0' || p[i] > '9')
+        {
+            return false;
+        }
+        *value = *value * 10 + (p[i] - '0');
+    }
+    return true;
+}
+
+// 时:分，时和分都可以是1~2位
+static bool ir_gree_sched_time(const char *p, size_t len, uint16_t *minute)
+{
+    const char *colon = memchr(p, ':', len);
+    int hour;
+    int min;
+    if (!colon || !ir_gree_sched_digits(p, colon - p, &hour) ||
+        !ir_gree_sched_digits(colon + 1, p + len - colon - 1, &min) || hour > 23 || min > 59)
+    {
+        return false;
+    }
+    *minute = hour * 60 + min;
+    return true;
+}
+
+ir_gree_sched_err_t ir_gree_sched_parse(const char *data, size_t len, ir_gree_sched_t *sched)
+{
+    ir_gree_sched_t next = {
+        .days = IR_GREE_SCHED_ALL_DAYS,
+    };
+    const char *value;
+    size_t value_len;
+
+    if (len > IR_GREE_SCHED_CMD_MAX)
+    {
+        return IR_GREE_SCHED_ERR_SIZE;
+    }
+    if (!ir_gree_cmd_lookup(data, len, "id", &value, &value_len) || value_len == 0)
+    {
+        return IR_GREE_SCHED_ERR_FORMAT;
+    }
+    if (value_len > IR_GREE_SCHED_ID_MAX)
+    {
+        return IR_GREE_SCHED_ERR_RANGE;
+    }
+    memcpy(next.id, value, value_len);
+
+    if (!ir_gree_cmd_lookup(data, len, "at", &value, &value_len))
+    {
+        return IR_GREE_SCHED_ERR_FORMAT;
+    }
+    if (!ir_gree_sched_time(value, value_len, &next.minute))
+    {
+        return IR_GREE_SCHED_ERR_RANGE;
+    }
+
+    if (ir_gree_cmd_lookup(data, len, "days", &value, &value_len))
+    {
+        next.days = 0;
+        for (size_t i = 0; i < value_len; i++)
+        {
+            if (value[i] < '0' || value[i] > '6')
+            {
+                return IR_GREE_SCHED_ERR_RANGE;
+            }
+            next.days |= 1 << (value[i] - '0');
+        }
+        if (next.days == 0)
+        {
+            return IR_GREE_SCHED_ERR_RANGE;
+        }
+    }
+    if (ir_gree_cmd_lookup(data, len, "once", &value, &value_len))
+    {
+        next.once = value_len == 4 && memcmp(value, "true", 4) == 0;
+    }
+
+    // 命令字段在一个副本上试一次，到时才不会出错
+    gree_state_t state = {0};
+    ir_gree_cmd_opts_t opts = {0};
+    if (ir_gree_cmd_parse(data, len, &state, &opts) != IR_GREE_CMD_OK)
+    {
+        return IR_GREE_SCHED_ERR_CMD;
+    }
+
+    memcpy(next.cmd, data, len);
+    next.len = len;
+    *sched = next;
+    return IR_GREE_SCHED_OK;
+}
+
+time_t ir_gree_sched_next(const ir_gree_sched_t *sched, time_t now)
+{
+    struct tm today;
+    localtime_r(&now, &today);
+    for (int day = 0; day < IR_GREE_SCHED_LOOKAHEAD_DAYS; day++)
+    {
+        // mktime会把超出范围的日期和时间进位，夏令时由tm_isdst = -1自动判断
+        struct tm tm = {
+            .tm_year = today.tm_year,
+            .tm_mon = today.tm_mon,
+            .tm_mday = today.tm_mday + day,
+            .tm_hour = sched->minute / 60,
+            .tm_min = sched->minute % 60,
+            .tm_isdst = -1,
+        };
+        time_t at = mktime(&tm);
+        if (at > now && (sched->days & (1 << tm.tm_wday)))
+        {
+            return at;
+        }
+    }
+    return (time_t)-1;
+}
@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "ir_gree_state.h"
+
+// 打包前先把状态换算成各个位域的值，再按表写入，每个字段没有分支
+enum
+{
+    GREE_FIELD_MODE,
+    GREE_FIELD_POWER,
+    GREE_FIELD_FAN,
+    GREE_FIELD_SWING_AUTO,
+    GREE_FIELD_SLEEP,
+    GREE_FIELD_TEMP,
+    GREE_FIELD_TIMER_HALF,
+    GREE_FIELD_TIMER_TENS,
+    GREE_FIELD_TIMER_ON,
+    GREE_FIELD_TIMER_UNITS,
+    GREE_FIELD_TURBO,
+    GREE_FIELD_LIGHT,
+    GREE_FIELD_SWING_V,
+    GREE_FIELD_NUM,
+};
+
+typedef struct
+{
+    uint8_t byte;
+    uint8_t shift;
+    uint8_t mask;
+} gree_field_t;
+
+static const gree_field_t s_gree_fields[GREE_FIELD_NUM] = {
+    [GREE_FIELD_MODE] = {0, 0, 0x7},
+    [GREE_FIELD_POWER] = {0, 3, 0x1},
+    [GREE_FIELD_FAN] = {0, 4, 0x3},
+    [GREE_FIELD_SWING_AUTO] = {0, 6, 0x1},
+    [GREE_FIELD_SLEEP] = {0, 7, 0x1},
+    [GREE_FIELD_TEMP] = {1, 0, 0xF},
+    [GREE_FIELD_TIMER_HALF] = {1, 4, 0x1},
+    [GREE_FIELD_TIMER_TENS] = {1, 5, 0x3},
+    [GREE_FIELD_TIMER_ON] = {1, 7, 0x1},
+    [GREE_FIELD_TIMER_UNITS] = {2, 0, 0xF},
+    [GREE_FIELD_TURBO] = {2, 4, 0x1},
+    [GREE_FIELD_LIGHT] = {2, 5, 0x1},
+    [GREE_FIELD_SWING_V] = {4, 0, 0xF},
+};
+
+// 字节3的固定值，两个数据块只有这里不同
+#define GREE_BLOCK1_BYTE3 0x50
+#define GREE_BLOCK2_BYTE3 0x70
+
+static uint32_t gree_le32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void gree_put_le32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+    bytes[2] = value >> 16;
+    bytes[3] = value >> 24;
+}
+
+uint8_t gree_checksum(const uint8_t block[8])
+{
+    uint8_t sum = 10;
+    for (int i = 0; i < 4; i++)
+    {
+        sum += block[i] & 0xF;
+    }
+    for (int i = 4; i < 7; i++)
+    {
+        sum += block[i] >> 4;
+    }
+    return (sum << 4) & 0xF0;
+}
+
+void gree_state_pack(const gree_state_t *state, ir_gree_scan_code_t *scan_code)
+{
+    // 温度和定时按位截断会变成范围内的另一个值，超出范围时取最近的边界
+    uint8_t temperature = state->temperature < GREE_TEMP_MIN   ? GREE_TEMP_MIN
+                          : state->temperature > GREE_TEMP_MAX ? GREE_TEMP_MAX
+                                                               : state->temperature;
+    uint8_t timer = state->timer > GREE_TIMER_MAX ? GREE_TIMER_MAX : state->timer;
+    uint8_t hours = timer / 2;
+    uint8_t values[GREE_FIELD_NUM] = {
+        [GREE_FIELD_MODE] = state->mode,
+        [GREE_FIELD_POWER] = state->power,
+        [GREE_FIELD_FAN] = state->fan,
+        [GREE_FIELD_SWING_AUTO] = state->swing,
+        [GREE_FIELD_SLEEP] = state->sleep,
+        [GREE_FIELD_TEMP] = temperature - GREE_TEMP_MIN,
+        [GREE_FIELD_TIMER_HALF] = timer & 1,
+        [GREE_FIELD_TIMER_TENS] = hours / 10,
+        [GREE_FIELD_TIMER_ON] = timer != 0,
+        [GREE_FIELD_TIMER_UNITS] = hours % 10,
+        [GREE_FIELD_TURBO] = state->turbo,
+        [GREE_FIELD_LIGHT] = state->light,
+        // 上下扫风只用到自动（1）
+        [GREE_FIELD_SWING_V] = state->swing,
+    };
+    uint8_t block[8] = {0};
+
+    for (int i = 0; i < GREE_FIELD_NUM; i++)
+    {
+        const gree_field_t *field = &s_gree_fields[i];
+        block[field->byte] |= (values[i] & field->mask) << field->shift;
+    }
+
+    block[3] = GREE_BLOCK1_BYTE3;
+    block[7] = gree_checksum(block);
+    scan_code->data1 = gree_le32(&block[0]);
+    scan_code->data2 = gree_le32(&block[4]);
+
+    block[3] = GREE_BLOCK2_BYTE3;
+    block[7] = gree_checksum(block);
+    scan_code->data3 = gree_le32(&block[0]);
+    scan_code->data4 = gree_le32(&block[4]);
+}
+
+bool gree_state_unpack(const ir_gree_scan_code_t *scan_code, gree_state_t *state)
+{
+    uint8_t block[8];
+    uint8_t values[GREE_FIELD_NUM];
+
+    gree_put_le32(&block[0], scan_code->data1);
+    gree_put_le32(&block[4], scan_code->data2);
+    if ((block[7] & 0xF0) != gree_checksum(block))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < GREE_FIELD_NUM; i++)
+    {
+        const gree_field_t *field = &s_gree_fields[i];
+        values[i] = (block[field->byte] >> field->shift) & field->mask;
+    }
+
+    memset(state, 0, sizeof(*state));
+    state->power = values[GREE_FIELD_POWER];
+    state->mode = values[GREE_FIELD_MODE];
+    state->temperature = values[GREE_FIELD_TEMP] + GREE_TEMP_MIN;
+    state->fan = values[GREE_FIELD_FAN];
+    state->swing = values[GREE_FIELD_SWING_AUTO];
+    state->light = values[GREE_FIELD_LIGHT];
+    state->turbo = values[GREE_FIELD_TURBO];
+    state->sleep = values[GREE_FIELD_SLEEP];
+    state->timer = values[GREE_FIELD_TIMER_ON] *
+                   ((values[GREE_FIELD_TIMER_TENS] * 10 + values[GREE_FIELD_TIMER_UNITS]) * 2 + values[GREE_FIELD_TIMER_HALF]);
+    return true;
+}
@@ -0,0 +1,117 @@
+#include "ir_gree_wheel.h"
+
+#define IR_GREE_WHEEL_MASK (IR_GREE_WHEEL_SLOTS - 1)
+
+void ir_gree_wheel_init(ir_gree_wheel_t *wheel, ir_gree_wheel_node_t *nodes, size_t node_num, uint32_t now)
+{
+    wheel->nodes = nodes;
+    wheel->node_num = node_num;
+    wheel->now = now;
+    for (size_t level = 0; level < IR_GREE_WHEEL_LEVELS; level++)
+    {
+        for (size_t slot = 0; slot < IR_GREE_WHEEL_SLOTS; slot++)
+        {
+            wheel->slots[level][slot] = IR_GREE_WHEEL_NONE;
+        }
+    }
+    for (size_t i = 0; i < node_num; i++)
+    {
+        nodes[i].pending = false;
+    }
+}
+
+// 把节点挂在target到期，target不能早于当前tick，离到期的tick数决定层，到期tick在这一层的位决定槽
+static void ir_gree_wheel_link(ir_gree_wheel_t *wheel, uint16_t index, uint32_t target)
+{
+    ir_gree_wheel_node_t *node = &wheel->nodes[index];
+    uint32_t delta = target - wheel->now;
+    if (delta >= IR_GREE_WHEEL_SPAN)
+    {
+        target = wheel->now + IR_GREE_WHEEL_SPAN - 1;
+        delta = IR_GREE_WHEEL_SPAN - 1;
+    }
+
+    uint8_t level = 0;
+    while (level + 1 < IR_GREE_WHEEL_LEVELS && delta >= (uint32_t)1 << (IR_GREE_WHEEL_BITS * (level + 1)))
+    {
+        level++;
+    }
+    uint8_t slot = (target >> (IR_GREE_WHEEL_BITS * level)) & IR_GREE_WHEEL_MASK;
+    uint16_t head = wheel->slots[level][slot];
+
+    node->level = level;
+    node->slot = slot;
+    node->prev = IR_GREE_WHEEL_NONE;
+    node->next = head;
+    node->pending = true;
+    if (head != IR_GREE_WHEEL_NONE)
+    {
+        wheel->nodes[head].prev = index;
+    }
+    wheel->slots[level][slot] = index;
+}
+
+void ir_gree_wheel_del(ir_gree_wheel_t *wheel, uint16_t index)
+{
+    ir_gree_wheel_node_t *node = &wheel->nodes[index];
+    if (!node->pending)
+    {
+        return;
+    }
+    if (node->prev != IR_GREE_WHEEL_NONE)
+    {
+        wheel->nodes[node->prev].next = node->next;
+    }
+    else
+    {
+        wheel->slots[node->level][node->slot] = node->next;
+    }
+    if (node->next != IR_GREE_WHEEL_NONE)
+    {
+        wheel->nodes[node->next].prev = node->prev;
+    }
+    node->pending = false;
+}
+
+void ir_gree_wheel_add(ir_gree_wheel_t *wheel, uint16_t index, uint32_t expires)
+{
+    ir_gree_wheel_del(wheel, index);
+    wheel->nodes[index].expires = expires;
+    // 当前tick已经处理过，已经到期的放在下一个tick
+    ir_gree_wheel_link(wheel, index, (int32_t)(expires - wheel->now) > 0 ? expires : wheel->now + 1);
+}
+
+void ir_gree_wheel_advance(ir_gree_wheel_t *wheel, uint32_t now, ir_gree_wheel_cb_t cb, void *ctx)
+{
+    while ((int32_t)(now - wheel->now) > 0)
+    {
+        uint32_t tick = ++wheel->now;
+
+        // 低位全为0的层从高到低依次把当前槽降下来，降下来的节点离到期都不到一个槽的跨度，
+        // 正好在这个tick到期的降到第0层的当前槽，下面马上处理
+        uint8_t top = 0;
+        while (top + 1 < IR_GREE_WHEEL_LEVELS && (tick & (((uint32_t)1 << (IR_GREE_WHEEL_BITS * (top + 1))) - 1)) == 0)
+        {
+            top++;
+        }
+        for (uint8_t level = top; level > 0; level--)
+        {
+            uint16_t *head = &wheel->slots[level][(tick >> (IR_GREE_WHEEL_BITS * level)) & IR_GREE_WHEEL_MASK];
+            while (*head != IR_GREE_WHEEL_NONE)
+            {
+                uint16_t index = *head;
+                ir_gree_wheel_del(wheel, index);
+                ir_gree_wheel_link(wheel, index, wheel->nodes[index].expires);
+            }
+        }
+
+        // 每次摘下槽头再回调，回调中增删节点不会影响遍历；重新挂上的节点不会回到当前槽
+        uint16_t *head = &wheel->slots[0][tick & IR_GREE_WHEEL_MASK];
+        while (*head != IR_GREE_WHEEL_NONE)
+        {
+            uint16_t index = *head;
+            ir_gree_wheel_del(wheel, index);
+            cb(ctx, index);
+        }
+    }
+}
@@ -0,0 +1,242 @@
+#include <string.h>
+
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+
+#include "ir_gree_encoder.h"
+
+static const char *TAG = "gree_encoder";
+
+typedef struct
+{
+    rmt_encoder_t base;
+
+    rmt_encoder_t *copy_encoder;
+    // 每种符号对应的RMT符号，长连接码的空闲超过15bit，占两个
+    rmt_symbol_word_t symbols[IR_GREE_SYM_NUM][2];
+    uint8_t symbol_num[IR_GREE_SYM_NUM];
+    // 正在编码的符号，MEM_FULL后下次补充中断从这里继续
+    ir_gree_sym_t sym;
+    ir_gree_cursor_t cursor;
+    // 当前帧已经调用的次数，第一次之后的都是补充中断
+    uint32_t frame_calls;
+    // 统计在补充中断中更新，在任务中读取，64位的总数不能撕开，两边都在stats_lock中访问
+    ir_gree_encoder_stats_t stats;
+    portMUX_TYPE stats_lock;
+} rmt_ir_gree_encoder_t;
+
+static rmt_ir_gree_encoder_t s_gree_encoder_pool[IR_GREE_ENCODER_MAX];
+static bool s_gree_encoder_used[IR_GREE_ENCODER_MAX];
+
+static void ir_gree_encoder_account(rmt_ir_gree_encoder_t *gree_encoder, uint32_t start_cycles, rmt_encode_state_t state)
+{
+    uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;
+    // 第一次在rmt_transmit的任务中调用，之后在中断中调用
+    portENTER_CRITICAL_SAFE(&gree_encoder->stats_lock);
+    gree_encoder->stats.encode_calls++;
+    gree_encoder->stats.encode_cycles_total += cycles;
+    if (cycles > gree_encoder->stats.encode_cycles_max)
+    {
+        gree_encoder->stats.encode_cycles_max = cycles;
+    }
+    if (gree_encoder->frame_calls++ > 0)
+    {
+        gree_encoder->stats.refills++;
+        if (cycles > gree_encoder->stats.refill_cycles_max)
+        {
+            gree_encoder->stats.refill_cycles_max = cycles;
+        }
+    }
+    if (state & RMT_ENCODING_COMPLETE)
+    {
+        gree_encoder->stats.frames++;
+        if (gree_encoder->frame_calls - 1 > gree_encoder->stats.refills_max)
+        {
+            gree_encoder->stats.refills_max = gree_encoder->frame_calls - 1;
+        }
+        gree_encoder->frame_calls = 0;
+    }
+    portEXIT_CRITICAL_SAFE(&gree_encoder->stats_lock);
+}
+
+size_t ir_gree_pulse_symbols(ir_gree_pulse_t pulse, rmt_symbol_word_t *symbols)
+{
+    uint32_t space = pulse.space;
+    // 结束码后面没有空闲，保持低电平一段时间
+    if (space == 0)
+    {
+        space = END_CODE_DURATION_1;
+    }
+    uint32_t first = space > RMT_DURATION_MAX ? RMT_DURATION_MAX : space;
+    symbols[0] = (rmt_symbol_word_t){
+        .level0 = 1,
+        .duration0 = pulse.mark,
+        .level1 = 0,
+        .duration1 = first,
+    };
+    // 超过15bit的空闲用全低电平的符号补齐
+    space -= first;
+    if (space == 0)
+    {
+        return 1;
+    }
+    symbols[1] = (rmt_symbol_word_t){
+        .level0 = 0,
+        .duration0 = space / 2,
+        .level1 = 0,
+        .duration1 = space - space / 2,
+    };
+    return 2;
+}
+
+static size_t rmt_encode_ir_gree(rmt_encoder_t *encoder,
+                                 rmt_channel_handle_t channel,
+                                 const void *primary_data,
+                                 size_t data_size,
+                                 rmt_encode_state_t *ret_stat)
+{
+    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
+    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+    size_t encoded_symbols = 0;
+    const ir_gree_packed_t *packed = (const ir_gree_packed_t *)primary_data;
+    rmt_encoder_handle_t copy_encoder = gree_encoder->copy_encoder;
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+
+    // 按段的位数逐位取出，35位的段不用再单独补后三位
+    while (1)
+    {
+        if (gree_encoder->sym == IR_GREE_SYM_INVALID)
+        {
+            gree_encoder->sym = ir_gree_packed_next(packed, &gree_encoder->cursor);
+            if (gree_encoder->sym == IR_GREE_SYM_INVALID)
+            {
+                memset(&gree_encoder->cursor, 0, sizeof(gree_encoder->cursor));
+                state |= RMT_ENCODING_COMPLETE;
+                break;
+            }
+        }
+        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
+                                                gree_encoder->symbols[gree_encoder->sym],
+                                                gree_encoder->symbol_num[gree_encoder->sym] * sizeof(rmt_symbol_word_t),
+                                                &session_state);
+        if (session_state & RMT_ENCODING_COMPLETE)
+        {
+            gree_encoder->sym = IR_GREE_SYM_INVALID;
+        }
+        if (session_state & RMT_ENCODING_MEM_FULL)
+        {
+            state |= RMT_ENCODING_MEM_FULL;
+            break;
+        }
+    }
+
+    ir_gree_encoder_account(gree_encoder, start_cycles, state);
+    *ret_stat = state;
+    return encoded_symbols;
+}
+
+static size_t rmt_encode_ir_gree_frame(rmt_encoder_t *encoder,
+                                       rmt_channel_handle_t channel,
+                                       const void *primary_data,
+                                       size_t data_size,
+                                       rmt_encode_state_t *ret_stat)
+{
+    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
+    rmt_encoder_handle_t copy_encoder = gree_encoder->copy_encoder;
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+
+    // 整帧已经预先渲染好，只需一次copy_encoder调用，MEM_FULL后由copy_encoder自己记录位置
+    size_t encoded_symbols = copy_encoder->encode(copy_encoder, channel, primary_data, data_size, &state);
+    ir_gree_encoder_account(gree_encoder, start_cycles, state);
+    *ret_stat = state;
+    return encoded_symbols;
+}
+
+static esp_err_t rmt_del_ir_gree_encoder(rmt_encoder_t *encoder)
+{
+    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
+    rmt_del_encoder(gree_encoder->copy_encoder);
+    s_gree_encoder_used[gree_encoder - s_gree_encoder_pool] = false;
+    return ESP_OK;
+}
+
+static esp_err_t rmt_ir_gree_encoder_reset(rmt_encoder_t *encoder)
+{
+    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
+    rmt_encoder_reset(gree_encoder->copy_encoder);
+    gree_encoder->sym = IR_GREE_SYM_INVALID;
+    gree_encoder->frame_calls = 0;
+    memset(&gree_encoder->cursor, 0, sizeof(gree_encoder->cursor));
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_ir_gree_encoder(const ir_gree_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    esp_err_t ret = ESP_OK;
+    // 参数错误时也会跳到err，要先初始化
+    rmt_ir_gree_encoder_t *gree_encoder = NULL;
+    ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+
+    for (int i = 0; i < IR_GREE_ENCODER_MAX; i++)
+    {
+        if (!s_gree_encoder_used[i])
+        {
+            s_gree_encoder_used[i] = true;
+            gree_encoder = &s_gree_encoder_pool[i];
+            memset(gree_encoder, 0, sizeof(rmt_ir_gree_encoder_t));
+            portMUX_INITIALIZE(&gree_encoder->stats_lock);
+            break;
+        }
+    }
+    ESP_GOTO_ON_FALSE(gree_encoder, ESP_ERR_NO_MEM, err, TAG, "encoder pool exhausted");
+    gree_encoder->base.encode = config->prebuilt ? rmt_encode_ir_gree_frame : rmt_encode_ir_gree;
+    gree_encoder->base.del = rmt_del_ir_gree_encoder;
+    gree_encoder->base.reset = rmt_ir_gree_encoder_reset;
+
+    rmt_copy_encoder_config_t copy_encoder_config = {};
+    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &gree_encoder->copy_encoder), err, TAG, "create copy encoder failed");
+
+    // 各种符号的RMT表示只算一次
+    for (int sym = IR_GREE_SYM_LEADER; sym < IR_GREE_SYM_NUM; sym++)
+    {
+        gree_encoder->symbol_num[sym] = ir_gree_pulse_symbols(ir_gree_sym_pulse(sym), gree_encoder->symbols[sym]);
+    }
+
+    *ret_encoder = &gree_encoder->base;
+    return ret;
+err:
+    if (gree_encoder)
+    {
+        if (gree_encoder->copy_encoder)
+        {
+            rmt_del_encoder(gree_encoder->copy_encoder);
+        }
+        s_gree_encoder_used[gree_encoder - s_gree_encoder_pool] = false;
+    }
+    return ret;
+}
+
+void rmt_ir_gree_encoder_get_stats(rmt_encoder_handle_t encoder, ir_gree_encoder_stats_t *stats)
+{
+    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
+    portENTER_CRITICAL(&gree_encoder->stats_lock);
+    *stats = gree_encoder->stats;
+    portEXIT_CRITICAL(&gree_encoder->stats_lock);
+}
+
+size_t ir_gree_build_frame(const ir_gree_packed_t *packed, rmt_symbol_word_t *frame)
+{
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    size_t count = ir_gree_packed_render(packed, pulses);
+    rmt_symbol_word_t *p = frame;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        p += ir_gree_pulse_symbols(pulses[i], p);
+    }
+
+    return p - frame;
+}
@@ -0,0 +1,73 @@
+/*
+ * 格力帧的RMT编码器
+ *
+ * prebuilt为true时primary_data是ir_gree_build_frame渲染好的符号数组，编码器只调用一次copy_encoder
+ * 否则primary_data是ir_gree_packed_t，编码器逐个符号交给copy_encoder，MEM_FULL后在下一次补充中断中继续
+ *
+ * 只依赖driver/rmt_encoder.h，tools/rmt_mock用桩实现在主机上编译，检查各种内存块大小下的输出
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "driver/rmt_encoder.h"
+
+#include "ir_gree_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 结束码后面没有空闲，RMT符号保持低电平一段时间
+#define END_CODE_DURATION_1 0x7FFF
+
+// rmt_symbol_word_t的duration只有15bit
+#define RMT_DURATION_MAX 0x7FFF
+
+// 整帧符号数：长连接码的空闲超过15bit，要多占一个符号
+#define IR_GREE_FRAME_SYMBOLS (IR_GREE_FRAME_PULSES + 1)
+
+// 编码器从静态池中分配，每个发射通道一个，ESP32-C3只有2个发射通道
+#define IR_GREE_ENCODER_MAX 4
+
+typedef struct
+{
+    uint32_t resolution;
+    // 为true时primary_data是ir_gree_build_frame渲染好的符号数组，而不是ir_gree_packed_t
+    bool prebuilt;
+} ir_gree_encoder_config_t;
+
+// 编码器统计，用于对比两种编码方式以及DMA和非DMA通道的开销
+// 第一次encode在rmt_transmit中调用，之后每次调用都对应一次ping-pong补充中断（DMA时为DMA的EOF中断）
+typedef struct
+{
+    uint32_t frames;
+    uint32_t encode_calls;
+    uint32_t encode_cycles_max;
+    uint64_t encode_cycles_total;
+    uint32_t refills;           // 补充中断中的调用次数
+    uint32_t refills_max;       // 一帧中最多的补充次数
+    uint32_t refill_cycles_max; // 补充中断中最长的一次编码，是中断耗时的主要部分
+} ir_gree_encoder_stats_t;
+
+esp_err_t rmt_new_ir_gree_encoder(const ir_gree_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
+
+void rmt_ir_gree_encoder_get_stats(rmt_encoder_handle_t encoder, ir_gree_encoder_stats_t *stats);
+
+/**
+ * 一对mark/space转换成RMT符号，返回符号数（1或2）
+ */
+size_t ir_gree_pulse_symbols(ir_gree_pulse_t pulse, rmt_symbol_word_t *symbols);
+
+/**
+ * 把打包帧渲染到frame中，frame至少要有IR_GREE_FRAME_SYMBOLS个符号，返回符号数
+ */
+size_t ir_gree_build_frame(const ir_gree_packed_t *packed, rmt_symbol_word_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,9 +11,16 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #include "nvs.h"
 #include "nvs_flash.h"
@@ -26,455 +33,2020 @@
 #include "esp_check.h"
 #include "esp_system.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_sntp.h"
+#include "soc/soc_caps.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "lwip/etharp.h"
+#include "esp_netif_net_stack.h"
 
 #include "driver/rmt_types.h"
 #include "driver/rmt_tx.h"
+#include "driver/rmt_rx.h"
 #include "driver/rmt_encoder.h"
 
 #include "mqtt_client.h"
 #include "esp_smartconfig.h"
 #include "driver/gpio.h"
 
+#include "ir_gree_frame.h"
+#include "ir_gree_state.h"
+#include "ir_gree_decoder.h"
+#include "ir_gree_calib.h"
+#include "ir_gree_cmd.h"
+#include "ir_gree_journal.h"
+#include "ir_gree_learn.h"
+#include "ir_gree_sched.h"
+#include "ir_gree_wheel.h"
+#include "ir_gree_encoder.h"
+
 #define IR_RESOLUTION_HZ 1000000 // 1MHz resolution, 1 tick = 1us
-#define IR_TX_GPIO_NUM 18
+#define IR_TX_QUEUE_DEPTH 4
+// 一台设备最多绑定的发射通道，多个通道通过rmt_sync_manager同时发射
+#define IR_DEVICE_MAX_CHANNELS 2
+// 发送任务的命令队列长度
+#define IR_TX_CMD_QUEUE_LEN 8
+// 队列满且有多个任务同时提交时，REPLACE_OLDEST最多挤掉的次数
+#define IR_TX_REPLACE_RETRIES 3
+// 一帧约180ms，超过这个时间没有收到发送完成就认为出错
+#define IR_TX_DONE_TIMEOUT_MS 500
+// 1：收到命令时先把整帧渲染成符号数组，再交给copy_encoder一次性发送
+// 0：rmt_encode_ir_gree直接从打包帧逐个符号编码，不支持学习到的波形；重复发送时等上一帧发完再延时补足帧间隔
+#define IR_TX_PREBUILT_FRAME 1
+// 1：发射通道用DMA，mem_block_symbols为DMA缓冲的大小，一次发送（包括重复发送的帧间隔）整个放得下，
+//    rmt_transmit中一次编码完，发送过程中没有补充中断；只有支持RMT DMA的芯片（如ESP32-S3）可以打开
+// 0：mem_block_symbols为RMT的内存块，一帧要多次ping-pong补充，每次补充是一次中断，会和WiFi抢CPU
+#if SOC_RMT_SUPPORT_DMA
+#define IR_TX_WITH_DMA 1
+#else
+#define IR_TX_WITH_DMA 0
+#endif
+#define IR_TX_DMA_BLOCK_SYMBOLS 512
+#define IR_TX_RMT_BLOCK_SYMBOLS 64
+#if IR_TX_WITH_DMA
+// 帧缓冲放在DMA可用的内部RAM中
+#define IR_TX_FRAME_CAPS (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)
+#else
+// 补充中断中要拷贝帧缓冲，不能放在PSRAM中
+#define IR_TX_FRAME_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+// 命令没有指定时的重复次数和帧间隔，接收不稳定时可以改大重复次数
+#define IR_TX_REPEAT_DEFAULT 0
+#define IR_TX_GAP_DEFAULT_MS 100
+
+#define IR_RX_GPIO_NUM GPIO_NUM_9
+// 半帧为 引导码 + 35 + 短连接码 + 32 + 最后一个脉冲 = 70个符号
+#define IR_RX_BUFFER_SYMBOLS 128
+// 支持DMA的芯片（如ESP32-S3）可以打开
+#define IR_RX_WITH_DMA 0
+// 比短连接码的20ms长，比长连接码的40ms短，所以一帧会分两次收到
+#define IR_RX_SIGNAL_RANGE_MAX_NS (25 * 1000 * 1000)
+#define IR_RX_SIGNAL_RANGE_MIN_NS 1250
+// 两个半帧之间超过这个时间就重新开始解码
+#define IR_RX_FRAME_TIMEOUT_US (200 * 1000)
+// 1：统计接收到的周期，自动调整解码窗口，适应电池电量低或者不同接收头的遥控器，见ir_gree_calib.h
+#define IR_RX_CALIBRATE 1
+// 每收到这么多个周期重新求一次窗口
+#define IR_RX_CALIB_PERIODS IR_GREE_FRAME_PULSES
+
+// 延迟统计：MQTT收到命令 → 解析完 → rmt_transmit入队 → 发送完成
+// 发送任务把样本放进环形缓冲，统计任务取出后按最近IR_LATENCY_WINDOW条计算分位数
+#define IR_LATENCY_RING_LEN 16
+#define IR_LATENCY_WINDOW 128
+// 按2的幂分桶，最后一桶为2^19us（约0.5s）以上
+#define IR_LATENCY_BUCKETS 21
+#define IR_STATS_PERIOD_MS 10000
+
+// 空调状态日志的分区，见partitions.csv
+#define IR_JOURNAL_PARTITION_LABEL "ir_state"
+#define IR_JOURNAL_PARTITION_SUBTYPE 0x40
+// 状态最后一次修改后等这么久再写flash，连续的命令只写一次
+#define IR_JOURNAL_DELAY_MS 5000
+// 启动时重新发送恢复的状态
+#define IR_JOURNAL_REASSERT 1
 
-// 引导码
-#define LEADING_CODE_DURATION_0 9000
-#define LEADING_CODE_DURATION_1 4500
+// 状态同步：接收头收到遥控器的命令时更新设备状态，状态的变化发布到gree/<设备名>/state
+// 修改后等这么久再发布，遥控器连按几下只发布最后的结果
+#define IR_SYNC_BATCH_MS 500
+// 发送开始后这么久内收到同样的扫描码，认为是自己发出的帧被接收头收到
+#define IR_SYNC_ECHO_MS 1000
+// 记住最近几次发送的扫描码
+#define IR_SYNC_ECHO_SLOTS 4
 
-// 数据码 0
-#define PAYLOAD_ZERO_DURATION_0 660
-#define PAYLOAD_ZERO_DURATION_1 540
+// 定时命令：在设备上按本地时间执行，直接进入发送队列，不经过MQTT，断网时照常执行，格式见ir_gree_sched.h
+// 每条按id作为key存在NVS中，值为设备序号 + JSON
+#define IR_SCHED_MAX 16
+#define IR_SCHED_NVS_NAMESPACE "schedule"
+#define IR_SCHED_TZ "CST-8"
+#define IR_SCHED_NTP_SERVER "pool.ntp.org"
+// 系统时间早于2024-01-01认为还没有对过时，不执行定时命令
+#define IR_SCHED_TIME_VALID 1704067200
+// 时钟跳变的容忍范围：向前跳不超过这么多秒时补上跳过的命令，向后跳不超过时等时钟追上来，不会重复执行；
+// 超过时（第一次对时或者时间被改）按新的时间重新计算每条命令的下一次执行时间，跳过的不补
+#define IR_SCHED_DRIFT_MAX_S 120
 
-// 数据码 1
-#define PAYLOAD_ONE_DURATION_0 660
-#define PAYLOAD_ONE_DURATION_1 1680
+// 学习模式：录下任意遥控器的波形，压缩后按名字存在NVS中，格式见ir_gree_learn.h
+#define IR_LEARN_NVS_NAMESPACE "learned"
+// 名字作为NVS的key，最长15个字符
+#define IR_LEARN_NAME_MAX 15
+#define IR_LEARN_MAX_PAIRS 256
+// 发出学习命令后这么久内没有按遥控器就放弃
+#define IR_LEARN_TIMEOUT_MS (10 * 1000)
 
-// 短连接码
-#define SHORT_CONNCECT_CODE_DURATION_0 660
-#define SHORT_CONNCECT_CODE_DURATION_1 20000
+// 快速重连：保存上次连上的AP的信道、BSSID和IP，启动时直接连接，不扫描也不走DHCP
+// 缓存的AP关联或认证失败、缓存的IP被别的设备占用时清掉缓存，回到全信道扫描 + DHCP
+#define WIFI_FAST_CONNECT 1
+#define WIFI_FAST_NVS_KEY "wifiFast"
+// 连上AP后用ARP探测缓存的IP，等这么久没有别的设备应答就认为IP可以用
+#define WIFI_FAST_PROBE_MS 500
+// 断线重连的退避时间，从最小值开始每次翻倍
+#define WIFI_BACKOFF_MIN_MS 500
+#define WIFI_BACKOFF_MAX_MS (60 * 1000)
 
-// 长连接码
-#define LONG_CONNCECT_CODE_DURATION_0 660
-#define LONG_CONNCECT_CODE_DURATION_1 20000
-#define LONG_CONNCECT_CODE_DURATION_3 10000
+// 学习到的波形展开后的最大符号数，超过15bit的空闲要多占一个符号
+#define IR_LEARN_MAX_SYMBOLS (IR_LEARN_MAX_PAIRS + 16)
+// 发送缓冲要放得下格力帧和学习到的波形
+#define IR_TX_FRAME_SYMBOLS (IR_LEARN_MAX_SYMBOLS > IR_GREE_FRAME_SYMBOLS ? IR_LEARN_MAX_SYMBOLS : IR_GREE_FRAME_SYMBOLS)
+// 重复发送时帧后面补的空闲符号，每个最长2 * RMT_DURATION_MAX
+#define IR_GREE_GAP_SYMBOLS ((IR_GREE_CMD_GAP_MAX_MS * 1000 + 2 * RMT_DURATION_MAX - 1) / (2 * RMT_DURATION_MAX))
+// 帧缓冲的符号数，重复发送时帧后面跟着帧间隔的空闲符号
+#define IR_TX_BUFFER_SYMBOLS (IR_TX_FRAME_SYMBOLS + IR_GREE_GAP_SYMBOLS)
 
-// 结束码
-#define END_CODE_DURATION_0 660
-#define END_CODE_DURATION_1 0x7FFF
+static const char *TAG = "My RMT";
+static int s_retry_num = 0;
 
-// 一共4段数据码，第一段和第三段都是35位，其中后7位是固定的，
-// 又因为乐鑫RMT驱动只能按字节编码，故后三位在编码阶段使用硬编码
 typedef struct
 {
-    uint32_t data1;
-    uint32_t data2;
-    uint32_t data3;
-    uint32_t data4;
-} ir_gree_scan_code_t;
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info;
+} wifi_fast_config_t;
+
+static esp_netif_t *s_sta_netif = NULL;
+static wifi_fast_config_t s_wifi_fast;
+static bool s_wifi_fast_valid = false;
+// 当前连接用的是缓存的AP和IP
+static bool s_wifi_fast_active = false;
+static esp_timer_handle_t s_wifi_retry_timer = NULL;
+static esp_timer_handle_t s_wifi_probe_timer = NULL;
+// 第一次连上MQTT的时间，从启动开始计
+static int64_t s_ready_us = 0;
+
+// 命令队列满时的处理方式
+typedef enum
+{
+    IR_TX_POLICY_DROP_NEWEST,    // 丢弃新命令
+    IR_TX_POLICY_REPLACE_OLDEST, // 丢弃最旧的命令，放入新命令
+} ir_tx_policy_t;
 
 typedef struct
 {
-    uint32_t resolution;
-} ir_gree_encoder_config_t;
+    ir_gree_packed_t frame;
+    // 不为空时发送学习到的这个名字的波形，不用frame
+    char learned[IR_LEARN_NAME_MAX + 1];
+    // 第一帧之后再重复的次数和帧间隔，见ir_gree_cmd_opts_t
+    uint8_t repeat;
+    uint16_t gap_ms;
+    // MQTT收到命令和解析完的时间（esp_timer_get_time），rx_us为0时不统计延迟
+    int64_t rx_us;
+    int64_t parse_us;
+} ir_tx_cmd_t;
+
+typedef enum
+{
+    IR_LATENCY_PARSE,    // 收到 → 解析完
+    IR_LATENCY_QUEUE,    // 解析完 → rmt_transmit入队，包括排队和渲染
+    IR_LATENCY_TRANSMIT, // 入队 → 最后一次发送完成
+    IR_LATENCY_TOTAL,
+    IR_LATENCY_STAGE_NUM,
+} ir_latency_stage_t;
+
+static const char *s_latency_stage_names[IR_LATENCY_STAGE_NUM] = {"parse", "queue", "transmit", "total"};
 
 typedef struct
 {
-    rmt_encoder_t base;
+    uint32_t us[IR_LATENCY_STAGE_NUM];
+} ir_latency_sample_t;
 
-    rmt_encoder_t *copy_encoder;
-    rmt_symbol_word_t gree_leading_symbol;
-    rmt_symbol_word_t gree_ending_symbol;
-    rmt_symbol_word_t short_connecting_symbol;
-    // 最大间隔为32767，所以用两段编码表示
-    rmt_symbol_word_t long_connecting_symbol[2];
-    // 第一段和第三段数据有35位，因乐鑫rmt库只能按byte，无法按bit编码
-    // 且后三位固定为010，故采用硬编码,写在copy_encoder里面
-    rmt_symbol_word_t last_3_bits_symbol[3];
+// 单生产者（发送任务）单消费者（统计任务）的无锁环形缓冲，满了丢弃新样本
+typedef struct
+{
+    ir_latency_sample_t items[IR_LATENCY_RING_LEN];
+    atomic_uint head;
+    atomic_uint tail;
+    uint32_t dropped;
+} ir_latency_ring_t;
 
-    rmt_encoder_t *bytes_encoder;
-    int state;
-} rmt_ir_gree_encoder_t;
 
-static const char *TAG = "My RMT";
-static int s_retry_num = 0;
-static rmt_channel_handle_t tx_channel = NULL;
-static rmt_encoder_handle_t gree_encoder = NULL;
+// 发送统计，省下的发送次数 = coalesced + suppressed
+// submitted和dropped由MQTT、接收、定时命令等任务同时累加，所有计数都用原子操作
+typedef struct
+{
+    atomic_uint submitted;  // 提交的命令
+    atomic_uint sent;       // 实际发送的帧
+    atomic_uint coalesced;  // 发送期间被更新的命令覆盖
+    atomic_uint suppressed; // 与上一帧相同，不再发送
+    atomic_uint dropped;    // 队列满被丢弃
+    atomic_uint repeated;   // 重复发送的帧，不重新编码
+} ir_tx_stats_t;
+
+// 一台设备对应一台空调，有自己的topic：gree/<name>/set
+// 一台设备有多个通道时（比如同一房间需要一起动作的两台），这些通道同时发射同样的帧
+// rx为true的设备（最多一台）接收遥控器的命令，接收头要放在它的遥控器照得到的地方
+typedef struct
+{
+    const char *name;
+    int gpio_nums[IR_DEVICE_MAX_CHANNELS];
+    int channel_num;
+    bool rx;
+} ir_device_config_t;
+
+static const ir_device_config_t s_device_configs[] = {
+    {"living", {18}, 1, true},
+};
+
+#define IR_DEVICE_NUM (sizeof(s_device_configs) / sizeof(s_device_configs[0]))
+
+typedef struct
+{
+    const ir_device_config_t *config;
+    rmt_channel_handle_t channels[IR_DEVICE_MAX_CHANNELS];
+    rmt_encoder_handle_t encoders[IR_DEVICE_MAX_CHANNELS];
+    rmt_sync_manager_handle_t sync_manager;
+    // 第一个通道（编码器统计针对它）是否用DMA，以及它的内存块大小
+    bool tx_dma;
+    uint16_t tx_block_symbols;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    // 发送任务一次只发一帧，当前帧的数据要保留到发送完成
+    ir_tx_cmd_t cmd;
+#if IR_TX_PREBUILT_FRAME
+    // 渲染好的帧，重复发送时后面跟着帧间隔的空闲符号，IR_TX_BUFFER_SYMBOLS个，按IR_TX_FRAME_CAPS分配
+    rmt_symbol_word_t *frame;
+#endif
+    // 当前空调状态，MQTT任务和接收任务（遥控器）都会修改，用state_lock保护
+    gree_state_t state;
+    SemaphoreHandle_t state_lock;
+    // 遥控器改了空调状态，发送任务不能再按上一帧跳过重复命令
+    volatile bool remote_changed;
+    ir_tx_stats_t stats;
+    // 当前命令入队的时间和最后一次发送完成的时间，后者在中断中写
+    int64_t enqueue_us;
+    volatile int64_t done_us;
+    ir_latency_ring_t latency;
+    // 要写入日志的状态，MQTT任务和接收任务写，日志任务读，用s_journal_lock保护
+    gree_state_t journal_state;
+    bool journal_dirty;
+    // 要发布的状态，用s_sync_lock保护；已经发布的状态只在同步任务中访问
+    gree_state_t sync_state;
+    gree_state_t sync_published;
+    bool sync_published_valid;
+} ir_device_t;
+
+static ir_device_t s_devices[IR_DEVICE_NUM];
+// 接收遥控器命令的设备
+static ir_device_t *s_rx_device = NULL;
+
+static TaskHandle_t s_sync_task = NULL;
+static portMUX_TYPE s_sync_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 最近发送的扫描码，接收任务收到同样的扫描码时不当作遥控器的命令
+typedef struct
+{
+    ir_gree_scan_code_t scan_code;
+    int64_t until_us;
+} ir_echo_t;
+
+static ir_echo_t s_echoes[IR_SYNC_ECHO_SLOTS];
+static size_t s_echo_next = 0;
+static portMUX_TYPE s_echo_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static ir_gree_journal_t s_journal;
+static ir_gree_flash_t s_journal_flash;
+static const esp_partition_t *s_journal_partition = NULL;
+static TaskHandle_t s_journal_task = NULL;
+static portMUX_TYPE s_journal_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 预置帧放在flash中，每帧17字节，通过gree/<设备名>/preset按名字发送
+typedef struct
+{
+    const char *name;
+    ir_gree_packed_t frame;
+} ir_gree_preset_t;
+
+static const ir_gree_preset_t s_presets[] = {
+    // 制冷26度，自动风，灯光开
+    {"cool26", {{0x09, 0x0a, 0x20, 0x50, 0x02, 0x00, 0x00, 0x80, 0x4e, 0x50, 0x00, 0x81, 0x13, 0x00, 0x00, 0x00, 0x34}}},
+    // 制热22度，自动风，灯光开
+    {"heat22", {{0x0c, 0x06, 0x20, 0x50, 0x02, 0x00, 0x00, 0x00, 0x66, 0x30, 0x00, 0x81, 0x13, 0x00, 0x00, 0x00, 0x30}}},
+    // 关机
+    {"off", {{0x01, 0x0a, 0x20, 0x50, 0x02, 0x00, 0x00, 0x80, 0x0a, 0x50, 0x00, 0x81, 0x13, 0x00, 0x00, 0x00, 0x14}}},
+};
+
+static rmt_channel_handle_t rx_channel = NULL;
+// 乒乓缓冲，一块在接收时解码另一块
+static rmt_symbol_word_t s_rx_buffer[2][IR_RX_BUFFER_SYMBOLS];
+static QueueHandle_t s_rx_queue = NULL;
+// 解码窗口，校准时由接收任务更新
+static ir_gree_windows_t s_rx_windows;
+#if IR_RX_CALIBRATE
+static ir_gree_calib_t s_rx_calib;
+static uint32_t s_rx_calib_pending = 0;
+#endif
+
+// 接收完成事件，附带中断中的时间，用来还原被长空闲分开的两块之间的间隔
+typedef struct
+{
+    rmt_rx_done_event_data_t data;
+    int64_t done_us;
+} ir_rx_event_t;
+
+// MQTT任务发给接收任务的学习请求
+typedef struct
+{
+    ir_device_t *device;
+    char name[IR_LEARN_NAME_MAX + 1];
+    int64_t request_us;
+} ir_learn_request_t;
+
+// 正在学习的波形，只在接收任务中使用
+typedef struct
+{
+    ir_learn_request_t request;
+    bool active;
+    bool overflow;
+    size_t count;
+    // 上一块最后一个mark结束的时间
+    int64_t last_mark_end_us;
+    ir_gree_pulse_t pulses[IR_LEARN_MAX_PAIRS];
+} ir_learn_t;
+
+static QueueHandle_t s_learn_queue = NULL;
+static ir_learn_t s_learn;
+
+typedef struct
+{
+    bool used;
+    uint8_t device; // s_devices中的序号
+    ir_gree_sched_t sched;
+} ir_sched_slot_t;
+
+// 定时命令和时间轮，MQTT任务增删，定时任务执行，用s_sched_lock保护
+// 时间轮以系统时间的秒为tick，第i个节点对应s_scheds[i]
+static ir_sched_slot_t s_scheds[IR_SCHED_MAX];
+static ir_gree_wheel_node_t s_sched_nodes[IR_SCHED_MAX];
+static ir_gree_wheel_t s_sched_wheel;
+// 对过时以后时间轮才开始转
+static bool s_sched_running = false;
+static SemaphoreHandle_t s_sched_lock = NULL;
+// 每台设备的定时命令列表每次修改加1，发布时用来发现发布期间的修改
+static uint32_t s_sched_gen[IR_DEVICE_NUM];
+
+// 空调命令的topic为gree/<设备名>/set，格式见ir_gree_cmd.h
+#define MQTT_TOPIC_PREFIX "gree/"
+#define MQTT_CMD_TOPIC_SUFFIX "/set"
+#define MQTT_PRESET_TOPIC_SUFFIX "/preset"
+// 学习和发送学习到的波形，消息为名字，学习结果发布到gree/<设备名>/learned
+#define MQTT_LEARN_TOPIC_SUFFIX "/learn"
+#define MQTT_REPLAY_TOPIC_SUFFIX "/replay"
+#define MQTT_LEARNED_TOPIC_SUFFIX "/learned"
+// 定时命令：gree/<设备名>/schedule/add为一条定时命令，schedule/del为要删除的id，
+// 每次修改后把这台设备的所有定时命令作为JSON数组发布到gree/<设备名>/schedules（retained）
+#define MQTT_SCHED_ADD_TOPIC_SUFFIX "/schedule/add"
+#define MQTT_SCHED_DEL_TOPIC_SUFFIX "/schedule/del"
+#define MQTT_SCHEDULES_TOPIC_SUFFIX "/schedules"
+// 状态变化：gree/<设备名>/state为最近一次变化字段的JSON，gree/<设备名>/state/<字段>为各字段的值，都是retained
+#define MQTT_STATE_TOPIC_SUFFIX "/state"
+// 分块到达的命令最大长度
+#define MQTT_CMD_MAX_LEN 256
+
+// 分块到达的命令在这里拼接，只有一块时直接在event->data上解析
+static char s_mqtt_cmd_buf[MQTT_CMD_MAX_LEN];
+// 当前消息对应的设备，不是命令时为NULL
+static ir_device_t *s_mqtt_cmd_device = NULL;
+typedef enum
+{
+    MQTT_MSG_CMD,
+    MQTT_MSG_PRESET,
+    MQTT_MSG_LEARN,
+    MQTT_MSG_REPLAY,
+    MQTT_MSG_SCHED_ADD,
+    MQTT_MSG_SCHED_DEL,
+    MQTT_MSG_NUM,
+} mqtt_msg_kind_t;
+
+static const char *s_mqtt_msg_suffixes[MQTT_MSG_NUM] = {
+    MQTT_CMD_TOPIC_SUFFIX,
+    MQTT_PRESET_TOPIC_SUFFIX,
+    MQTT_LEARN_TOPIC_SUFFIX,
+    MQTT_REPLAY_TOPIC_SUFFIX,
+    MQTT_SCHED_ADD_TOPIC_SUFFIX,
+    MQTT_SCHED_DEL_TOPIC_SUFFIX,
+};
+
+// 当前消息是命令、预置帧的名字、学习到的波形的名字还是定时命令
+static mqtt_msg_kind_t s_mqtt_cmd_kind = MQTT_MSG_CMD;
+// 当前消息第一块到达的时间
+static int64_t s_mqtt_cmd_rx_us = 0;
+
+// 延迟统计发布到gree/<设备名>/stats/latency
+#define MQTT_STATS_TOPIC_SUFFIX "/stats/latency"
+static esp_mqtt_client_handle_t s_mqtt_client = NULL;
+// MQTT任务写，同步、统计、定时和接收任务读
+static atomic_bool s_mqtt_connected = false;
 
 static EventGroupHandle_t s_wifi_event_group;
 static const int NETWORK_CONFIGED_BIT = BIT0;
 static const int ESPTOUCH_DONE_BIT = BIT1;
 
-static size_t rmt_encode_ir_gree(rmt_encoder_t *encoder,
-                                 rmt_channel_handle_t channel,
-                                 const void *primary_data,
-                                 size_t data_size,
-                                 rmt_encode_state_t *ret_stat)
+static bool IRAM_ATTR rmt_tx_done_callback(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *edata, void *user_data)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    ir_device_t *device = (ir_device_t *)user_data;
+    device->done_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(device->task, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+static void ir_latency_push(ir_latency_ring_t *ring, const ir_latency_sample_t *sample)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= IR_LATENCY_RING_LEN)
+    {
+        ring->dropped++;
+        return;
+    }
+    ring->items[head % IR_LATENCY_RING_LEN] = *sample;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static bool ir_latency_pop(ir_latency_ring_t *ring, ir_latency_sample_t *sample)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail)
+    {
+        return false;
+    }
+    *sample = ring->items[tail % IR_LATENCY_RING_LEN];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// 当前命令发送完成后记录各阶段耗时
+static void ir_latency_record(ir_device_t *device)
+{
+    const ir_tx_cmd_t *cmd = &device->cmd;
+    if (cmd->rx_us == 0)
+    {
+        return;
+    }
+    ir_latency_sample_t sample = {
+        .us = {
+            [IR_LATENCY_PARSE] = cmd->parse_us - cmd->rx_us,
+            [IR_LATENCY_QUEUE] = device->enqueue_us - cmd->parse_us,
+            [IR_LATENCY_TRANSMIT] = device->done_us - device->enqueue_us,
+            [IR_LATENCY_TOTAL] = device->done_us - cmd->rx_us,
+        },
+    };
+    ir_latency_push(&device->latency, &sample);
+}
+
+// 计数只用来统计，不和其他数据同步
+static void ir_tx_stats_add(atomic_uint *counter, unsigned n)
+{
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+static uint32_t ir_tx_stats_get(atomic_uint *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+// 不阻塞，队列满时按policy处理，网络任务可以放心调用
+esp_err_t ir_tx_submit(ir_device_t *device, const ir_tx_cmd_t *cmd, ir_tx_policy_t policy)
+{
+    ir_tx_stats_add(&device->stats.submitted, 1);
+    if (xQueueSend(device->queue, cmd, 0) == pdTRUE)
+    {
+        return ESP_OK;
+    }
+    ir_tx_stats_add(&device->stats.dropped, 1);
+    if (policy == IR_TX_POLICY_DROP_NEWEST)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // MQTT、接收和定时任务都会提交，取出最旧的之后空位可能被别的任务抢走，
+    // 队列操作不能放进临界区，只能重试有限次，每次挤掉的命令都记作丢弃
+    for (int i = 0; i < IR_TX_REPLACE_RETRIES; i++)
+    {
+        ir_tx_cmd_t oldest;
+        xQueueReceive(device->queue, &oldest, 0);
+        if (xQueueSend(device->queue, cmd, 0) == pdTRUE)
+        {
+            return ESP_OK;
+        }
+        ir_tx_stats_add(&device->stats.dropped, 1);
+    }
+    ESP_LOGW(TAG, "%s: queue contended, command dropped", device->config->name);
+    return ESP_ERR_TIMEOUT;
+}
+
+#if IR_TX_PREBUILT_FRAME
+// 从NVS读出学习到的波形，直接展开到frame中，返回符号数，找不到或者放不下时返回0
+static size_t ir_learn_build_frame(const char *name, rmt_symbol_word_t *frame, size_t max_symbols)
+{
+    uint8_t blob[IR_GREE_LEARN_MAX_SIZE(IR_LEARN_MAX_PAIRS)];
+    size_t len = sizeof(blob);
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(IR_LEARN_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_get_blob(nvs_handle, name, blob, &len);
+        nvs_close(nvs_handle);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "learned %s not found: %s", name, esp_err_to_name(ret));
+        return 0;
+    }
+
+    ir_gree_learn_reader_t reader;
+    if (ir_gree_learn_reader_init(&reader, blob, len) != IR_GREE_LEARN_OK)
+    {
+        ESP_LOGW(TAG, "learned %s is corrupted", name);
+        return 0;
+    }
+    ir_gree_pulse_t pulse;
+    rmt_symbol_word_t *p = frame;
+    while (ir_gree_learn_next(&reader, &pulse))
+    {
+        // 一对mark/space最多占2个符号
+        if (p + 2 > frame + max_symbols)
+        {
+            ESP_LOGW(TAG, "learned %s is too long", name);
+            return 0;
+        }
+        p += ir_gree_pulse_symbols(pulse, p);
+    }
+    if (reader.remaining != 0)
+    {
+        ESP_LOGW(TAG, "learned %s is corrupted", name);
+        return 0;
+    }
+    return p - frame;
+}
+
+// 在frame后面补全低电平的符号，使结束码之后的空闲达到gap_ms，返回补的符号数
+static size_t ir_gree_build_gap(uint16_t gap_ms, rmt_symbol_word_t *symbols)
+{
+    // 结束码的符号已经带了END_CODE_DURATION_1的低电平
+    uint32_t gap = (uint32_t)gap_ms * 1000;
+    gap = gap > END_CODE_DURATION_1 ? gap - END_CODE_DURATION_1 : 0;
+    size_t count = 0;
+
+    while (gap > 0)
+    {
+        uint32_t duration = gap > 2 * RMT_DURATION_MAX ? 2 * RMT_DURATION_MAX : gap;
+        symbols[count++] = (rmt_symbol_word_t){
+            .level0 = 0,
+            .duration0 = duration / 2,
+            .level1 = 0,
+            .duration1 = duration - duration / 2,
+        };
+        gap -= duration;
+    }
+    return count;
+}
+#else
+// 编码器只生成整帧，重复发送时等所有通道发完上一帧，再延时补足帧间隔
+static esp_err_t ir_device_wait_gap(ir_device_t *device)
+{
+    for (int i = 0; i < device->config->channel_num; i++)
+    {
+        esp_err_t ret = rmt_tx_wait_all_done(device->channels[i], IR_TX_DONE_TIMEOUT_MS);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+    // 结束码的符号已经带了END_CODE_DURATION_1的低电平
+    uint32_t gap = (uint32_t)device->cmd.gap_ms * 1000;
+    if (gap > END_CODE_DURATION_1)
+    {
+        vTaskDelay(pdMS_TO_TICKS((gap - END_CODE_DURATION_1 + 999) / 1000));
+    }
+    return ESP_OK;
+}
+#endif
+
+// 记下自己发出的扫描码，until_us之前接收头收到同样的扫描码当作回波
+static void ir_echo_add(const ir_gree_packed_t *frame, int64_t until_us)
+{
+    ir_gree_scan_code_t scan_code;
+    ir_gree_unpack(frame, &scan_code);
+    portENTER_CRITICAL(&s_echo_lock);
+    s_echoes[s_echo_next] = (ir_echo_t){
+        .scan_code = scan_code,
+        .until_us = until_us,
+    };
+    s_echo_next = (s_echo_next + 1) % IR_SYNC_ECHO_SLOTS;
+    portEXIT_CRITICAL(&s_echo_lock);
+}
+
+// 不消耗匹配的记录，重复发送的每一帧都要过滤掉
+static bool ir_echo_match(const ir_gree_scan_code_t *scan_code, int64_t now_us)
+{
+    bool match = false;
+    portENTER_CRITICAL(&s_echo_lock);
+    for (size_t i = 0; i < IR_SYNC_ECHO_SLOTS && !match; i++)
+    {
+        match = now_us < s_echoes[i].until_us && memcmp(&s_echoes[i].scan_code, scan_code, sizeof(*scan_code)) == 0;
+    }
+    portEXIT_CRITICAL(&s_echo_lock);
+    return match;
+}
+
+// 在所有通道上发送当前命令，有sync_manager时各通道同时开始，transmissions为入队的发送次数
+// 重复发送时整帧只渲染一次，同一块缓冲连续放进发送队列，发送之间不需要CPU参与
+// RMT的loop_count要求整帧放得进一个内存块，141个符号放不下，所以没有用硬件循环
+static esp_err_t ir_device_transmit(ir_device_t *device, int *transmissions)
+{
+    rmt_transmit_config_t transmit_config = {
+        .loop_count = 0,
+    };
+    esp_err_t ret = ESP_OK;
+    *transmissions = 0;
+#if IR_TX_PREBUILT_FRAME
+    int rounds = 1 + device->cmd.repeat;
+    size_t symbols = device->cmd.learned[0] ? ir_learn_build_frame(device->cmd.learned, device->frame, IR_TX_FRAME_SYMBOLS)
+                                            : ir_gree_build_frame(&device->cmd.frame, device->frame);
+    if (symbols == 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t gap_symbols = device->cmd.repeat ? ir_gree_build_gap(device->cmd.gap_ms, device->frame + symbols) : 0;
+#else
+    int rounds = 1 + device->cmd.repeat;
+    // 流式编码器只能生成格力帧
+    if (device->cmd.learned[0])
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+
+    device->enqueue_us = esp_timer_get_time();
+    // 在发送前记下，接收头收到回波时一定已经记好了
+    if (!device->cmd.learned[0])
+    {
+        ir_echo_add(&device->cmd.frame, device->enqueue_us + (rounds * (IR_SYNC_ECHO_MS + device->cmd.gap_ms)) * 1000LL);
+    }
+    for (int round = 0; round < rounds && ret == ESP_OK; round++)
+    {
+#if !IR_TX_PREBUILT_FRAME
+        if (round > 0)
+        {
+            ret = ir_device_wait_gap(device);
+        }
+#endif
+        for (int i = 0; i < device->config->channel_num && ret == ESP_OK; i++)
+        {
+#if IR_TX_PREBUILT_FRAME
+            // 最后一帧不带帧间隔，发送完成后可以马上处理下一条命令
+            size_t count = round + 1 < rounds ? symbols + gap_symbols : symbols;
+            ret = rmt_transmit(device->channels[i], device->encoders[i], device->frame, count * sizeof(rmt_symbol_word_t), &transmit_config);
+#else
+            ret = rmt_transmit(device->channels[i], device->encoders[i], &device->cmd.frame, sizeof(device->cmd.frame), &transmit_config);
+#endif
+            if (ret == ESP_OK)
+            {
+                (*transmissions)++;
+            }
+        }
+    }
+    if (ret == ESP_OK)
+    {
+        ir_tx_stats_add(&device->stats.repeated, rounds - 1);
+    }
+    return ret;
+}
+
+static void ir_tx_task(void *arg)
+{
+    ir_device_t *device = (ir_device_t *)arg;
+    ir_tx_cmd_t next;
+    ir_gree_packed_t last_sent;
+    bool has_last_sent = false;
+    esp_err_t ret;
+
+    while (1)
+    {
+        if (xQueueReceive(device->queue, &device->cmd, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        // 上一帧发送期间积压的命令只保留最新的一条
+        while (xQueueReceive(device->queue, &next, 0) == pdTRUE)
+        {
+            device->cmd = next;
+            ir_tx_stats_add(&device->stats.coalesced, 1);
+        }
+        if (device->remote_changed)
+        {
+            device->remote_changed = false;
+            has_last_sent = false;
+        }
+        // 要求重复发送的命令是有意补发，不按重复帧跳过
+        if (has_last_sent && device->cmd.repeat == 0 && !device->cmd.learned[0] &&
+            memcmp(&last_sent, &device->cmd.frame, sizeof(last_sent)) == 0)
+        {
+            ir_tx_stats_add(&device->stats.suppressed, 1);
+            continue;
+        }
+        int pending;
+        ret = ir_device_transmit(device, &pending);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "%s: transmit failed: %s", device->config->name, esp_err_to_name(ret));
+            if (device->sync_manager)
+            {
+                rmt_sync_reset(device->sync_manager);
+            }
+            if (pending == 0)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            // 学习到的波形不知道会把空调设成什么状态，之后的格力帧不能按重复跳过
+            last_sent = device->cmd.frame;
+            has_last_sent = !device->cmd.learned[0];
+            ir_tx_stats_add(&device->stats.sent, 1);
+        }
+        // 等所有通道的所有重复发完再取下一条命令，每次发送完成回调通知一次
+        while (pending > 0)
+        {
+            uint32_t done = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IR_TX_DONE_TIMEOUT_MS + device->cmd.gap_ms));
+            if (done == 0)
+            {
+                ESP_LOGW(TAG, "%s: wait for transmit done timeout", device->config->name);
+                break;
+            }
+            pending -= done;
+        }
+        if (ret == ESP_OK && pending <= 0)
+        {
+            ir_latency_record(device);
+        }
+
+        ir_gree_encoder_stats_t stats;
+        rmt_ir_gree_encoder_get_stats(device->encoders[0], &stats);
+        ESP_LOGD(TAG, "%s encoder: frames=%" PRIu32 " calls=%" PRIu32 " avg_cycles=%" PRIu64 " max_cycles=%" PRIu32,
+                 device->config->name, stats.frames, stats.encode_calls,
+                 stats.encode_calls ? stats.encode_cycles_total / stats.encode_calls : 0,
+                 stats.encode_cycles_max);
+        ESP_LOGD(TAG, "%s refills (dma=%d block=%d): total=%" PRIu32 " per_frame=%.1f max_per_frame=%" PRIu32 " max_isr_cycles=%" PRIu32,
+                 device->config->name, device->tx_dma, device->tx_block_symbols, stats.refills,
+                 stats.frames ? (double)stats.refills / stats.frames : 0.0, stats.refills_max, stats.refill_cycles_max);
+        // 每个计数只读一次，saved和后面的两项一致
+        uint32_t coalesced = ir_tx_stats_get(&device->stats.coalesced);
+        uint32_t suppressed = ir_tx_stats_get(&device->stats.suppressed);
+        ESP_LOGD(TAG, "%s tx: submitted=%" PRIu32 " sent=%" PRIu32 " repeated=%" PRIu32 " saved=%" PRIu32 " (coalesced=%" PRIu32 " suppressed=%" PRIu32 ") dropped=%" PRIu32,
+                 device->config->name, ir_tx_stats_get(&device->stats.submitted), ir_tx_stats_get(&device->stats.sent),
+                 ir_tx_stats_get(&device->stats.repeated), coalesced + suppressed,
+                 coalesced, suppressed, ir_tx_stats_get(&device->stats.dropped));
+    }
+}
+
+static void init_ir_device(ir_device_t *device, const ir_device_config_t *config)
+{
+    device->config = config;
+    device->state = (gree_state_t){
+        .power = 1,
+        .mode = GREE_MODE_COOL,
+        .temperature = 26,
+        .fan = GREE_FAN_AUTO,
+    };
+    device->sync_state = device->state;
+    device->state_lock = xSemaphoreCreateMutex();
+    assert(device->state_lock);
+    device->queue = xQueueCreate(IR_TX_CMD_QUEUE_LEN, sizeof(ir_tx_cmd_t));
+    assert(device->queue);
+#if IR_TX_PREBUILT_FRAME
+    device->frame = heap_caps_calloc(IR_TX_BUFFER_SYMBOLS, sizeof(rmt_symbol_word_t), IR_TX_FRAME_CAPS);
+    assert(device->frame);
+#endif
+    xTaskCreate(ir_tx_task, "ir_tx_task", 4096, device, 5, &device->task);
+
+    rmt_carrier_config_t carrier_cfg = {
+        .duty_cycle = 0.33,
+        .frequency_hz = 38000, // 38KHz
+    };
+    ir_gree_encoder_config_t encoder_cfg = {
+        .resolution = IR_RESOLUTION_HZ,
+        .prebuilt = IR_TX_PREBUILT_FRAME,
+    };
+    rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = rmt_tx_done_callback,
+    };
+
+    for (int i = 0; i < config->channel_num; i++)
+    {
+        rmt_tx_channel_config_t tx_channel_cfg = {
+            .clk_src = RMT_CLK_SRC_DEFAULT,
+            .resolution_hz = IR_RESOLUTION_HZ,
+            .mem_block_symbols = IR_TX_WITH_DMA ? IR_TX_DMA_BLOCK_SYMBOLS : IR_TX_RMT_BLOCK_SYMBOLS,
+            .trans_queue_depth = IR_TX_QUEUE_DEPTH,
+            .gpio_num = config->gpio_nums[i],
+            .flags.with_dma = IR_TX_WITH_DMA,
+        };
+        esp_err_t ret = rmt_new_tx_channel(&tx_channel_cfg, &device->channels[i]);
+#if IR_TX_WITH_DMA
+        // 能用DMA的RMT通道很少（ESP32-S3的发射只有一个），用完了就退回普通的内存块
+        if (ret == ESP_ERR_NOT_FOUND || ret == ESP_ERR_NOT_SUPPORTED)
+        {
+            ESP_LOGW(TAG, "%s: no DMA for tx channel %d, using %d symbol blocks", config->name, i, IR_TX_RMT_BLOCK_SYMBOLS);
+            tx_channel_cfg.mem_block_symbols = IR_TX_RMT_BLOCK_SYMBOLS;
+            tx_channel_cfg.flags.with_dma = 0;
+            ret = rmt_new_tx_channel(&tx_channel_cfg, &device->channels[i]);
+        }
+#endif
+        ESP_ERROR_CHECK(ret);
+        if (i == 0)
+        {
+            device->tx_dma = tx_channel_cfg.flags.with_dma;
+            device->tx_block_symbols = tx_channel_cfg.mem_block_symbols;
+        }
+        ESP_ERROR_CHECK(rmt_apply_carrier(device->channels[i], &carrier_cfg));
+        ESP_ERROR_CHECK(rmt_new_ir_gree_encoder(&encoder_cfg, &device->encoders[i]));
+        ESP_ERROR_CHECK(rmt_tx_register_event_callbacks(device->channels[i], &cbs, device));
+        ESP_ERROR_CHECK(rmt_enable(device->channels[i]));
+    }
+
+    if (config->channel_num > 1)
+    {
+        rmt_sync_manager_config_t sync_cfg = {
+            .tx_channel_array = device->channels,
+            .array_size = config->channel_num,
+        };
+        ESP_ERROR_CHECK(rmt_new_sync_manager(&sync_cfg, &device->sync_manager));
+    }
+}
+
+// 记下设备的当前状态，由同步任务合并后发布，调用者持有state_lock
+static void ir_sync_mark(ir_device_t *device)
+{
+    if (!s_sync_task)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_sync_lock);
+    device->sync_state = device->state;
+    portEXIT_CRITICAL(&s_sync_lock);
+    xTaskNotifyGive(s_sync_task);
+}
+
+// 只发布与上次发布不同的字段：gree/<设备名>/state为这些字段的JSON，可以直接作为命令，
+// gree/<设备名>/state/<字段>为字段的值。都是retained，新的订阅者马上从各字段拿到完整状态。第一次发布所有字段
+static void ir_sync_publish(ir_device_t *device)
+{
+    const char *name = device->config->name;
+    gree_state_t state;
+    portENTER_CRITICAL(&s_sync_lock);
+    state = device->sync_state;
+    portEXIT_CRITICAL(&s_sync_lock);
+
+    uint16_t mask = device->sync_published_valid ? ir_gree_cmd_diff(&state, &device->sync_published) : IR_GREE_CMD_STATE_ALL;
+    if (mask == 0)
+    {
+        return;
+    }
+    char topic[64];
+    char payload[160];
+    int n = ir_gree_cmd_format(&state, mask, payload, sizeof(payload));
+    snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "%s" MQTT_STATE_TOPIC_SUFFIX, name);
+    bool ok = esp_mqtt_client_publish(s_mqtt_client, topic, payload, n, 1, 1) >= 0;
+    ESP_LOGI(TAG, "%s: state %s", name, payload);
+
+    for (size_t i = 0; i < IR_GREE_CMD_STATE_FIELDS; i++)
+    {
+        if (!(mask & (1u << i)))
+        {
+            continue;
+        }
+        char value[16];
+        snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "%s" MQTT_STATE_TOPIC_SUFFIX "/%s", name, ir_gree_cmd_key(i));
+        n = ir_gree_cmd_format_value(&state, i, value, sizeof(value));
+        ok = esp_mqtt_client_publish(s_mqtt_client, topic, value, n, 1, 1) >= 0 && ok;
+    }
+    // 失败时下次连同新的修改一起重发
+    if (ok)
+    {
+        device->sync_published = state;
+        device->sync_published_valid = true;
+    }
+    else
+    {
+        ESP_LOGW(TAG, "%s: state publish failed", name);
+    }
+}
+
+static void ir_sync_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(IR_SYNC_BATCH_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+        // 断线期间的修改在连上时发布，MQTT_EVENT_CONNECTED会通知
+        if (!atomic_load_explicit(&s_mqtt_connected, memory_order_acquire))
+        {
+            continue;
+        }
+        for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+        {
+            ir_sync_publish(&s_devices[i]);
+        }
+    }
+}
+
+void init_ir(void)
+{
+    for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+    {
+        init_ir_device(&s_devices[i], &s_device_configs[i]);
+        if (s_device_configs[i].rx && !s_rx_device)
+        {
+            s_rx_device = &s_devices[i];
+        }
+    }
+    xTaskCreate(ir_sync_task, "ir_sync_task", 3072, NULL, 2, &s_sync_task);
+}
+
+static bool IRAM_ATTR rmt_rx_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata, void *user_data)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    QueueHandle_t queue = (QueueHandle_t)user_data;
+    ir_rx_event_t event = {
+        .data = *edata,
+        .done_us = esp_timer_get_time(),
+    };
+    xQueueSendFromISR(queue, &event, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+// 压缩学习到的波形并保存，结果发布到gree/<设备名>/learned
+static void ir_learn_finish(ir_learn_t *learn)
+{
+    const char *name = learn->request.name;
+    ir_device_t *device = learn->request.device;
+    uint8_t blob[IR_GREE_LEARN_MAX_SIZE(IR_LEARN_MAX_PAIRS)];
+    size_t len = 0;
+    esp_err_t ret = ESP_FAIL;
+
+    learn->active = false;
+    if (learn->count == 0)
+    {
+        ESP_LOGW(TAG, "learn %s: nothing received", name);
+        return;
+    }
+    if (learn->overflow)
+    {
+        ESP_LOGW(TAG, "learn %s: more than %d pulses, truncated", name, IR_LEARN_MAX_PAIRS);
+    }
+    // 最后一个mark后面没有下降沿
+    learn->pulses[learn->count - 1].space = 0;
+    ir_gree_learn_err_t err = ir_gree_learn_compress(learn->pulses, learn->count, blob, sizeof(blob), &len);
+    if (err != IR_GREE_LEARN_OK)
+    {
+        ESP_LOGW(TAG, "learn %s: compress failed: %d", name, err);
+        return;
+    }
+
+    nvs_handle_t nvs_handle;
+    ret = nvs_open(IR_LEARN_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_set_blob(nvs_handle, name, blob, len);
+        if (ret == ESP_OK)
+        {
+            ret = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    // 未压缩时每对mark/space是一个RMT符号
+    size_t raw = learn->count * sizeof(rmt_symbol_word_t);
+    ESP_LOGI(TAG, "learn %s: %d pulses, %d -> %d bytes, dict %d/%d, save: %s", name, (int)learn->count, (int)raw, (int)len,
+             blob[2], blob[3], esp_err_to_name(ret));
+
+    if (atomic_load_explicit(&s_mqtt_connected, memory_order_acquire))
+    {
+        char topic[64];
+        char payload[128];
+        snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "%s" MQTT_LEARNED_TOPIC_SUFFIX, device->config->name);
+        int n = snprintf(payload, sizeof(payload), "{\"name\":\"%s\",\"pulses\":%d,\"bytes\":%d,\"ratio\":%.2f,\"saved\":%s}",
+                         name, (int)learn->count, (int)len, (double)raw / len, ret == ESP_OK ? "true" : "false");
+        esp_mqtt_client_publish(s_mqtt_client, topic, payload, n, 1, 0);
+    }
+}
+
+// 把一块接收结果接到正在学习的波形后面，两块之间的空闲由接收完成的时间推算
+static void ir_learn_feed(ir_learn_t *learn, const ir_rx_event_t *event)
+{
+    // 最后一个mark之后空闲超过signal_range_max才触发接收完成
+    int64_t end_us = event->done_us - IR_RX_SIGNAL_RANGE_MAX_NS / 1000;
+    int64_t start_us = end_us;
+    for (size_t i = 0; i < event->data.num_symbols; i++)
+    {
+        start_us -= event->data.received_symbols[i].duration0 + event->data.received_symbols[i].duration1;
+    }
+
+    if (learn->count > 0)
+    {
+        int64_t gap = start_us - learn->last_mark_end_us;
+        if (gap > IR_GREE_LEARN_IDLE_US)
+        {
+            ir_learn_finish(learn);
+            return;
+        }
+        learn->pulses[learn->count - 1].space = gap < 1 ? 1 : gap > UINT16_MAX ? UINT16_MAX : gap;
+    }
+    for (size_t i = 0; i < event->data.num_symbols; i++)
+    {
+        const rmt_symbol_word_t *symbol = &event->data.received_symbols[i];
+        if (learn->count == IR_LEARN_MAX_PAIRS)
+        {
+            learn->overflow = true;
+            break;
+        }
+        learn->pulses[learn->count++] = (ir_gree_pulse_t){
+            .mark = symbol->duration0,
+            .space = symbol->duration1,
+        };
+    }
+    learn->last_mark_end_us = end_us;
+}
+
+#if IR_RX_CALIBRATE
+static void ir_rx_calibrate(const rmt_symbol_word_t *symbol)
+{
+    // 最后一个脉冲后面没有下降沿，不是完整的周期
+    if (symbol->duration1 == 0)
+    {
+        return;
+    }
+    ir_gree_calib_add(&s_rx_calib, symbol->duration0 + symbol->duration1);
+    if (++s_rx_calib_pending < IR_RX_CALIB_PERIODS)
+    {
+        return;
+    }
+    s_rx_calib_pending = 0;
+
+    ir_gree_windows_t windows = s_rx_windows;
+    ir_gree_calib_stat_t stats[IR_GREE_CALIB_CLASS_NUM];
+    if (ir_gree_calib_solve(&s_rx_calib, &windows, stats) && memcmp(&windows, &s_rx_windows, sizeof(windows)) != 0)
+    {
+        // 解码器引用s_rx_windows，改完下一个周期就用新窗口
+        s_rx_windows = windows;
+        ESP_LOGI(TAG, "calibrated: leader %" PRIu32 " zero %" PRIu32 " one %" PRIu32 " connect %" PRIu32 " us",
+                 stats[IR_GREE_CALIB_LEADER].center, stats[IR_GREE_CALIB_ZERO].center,
+                 stats[IR_GREE_CALIB_ONE].center, stats[IR_GREE_CALIB_CONNECT].center);
+    }
+}
+#endif
+
+static void ir_journal_mark(ir_device_t *device);
+
+// 遥控器改了空调状态，之后的MQTT命令在它的基础上修改
+static void ir_rx_apply(const gree_state_t *state)
+{
+    ir_device_t *device = s_rx_device;
+    if (!device)
+    {
+        return;
+    }
+    xSemaphoreTake(device->state_lock, portMAX_DELAY);
+    uint16_t mask = ir_gree_cmd_diff(&device->state, state);
+    if (mask)
+    {
+        device->state = *state;
+        device->remote_changed = true;
+        ir_journal_mark(device);
+        ir_sync_mark(device);
+    }
+    xSemaphoreGive(device->state_lock);
+    if (mask)
+    {
+        char changed[160];
+        ir_gree_cmd_format(state, mask, changed, sizeof(changed));
+        ESP_LOGI(TAG, "%s: remote %s", device->config->name, changed);
+    }
+}
+
+static void ir_rx_task(void *arg)
+{
+    rmt_receive_config_t receive_config = {
+        .signal_range_min_ns = IR_RX_SIGNAL_RANGE_MIN_NS,
+        .signal_range_max_ns = IR_RX_SIGNAL_RANGE_MAX_NS,
+    };
+    ir_rx_event_t rx_event;
+    const rmt_rx_done_event_data_t *rx_data = &rx_event.data;
+    ir_gree_decoder_t decoder;
+    ir_gree_scan_code_t scan_code;
+    int64_t last_rx_time = 0;
+    int buffer_idx = 0;
+
+    s_rx_windows = ir_gree_default_windows;
+#if IR_RX_CALIBRATE
+    ir_gree_calib_init(&s_rx_calib);
+#endif
+    ir_gree_decoder_init(&decoder, &s_rx_windows);
+    ESP_ERROR_CHECK(rmt_receive(rx_channel, s_rx_buffer[buffer_idx], sizeof(s_rx_buffer[buffer_idx]), &receive_config));
+    while (1)
+    {
+        // 学习时空闲超过IR_GREE_LEARN_IDLE_US认为按键结束
+        TickType_t wait = s_learn.active && s_learn.count ? pdMS_TO_TICKS(IR_GREE_LEARN_IDLE_US / 1000) : portMAX_DELAY;
+        if (xQueueReceive(s_rx_queue, &rx_event, wait) != pdTRUE)
+        {
+            if (s_learn.active)
+            {
+                ir_learn_finish(&s_learn);
+            }
+            continue;
+        }
+        // 先用另一块缓冲继续接收，再解码刚收到的
+        buffer_idx ^= 1;
+        ESP_ERROR_CHECK(rmt_receive(rx_channel, s_rx_buffer[buffer_idx], sizeof(s_rx_buffer[buffer_idx]), &receive_config));
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_rx_time > IR_RX_FRAME_TIMEOUT_US)
+        {
+            ir_gree_decoder_init(&decoder, &s_rx_windows);
+        }
+        last_rx_time = now;
+
+        // 学习请求在按下遥控器后才开始，超时的请求直接丢弃
+        if (!s_learn.active && xQueueReceive(s_learn_queue, &s_learn.request, 0) == pdTRUE)
+        {
+            if (now - s_learn.request.request_us < IR_LEARN_TIMEOUT_MS * 1000)
+            {
+                s_learn.active = true;
+                s_learn.overflow = false;
+                s_learn.count = 0;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "learn %s: timeout", s_learn.request.name);
+            }
+        }
+        if (s_learn.active)
+        {
+            ir_learn_feed(&s_learn, &rx_event);
+        }
+
+        // 接收头输出空闲为高电平，level0为低电平即mark
+        for (size_t i = 0; i < rx_data->num_symbols; i++)
+        {
+            const rmt_symbol_word_t *symbol = &rx_data->received_symbols[i];
+#if IR_RX_CALIBRATE
+            // 学习的是别的遥控器，不参与校准
+            if (!s_learn.active)
+            {
+                ir_rx_calibrate(symbol);
+            }
+#endif
+            if (!ir_gree_decoder_feed(&decoder, symbol->duration0, symbol->duration1, &scan_code))
+            {
+                continue;
+            }
+            ESP_LOGI(TAG, "received scan code %08" PRIx32 " %08" PRIx32 " %08" PRIx32 " %08" PRIx32,
+                     scan_code.data1, scan_code.data2, scan_code.data3, scan_code.data4);
+            gree_state_t state;
+            if (!gree_state_unpack(&scan_code, &state))
+            {
+                ESP_LOGW(TAG, "checksum mismatch");
+            }
+            else if (ir_echo_match(&scan_code, now))
+            {
+                ESP_LOGD(TAG, "echo of own transmission, ignored");
+            }
+            else if (!s_learn.active)
+            {
+                ir_rx_apply(&state);
+            }
+        }
+    }
+}
+
+void init_ir_rx(void)
+{
+    rmt_rx_channel_config_t rx_channel_cfg = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = IR_RESOLUTION_HZ,
+        .mem_block_symbols = 64,
+        .gpio_num = IR_RX_GPIO_NUM,
+        .flags.with_dma = IR_RX_WITH_DMA,
+    };
+    ESP_ERROR_CHECK(rmt_new_rx_channel(&rx_channel_cfg, &rx_channel));
+
+    s_rx_queue = xQueueCreate(2, sizeof(ir_rx_event_t));
+    assert(s_rx_queue);
+    s_learn_queue = xQueueCreate(1, sizeof(ir_learn_request_t));
+    assert(s_learn_queue);
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = rmt_rx_done_callback,
+    };
+    ESP_ERROR_CHECK(rmt_rx_register_event_callbacks(rx_channel, &cbs, s_rx_queue));
+    ESP_ERROR_CHECK(rmt_enable(rx_channel));
+
+    xTaskCreate(ir_rx_task, "ir_rx_task", 4096, NULL, 5, NULL);
+}
+
+static int ir_journal_flash_read(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    return esp_partition_read(ctx, offset, buf, len);
+}
+
+static int ir_journal_flash_write(void *ctx, uint32_t offset, const void *buf, size_t len)
+{
+    return esp_partition_write(ctx, offset, buf, len);
+}
+
+static int ir_journal_flash_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range(ctx, offset, len);
+}
+
+// 记下设备的当前状态，由日志任务延迟写入，不在MQTT任务中等flash
+static void ir_journal_mark(ir_device_t *device)
+{
+    if (!s_journal_task)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_journal_lock);
+    device->journal_state = device->state;
+    device->journal_dirty = true;
+    portEXIT_CRITICAL(&s_journal_lock);
+    xTaskNotifyGive(s_journal_task);
+}
+
+static void ir_journal_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // 状态不再变化IR_JOURNAL_DELAY_MS后才写，期间的修改合并成一条记录
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IR_JOURNAL_DELAY_MS)) != 0)
+        {
+        }
+        for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+        {
+            ir_device_t *device = &s_devices[i];
+            gree_state_t state;
+            bool dirty;
+            portENTER_CRITICAL(&s_journal_lock);
+            state = device->journal_state;
+            dirty = device->journal_dirty;
+            device->journal_dirty = false;
+            portEXIT_CRITICAL(&s_journal_lock);
+            if (!dirty)
+            {
+                continue;
+            }
+            ir_gree_journal_err_t err = ir_gree_journal_append(&s_journal, i, &state);
+            if (err != IR_GREE_JOURNAL_OK)
+            {
+                ESP_LOGE(TAG, "%s: journal append failed: %d", device->config->name, err);
+            }
+        }
+        ESP_LOGD(TAG, "journal: seq=%" PRIu32 " appends=%" PRIu32 " compactions=%" PRIu32,
+                 s_journal.seq, s_journal.appends, s_journal.compactions);
+    }
+}
+
+// 按device->state发送，调用者持有state_lock
+static void rmt_start(ir_device_t *device, const ir_gree_cmd_opts_t *opts, int64_t rx_us)
+{
+    ir_tx_cmd_t cmd = {
+        .repeat = opts->repeat,
+        .gap_ms = opts->gap_ms,
+        .rx_us = rx_us,
+        .parse_us = esp_timer_get_time(),
+    };
+    ir_gree_scan_code_t scan_code;
+    gree_state_pack(&device->state, &scan_code);
+    ir_gree_pack(&scan_code, &cmd.frame);
+    ir_journal_mark(device);
+    ir_sync_mark(device);
+    if (ir_tx_submit(device, &cmd, IR_TX_POLICY_REPLACE_OLDEST) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "%s: ir command dropped", device->config->name);
+    }
+}
+
+// 按名字发送预置帧，同时更新设备状态，之后的命令在此基础上修改
+static void rmt_start_preset(ir_device_t *device, const char *name, size_t name_len, int64_t rx_us)
+{
+    for (size_t i = 0; i < sizeof(s_presets) / sizeof(s_presets[0]); i++)
+    {
+        if (strlen(s_presets[i].name) != name_len || memcmp(s_presets[i].name, name, name_len) != 0)
+        {
+            continue;
+        }
+        ir_tx_cmd_t cmd = {
+            .frame = s_presets[i].frame,
+            .repeat = IR_TX_REPEAT_DEFAULT,
+            .gap_ms = IR_TX_GAP_DEFAULT_MS,
+            .rx_us = rx_us,
+            .parse_us = esp_timer_get_time(),
+        };
+        ir_gree_scan_code_t scan_code;
+        ir_gree_unpack(&cmd.frame, &scan_code);
+        xSemaphoreTake(device->state_lock, portMAX_DELAY);
+        gree_state_unpack(&scan_code, &device->state);
+        ir_journal_mark(device);
+        ir_sync_mark(device);
+        xSemaphoreGive(device->state_lock);
+        if (ir_tx_submit(device, &cmd, IR_TX_POLICY_REPLACE_OLDEST) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "%s: ir command dropped", device->config->name);
+        }
+        return;
+    }
+    ESP_LOGW(TAG, "%s: unknown preset %.*s", device->config->name, (int)name_len, name);
+}
+
+// 从日志恢复每台设备的状态，在init_ir之后调用
+void init_ir_journal(void)
+{
+    s_journal_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, IR_JOURNAL_PARTITION_SUBTYPE, IR_JOURNAL_PARTITION_LABEL);
+    if (!s_journal_partition)
+    {
+        ESP_LOGW(TAG, "partition %s not found, state will not be saved", IR_JOURNAL_PARTITION_LABEL);
+        return;
+    }
+    s_journal_flash = (ir_gree_flash_t){
+        .read = ir_journal_flash_read,
+        .write = ir_journal_flash_write,
+        .erase = ir_journal_flash_erase,
+        .ctx = (void *)s_journal_partition,
+        .sector_size = s_journal_partition->erase_size,
+    };
+    if (s_journal_partition->size < IR_GREE_JOURNAL_SECTOR_NUM * s_journal_partition->erase_size)
+    {
+        ESP_LOGW(TAG, "partition %s too small", IR_JOURNAL_PARTITION_LABEL);
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    ir_gree_journal_err_t err = ir_gree_journal_mount(&s_journal, &s_journal_flash);
+    ESP_LOGI(TAG, "journal restored in %" PRIi64 " us: seq=%" PRIu32, esp_timer_get_time() - start, s_journal.seq);
+    if (err != IR_GREE_JOURNAL_OK)
+    {
+        ESP_LOGE(TAG, "journal mount failed: %d", err);
+        return;
+    }
+
+    for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+    {
+        ir_device_t *device = &s_devices[i];
+        gree_state_t state;
+        if (!ir_gree_journal_get(&s_journal, i, &state))
+        {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: restored power=%d mode=%d temperature=%d fan=%d", device->config->name,
+                 state.power, state.mode, state.temperature, state.fan);
+        xSemaphoreTake(device->state_lock, portMAX_DELAY);
+        device->state = state;
+        ir_sync_mark(device);
+#if IR_JOURNAL_REASSERT
+        ir_gree_cmd_opts_t opts = {
+            .repeat = IR_TX_REPEAT_DEFAULT,
+            .gap_ms = IR_TX_GAP_DEFAULT_MS,
+        };
+        rmt_start(device, &opts, 0);
+#endif
+        xSemaphoreGive(device->state_lock);
+    }
+    xTaskCreate(ir_journal_task, "ir_journal_task", 3072, NULL, 1, &s_journal_task);
+}
+
+// 发送学习到的波形
+static void rmt_start_learned(ir_device_t *device, const char *name, size_t name_len, int64_t rx_us)
+{
+    ir_tx_cmd_t cmd = {
+        .repeat = IR_TX_REPEAT_DEFAULT,
+        .gap_ms = IR_TX_GAP_DEFAULT_MS,
+        .rx_us = rx_us,
+        .parse_us = esp_timer_get_time(),
+    };
+    if (name_len == 0 || name_len > IR_LEARN_NAME_MAX)
+    {
+        ESP_LOGW(TAG, "%s: invalid learned name", device->config->name);
+        return;
+    }
+    memcpy(cmd.learned, name, name_len);
+    if (ir_tx_submit(device, &cmd, IR_TX_POLICY_REPLACE_OLDEST) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "%s: ir command dropped", device->config->name);
+    }
+}
+
+// 请求接收任务学习下一次按键，新的请求覆盖还没开始的旧请求
+static void ir_learn_start(ir_device_t *device, const char *name, size_t name_len)
+{
+    ir_learn_request_t request = {
+        .device = device,
+        .request_us = esp_timer_get_time(),
+    };
+    if (name_len == 0 || name_len > IR_LEARN_NAME_MAX)
+    {
+        ESP_LOGW(TAG, "%s: invalid learned name", device->config->name);
+        return;
+    }
+    memcpy(request.name, name, name_len);
+    xQueueOverwrite(s_learn_queue, &request);
+    ESP_LOGI(TAG, "%s: learning %s, press the remote within %d s", device->config->name, request.name, IR_LEARN_TIMEOUT_MS / 1000);
+}
+
+// 把设备的所有定时命令格式化为JSON数组，返回的内存由调用者释放，调用者持有s_sched_lock
+static char *ir_sched_format(size_t device, size_t *len)
+{
+    size_t size = 2;
+    for (size_t i = 0; i < IR_SCHED_MAX; i++)
+    {
+        if (s_scheds[i].used && s_scheds[i].device == device)
+        {
+            size += s_scheds[i].sched.len + 1;
+        }
+    }
+    char *buf = malloc(size);
+    if (!buf)
+    {
+        return NULL;
+    }
+    size_t n = 0;
+    buf[n++] = '[';
+    for (size_t i = 0; i < IR_SCHED_MAX; i++)
+    {
+        const ir_sched_slot_t *slot = &s_scheds[i];
+        if (!slot->used || slot->device != device)
+        {
+            continue;
+        }
+        if (n > 1)
+        {
+            buf[n++] = ',';
+        }
+        memcpy(buf + n, slot->sched.cmd, slot->sched.len);
+        n += slot->sched.len;
+    }
+    buf[n++] = ']';
+    *len = n;
+    return buf;
+}
+
+// 发布设备的定时命令列表，调用者不能持有s_sched_lock：MQTT任务在回调中也要拿这个锁，
+// 持锁调用esp_mqtt_client_publish会与MQTT任务互相等待。锁内格式化，放锁以后发布，
+// 发布期间列表又被修改时重发，最后留下的retained消息总是最新的列表
+static void ir_sched_publish(ir_device_t *device)
+{
+    size_t index = device - s_devices;
+    bool changed;
+    do
+    {
+        if (!atomic_load_explicit(&s_mqtt_connected, memory_order_acquire))
+        {
+            return;
+        }
+        size_t len;
+        xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+        uint32_t gen = s_sched_gen[index];
+        char *buf = ir_sched_format(index, &len);
+        xSemaphoreGive(s_sched_lock);
+        if (!buf)
+        {
+            ESP_LOGW(TAG, "%s: no memory for schedule list", device->config->name);
+            return;
+        }
+
+        char topic[64];
+        snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "%s" MQTT_SCHEDULES_TOPIC_SUFFIX, device->config->name);
+        esp_mqtt_client_publish(s_mqtt_client, topic, buf, len, 1, 1);
+        free(buf);
+
+        xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+        changed = s_sched_gen[index] != gen;
+        xSemaphoreGive(s_sched_lock);
+    } while (changed);
+}
+
+static void ir_sched_publish_all(void)
+{
+    for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+    {
+        ir_sched_publish(&s_devices[i]);
+    }
+}
+
+// 按now计算下一次执行的时间，挂到时间轮上，调用者持有s_sched_lock
+static void ir_sched_arm(size_t index, time_t now)
+{
+    if (!s_sched_running)
+    {
+        return;
+    }
+    time_t next = ir_gree_sched_next(&s_scheds[index].sched, now);
+    if (next == (time_t)-1)
+    {
+        ir_gree_wheel_del(&s_sched_wheel, index);
+        return;
+    }
+    ir_gree_wheel_add(&s_sched_wheel, index, (uint32_t)next);
+}
+
+static esp_err_t ir_sched_save(const ir_sched_slot_t *slot)
+{
+    uint8_t blob[1 + IR_GREE_SCHED_CMD_MAX];
+    nvs_handle_t nvs_handle;
+    esp_err_t ret = nvs_open(IR_SCHED_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    blob[0] = slot->device;
+    memcpy(blob + 1, slot->sched.cmd, slot->sched.len);
+    ret = nvs_set_blob(nvs_handle, slot->sched.id, blob, 1 + slot->sched.len);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return ret;
+}
+
+static void ir_sched_erase(const char *id)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(IR_SCHED_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_erase_key(nvs_handle, id) == ESP_OK)
+    {
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
+// 删除第index条，调用者持有s_sched_lock
+static void ir_sched_remove(size_t index)
+{
+    ir_sched_slot_t *slot = &s_scheds[index];
+    ir_gree_wheel_del(&s_sched_wheel, index);
+    ir_sched_erase(slot->sched.id);
+    slot->used = false;
+    s_sched_gen[slot->device]++;
+}
+
+static int ir_sched_find(const char *id, size_t id_len)
+{
+    for (size_t i = 0; i < IR_SCHED_MAX; i++)
+    {
+        if (s_scheds[i].used && strlen(s_scheds[i].sched.id) == id_len && memcmp(s_scheds[i].sched.id, id, id_len) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 时间轮的到期回调，在定时任务中持有s_sched_lock调用，与MQTT命令走同样的发送流程。
+// ctx为按设备序号的bool数组，列表有变化的设备置true，由定时任务放锁以后发布
+static void ir_sched_fire(void *ctx, uint16_t index)
+{
+    bool *changed = ctx;
+    ir_sched_slot_t *slot = &s_scheds[index];
+    ir_device_t *device = &s_devices[slot->device];
+    ir_gree_cmd_opts_t opts = {
+        .repeat = IR_TX_REPEAT_DEFAULT,
+        .gap_ms = IR_TX_GAP_DEFAULT_MS,
+    };
+
+    xSemaphoreTake(device->state_lock, portMAX_DELAY);
+    ir_gree_cmd_err_t err = ir_gree_cmd_parse(slot->sched.cmd, slot->sched.len, &device->state, &opts);
+    if (err == IR_GREE_CMD_OK)
+    {
+        rmt_start(device, &opts, 0);
+    }
+    xSemaphoreGive(device->state_lock);
+    ESP_LOGI(TAG, "%s: schedule %s fired: %d", device->config->name, slot->sched.id, err);
+
+    if (slot->sched.once)
+    {
+        ir_sched_remove(index);
+        changed[slot->device] = true;
+    }
+    else
+    {
+        ir_sched_arm(index, s_sched_wheel.now);
+    }
+}
+
+// 添加或者替换同名的定时命令
+static void ir_sched_add(ir_device_t *device, const char *data, size_t len)
+{
+    ir_sched_slot_t slot = {
+        .used = true,
+        .device = device - s_devices,
+    };
+    ir_gree_sched_err_t err = ir_gree_sched_parse(data, len, &slot.sched);
+    if (err != IR_GREE_SCHED_OK)
+    {
+        ESP_LOGW(TAG, "%s: invalid schedule: %d", device->config->name, err);
+        return;
+    }
+
+    xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+    int index = ir_sched_find(slot.sched.id, strlen(slot.sched.id));
+    // 同名的属于别的设备时，那台设备的列表也要更新
+    ir_device_t *replaced = index >= 0 ? &s_devices[s_scheds[index].device] : NULL;
+    for (size_t i = 0; i < IR_SCHED_MAX && index < 0; i++)
+    {
+        if (!s_scheds[i].used)
+        {
+            index = i;
+        }
+    }
+    if (index < 0)
+    {
+        xSemaphoreGive(s_sched_lock);
+        ESP_LOGW(TAG, "%s: too many schedules, max %d", device->config->name, IR_SCHED_MAX);
+        return;
+    }
+    s_scheds[index] = slot;
+    s_sched_gen[slot.device]++;
+    if (replaced && replaced != device)
+    {
+        s_sched_gen[replaced - s_devices]++;
+    }
+    esp_err_t ret = ir_sched_save(&slot);
+    ir_sched_arm(index, time(NULL));
+    xSemaphoreGive(s_sched_lock);
+    ir_sched_publish(device);
+    if (replaced && replaced != device)
+    {
+        ir_sched_publish(replaced);
+    }
+    ESP_LOGI(TAG, "%s: schedule %s at %02d:%02d days=%02x%s, save: %s", device->config->name, slot.sched.id,
+             slot.sched.minute / 60, slot.sched.minute % 60, slot.sched.days, slot.sched.once ? " once" : "", esp_err_to_name(ret));
+}
+
+static void ir_sched_del(ir_device_t *device, const char *id, size_t id_len)
 {
-    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
-    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
-    rmt_encode_state_t state = RMT_ENCODING_RESET;
-    size_t encoded_symbols = 0;
-    ir_gree_scan_code_t *scan_code = (ir_gree_scan_code_t *)primary_data;
-    rmt_encoder_handle_t copy_encoder = gree_encoder->copy_encoder;
-    rmt_encoder_handle_t bytes_encoder = gree_encoder->bytes_encoder;
+    xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+    int index = ir_sched_find(id, id_len);
+    if (index >= 0 && &s_devices[s_scheds[index].device] == device)
+    {
+        ir_sched_remove(index);
+    }
+    else
+    {
+        index = -1;
+    }
+    xSemaphoreGive(s_sched_lock);
+    if (index >= 0)
+    {
+        ir_sched_publish(device);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "%s: unknown schedule %.*s", device->config->name, (int)id_len, id);
+    }
+}
 
-    switch (gree_encoder->state)
-    {
-    // 引导码
-    case 0:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->gree_leading_symbol,
-                                                sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 1;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
-        {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
-        }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 编码数据段1，调用bytes_encoder
-    case 1:
-        encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, &scan_code->data1, sizeof(uint32_t), &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 2;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
-        {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
-        }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 补充数据段1的后三位，调用copy_encoder,这个是数组，大小要乘以3
-    case 2:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->last_3_bits_symbol,
-                                                3 * sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 3;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
-        {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
-        }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 短连接码
-    case 3:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->short_connecting_symbol,
-                                                sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 4;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
-        {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
-        }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 编码数据段2，调用bytes_encoder
-    case 4:
-        encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, &scan_code->data2, sizeof(uint32_t), &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 5;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
-        {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
-        }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 长连接码, 数组 2倍大小
-    case 5:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->long_connecting_symbol,
-                                                2 * sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 6;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
-        {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
-        }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 引导码，注意数据段3和4，不是1和2的重复，有不同内容
-    case 6:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->gree_leading_symbol,
-                                                sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        {
-            gree_encoder->state = 7;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
+// 时钟第一次可用或者跳变超出容忍范围时，从now开始重新计算所有定时命令，调用者持有s_sched_lock
+static void ir_sched_rearm_all(time_t now)
+{
+    ir_gree_wheel_init(&s_sched_wheel, s_sched_nodes, IR_SCHED_MAX, (uint32_t)now);
+    s_sched_running = true;
+    for (size_t i = 0; i < IR_SCHED_MAX; i++)
+    {
+        if (s_scheds[i].used)
         {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
+            ir_sched_arm(i, now);
         }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 编码数据段3，调用bytes_encoder
-    case 7:
-        encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, &scan_code->data3, sizeof(uint32_t), &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
+    }
+}
+
+static void ir_sched_task(void *arg)
+{
+    while (1)
+    {
+        // 对齐到整秒，定时命令在设定的那一秒执行
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        vTaskDelay(pdMS_TO_TICKS(1000 - tv.tv_usec / 1000) + 1);
+
+        time_t now = time(NULL);
+        if (now < IR_SCHED_TIME_VALID)
         {
-            gree_encoder->state = 8;
+            continue;
         }
-        if (session_state & RMT_ENCODING_MEM_FULL)
+        bool changed[IR_DEVICE_NUM] = {0};
+        xSemaphoreTake(s_sched_lock, portMAX_DELAY);
+        int32_t drift = (int32_t)((uint32_t)now - s_sched_wheel.now);
+        if (!s_sched_running || drift > IR_SCHED_DRIFT_MAX_S || drift < -IR_SCHED_DRIFT_MAX_S)
         {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
+            if (s_sched_running)
+            {
+                ESP_LOGW(TAG, "clock jumped %" PRIi32 " s, rescheduling", drift);
+            }
+            ir_sched_rearm_all(now);
+            char buf[32];
+            struct tm tm;
+            localtime_r(&now, &tm);
+            strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+            ESP_LOGI(TAG, "schedules running, local time %s", buf);
         }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 补充数据段3的后三位，调用copy_encoder,这个是数组，大小要乘以3
-    case 8:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->last_3_bits_symbol,
-                                                3 * sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
+        else if (drift > 0)
         {
-            gree_encoder->state = 9;
+            // 前进时逐秒处理，小幅向前跳时跳过的命令也会执行
+            ir_gree_wheel_advance(&s_sched_wheel, (uint32_t)now, ir_sched_fire, changed);
         }
-        if (session_state & RMT_ENCODING_MEM_FULL)
+        xSemaphoreGive(s_sched_lock);
+        for (size_t i = 0; i < IR_DEVICE_NUM; i++)
         {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
+            if (changed[i])
+            {
+                ir_sched_publish(&s_devices[i]);
+            }
         }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 短连接码
-    case 9:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->short_connecting_symbol,
-                                                sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
+    }
+}
+
+// 从NVS加载定时命令并启动对时，在init_ir之后、WiFi启动之前调用，MQTT的处理函数都可以直接用s_sched_lock
+void init_ir_sched(void)
+{
+    s_sched_lock = xSemaphoreCreateMutex();
+    assert(s_sched_lock);
+
+    size_t count = 0;
+    nvs_handle_t nvs_handle;
+    nvs_iterator_t it = NULL;
+    if (nvs_open(IR_SCHED_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK)
+    {
+        esp_err_t res = nvs_entry_find(NVS_DEFAULT_PART_NAME, IR_SCHED_NVS_NAMESPACE, NVS_TYPE_BLOB, &it);
+        while (res == ESP_OK && count < IR_SCHED_MAX)
         {
-            gree_encoder->state = 10;
+            nvs_entry_info_t info;
+            uint8_t blob[1 + IR_GREE_SCHED_CMD_MAX];
+            size_t len = sizeof(blob);
+            nvs_entry_info(it, &info);
+            ir_sched_slot_t *slot = &s_scheds[count];
+            if (nvs_get_blob(nvs_handle, info.key, blob, &len) == ESP_OK && len > 1 && blob[0] < IR_DEVICE_NUM &&
+                ir_gree_sched_parse((const char *)blob + 1, len - 1, &slot->sched) == IR_GREE_SCHED_OK)
+            {
+                slot->used = true;
+                slot->device = blob[0];
+                count++;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "schedule %s invalid, ignored", info.key);
+            }
+            res = nvs_entry_next(&it);
         }
-        if (session_state & RMT_ENCODING_MEM_FULL)
+        nvs_release_iterator(it);
+        nvs_close(nvs_handle);
+    }
+    ESP_LOGI(TAG, "%d schedules loaded", (int)count);
+
+    setenv("TZ", IR_SCHED_TZ, 1);
+    tzset();
+    // 平滑模式下小的偏差用adjtime慢慢调，不会让时间轮跳秒
+    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, IR_SCHED_NTP_SERVER);
+    esp_sntp_init();
+
+    xTaskCreate(ir_sched_task, "ir_sched_task", 4096, NULL, 4, NULL);
+}
+
+// 根据topic找到设备：gree/<name><suffix>
+static ir_device_t *mqtt_find_device(const char *topic, int topic_len, const char *suffix)
+{
+    const int prefix_len = strlen(MQTT_TOPIC_PREFIX);
+    const int suffix_len = strlen(suffix);
+    if (topic_len <= prefix_len + suffix_len ||
+        memcmp(topic, MQTT_TOPIC_PREFIX, prefix_len) != 0 ||
+        memcmp(topic + topic_len - suffix_len, suffix, suffix_len) != 0)
+    {
+        return NULL;
+    }
+
+    const char *name = topic + prefix_len;
+    int name_len = topic_len - prefix_len - suffix_len;
+    for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+    {
+        if (strlen(s_devices[i].config->name) == (size_t)name_len && memcmp(s_devices[i].config->name, name, name_len) == 0)
         {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
+            return &s_devices[i];
         }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 编码数据段4，调用bytes_encoder
-    case 10:
-        encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, &scan_code->data4, sizeof(uint32_t), &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
+    }
+    return NULL;
+}
+
+static void log_error_if_nonzero(const char *message, int error_code)
+{
+    if (error_code != 0)
+    {
+        ESP_LOGE(TAG, "Last error %s: 0x%x", message, error_code);
+    }
+}
+
+static void mqtt_handle_data(esp_mqtt_event_handle_t event)
+{
+    // 只有第一块带topic
+    if (event->current_data_offset == 0)
+    {
+        s_mqtt_cmd_rx_us = esp_timer_get_time();
+        s_mqtt_cmd_device = NULL;
+        for (int kind = 0; kind < MQTT_MSG_NUM && !s_mqtt_cmd_device; kind++)
         {
-            gree_encoder->state = 11;
+            s_mqtt_cmd_device = mqtt_find_device(event->topic, event->topic_len, s_mqtt_msg_suffixes[kind]);
+            s_mqtt_cmd_kind = kind;
         }
-        if (session_state & RMT_ENCODING_MEM_FULL)
+    }
+    ir_device_t *device = s_mqtt_cmd_device;
+    if (!device)
+    {
+        return;
+    }
+
+    const char *data = event->data;
+    if (event->data_len != event->total_data_len)
+    {
+        if (event->total_data_len > MQTT_CMD_MAX_LEN)
         {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
+            ESP_LOGW(TAG, "command too long: %d", event->total_data_len);
+            s_mqtt_cmd_device = NULL;
+            return;
         }
-        [[fallthrough]];
-    // fall-through 注意这里没break
-    // 结束码
-    case 11:
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel,
-                                                &gree_encoder->gree_ending_symbol,
-                                                sizeof(rmt_symbol_word_t),
-                                                &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE)
-        { // 这里跟前面的都不一样了
-            gree_encoder->state = RMT_ENCODING_RESET;
-            state |= RMT_ENCODING_COMPLETE;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL)
+        memcpy(s_mqtt_cmd_buf + event->current_data_offset, event->data, event->data_len);
+        if (event->current_data_offset + event->data_len < event->total_data_len)
         {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out;
+            return;
         }
+        data = s_mqtt_cmd_buf;
+    }
+
+    switch (s_mqtt_cmd_kind)
+    {
+    case MQTT_MSG_PRESET:
+        rmt_start_preset(device, data, event->total_data_len, s_mqtt_cmd_rx_us);
+        return;
+    case MQTT_MSG_LEARN:
+        ir_learn_start(device, data, event->total_data_len);
+        return;
+    case MQTT_MSG_REPLAY:
+        rmt_start_learned(device, data, event->total_data_len, s_mqtt_cmd_rx_us);
+        return;
+    case MQTT_MSG_SCHED_ADD:
+        ir_sched_add(device, data, event->total_data_len);
+        return;
+    case MQTT_MSG_SCHED_DEL:
+        ir_sched_del(device, data, event->total_data_len);
+        return;
+    default:
+        break;
     }
 
-out:
-    *ret_stat = state;
-    return encoded_symbols;
+    ir_gree_cmd_opts_t opts = {
+        .repeat = IR_TX_REPEAT_DEFAULT,
+        .gap_ms = IR_TX_GAP_DEFAULT_MS,
+    };
+    xSemaphoreTake(device->state_lock, portMAX_DELAY);
+    ir_gree_cmd_err_t err = ir_gree_cmd_parse(data, event->total_data_len, &device->state, &opts);
+    if (err == IR_GREE_CMD_OK)
+    {
+        rmt_start(device, &opts, s_mqtt_cmd_rx_us);
+    }
+    xSemaphoreGive(device->state_lock);
+    if (err != IR_GREE_CMD_OK)
+    {
+        ESP_LOGW(TAG, "%s: invalid command: %d", device->config->name, err);
+    }
 }
 
-static esp_err_t rmt_del_ir_gree_encoder(rmt_encoder_t *encoder)
+// 统计任务中每台设备最近的延迟样本
+typedef struct
 {
-    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
-    rmt_del_encoder(gree_encoder->copy_encoder);
-    rmt_del_encoder(gree_encoder->bytes_encoder);
-    free(gree_encoder);
-    return ESP_OK;
-}
+    uint32_t us[IR_LATENCY_STAGE_NUM][IR_LATENCY_WINDOW];
+    size_t count;
+    size_t next;
+} ir_latency_window_t;
 
-static esp_err_t rmt_ir_gree_encoder_reset(rmt_encoder_t *encoder)
+static int ir_latency_cmp(const void *a, const void *b)
 {
-    rmt_ir_gree_encoder_t *gree_encoder = __containerof(encoder, rmt_ir_gree_encoder_t, base);
-    rmt_encoder_reset(gree_encoder->copy_encoder);
-    rmt_encoder_reset(gree_encoder->bytes_encoder);
-    gree_encoder->state = RMT_ENCODING_RESET;
-    return ESP_OK;
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
 }
 
-esp_err_t rmt_new_ir_gree_encoder(const ir_gree_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+// 输出一个阶段的p50/p99/max和分桶计数，返回写入的字节数
+static int ir_latency_format_stage(char *buf, size_t size, const ir_latency_window_t *window, int stage)
 {
-    esp_err_t ret = ESP_OK;
-    ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
-    rmt_ir_gree_encoder_t *gree_encoder = NULL;
-
-    gree_encoder = calloc(1, sizeof(rmt_ir_gree_encoder_t));
-    ESP_GOTO_ON_FALSE(gree_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for ir nec encoder");
-    gree_encoder->base.encode = rmt_encode_ir_gree;
-    gree_encoder->base.del = rmt_del_ir_gree_encoder;
-    gree_encoder->base.reset = rmt_ir_gree_encoder_reset;
-
-    rmt_copy_encoder_config_t copy_encoder_config = {};
-    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &gree_encoder->copy_encoder), err, TAG, "create copy encoder failed");
-
-    // construct the leading code and ending code with RMT symbol format
-    gree_encoder->gree_leading_symbol = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = LEADING_CODE_DURATION_0,
-        .level1 = 0,
-        .duration1 = LEADING_CODE_DURATION_1,
-    };
-
-    gree_encoder->gree_ending_symbol = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = END_CODE_DURATION_0,
-        .level1 = 0,
-        .duration1 = END_CODE_DURATION_1,
-    };
-    gree_encoder->short_connecting_symbol = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = SHORT_CONNCECT_CODE_DURATION_0,
-        .level1 = 0,
-        .duration1 = SHORT_CONNCECT_CODE_DURATION_1,
-    };
-    // 15bit最大表示为32767，所以要用两段表示
-    // 660us发射 + 20000us空闲 + 10000us空闲 + 10000us空闲
-    gree_encoder->long_connecting_symbol[0] = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = LONG_CONNCECT_CODE_DURATION_0,
-        .level1 = 0,
-        .duration1 = LONG_CONNCECT_CODE_DURATION_1,
-    };
-    gree_encoder->long_connecting_symbol[1] = (rmt_symbol_word_t){
-        .level0 = 0,
-        .duration0 = LONG_CONNCECT_CODE_DURATION_3,
-        .level1 = 0,
-        .duration1 = LONG_CONNCECT_CODE_DURATION_3,
-    };
-    gree_encoder->last_3_bits_symbol[0] = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = PAYLOAD_ZERO_DURATION_0,
-        .level1 = 0,
-        .duration1 = PAYLOAD_ZERO_DURATION_1,
-    };
-    gree_encoder->last_3_bits_symbol[1] = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = PAYLOAD_ONE_DURATION_0,
-        .level1 = 0,
-        .duration1 = PAYLOAD_ONE_DURATION_1,
-    };
-    gree_encoder->last_3_bits_symbol[2] = (rmt_symbol_word_t){
-        .level0 = 1,
-        .duration0 = PAYLOAD_ZERO_DURATION_0,
-        .level1 = 0,
-        .duration1 = PAYLOAD_ZERO_DURATION_1,
-    };
+    uint32_t sorted[IR_LATENCY_WINDOW];
+    uint16_t buckets[IR_LATENCY_BUCKETS] = {0};
+    size_t n = window->count;
 
-    rmt_bytes_encoder_config_t bytes_encoder_config = {
-        .bit0 = {
-            .level0 = 1,
-            .duration0 = PAYLOAD_ZERO_DURATION_0,
-            .level1 = 0,
-            .duration1 = PAYLOAD_ZERO_DURATION_1,
-        },
-        .bit1 = {
-            .level0 = 1,
-            .duration0 = PAYLOAD_ONE_DURATION_0,
-            .level1 = 0,
-            .duration1 = PAYLOAD_ONE_DURATION_1,
-        },
-    };
-    ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, &gree_encoder->bytes_encoder), err, TAG, "create bytes encoder failed");
+    memcpy(sorted, window->us[stage], n * sizeof(uint32_t));
+    qsort(sorted, n, sizeof(uint32_t), ir_latency_cmp);
+    for (size_t i = 0; i < n; i++)
+    {
+        // 第b桶为[2^(b-1), 2^b)us
+        int b = sorted[i] ? 32 - __builtin_clz(sorted[i]) : 0;
+        buckets[b < IR_LATENCY_BUCKETS ? b : IR_LATENCY_BUCKETS - 1]++;
+    }
 
-    *ret_encoder = &gree_encoder->base;
-    return ret;
-err:
-    return ret;
+    int len = snprintf(buf, size, "\"%s\":{\"p50\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 ",\"hist\":[",
+                       s_latency_stage_names[stage], sorted[(n - 1) * 50 / 100], sorted[(n - 1) * 99 / 100], sorted[n - 1]);
+    for (int b = 0; b < IR_LATENCY_BUCKETS && len < (int)size; b++)
+    {
+        len += snprintf(buf + len, size - len, b ? ",%u" : "%u", buckets[b]);
+    }
+    if (len < (int)size)
+    {
+        len += snprintf(buf + len, size - len, "]}");
+    }
+    return len;
 }
 
-void init_ir(void)
+static void ir_latency_publish(ir_device_t *device, const ir_latency_window_t *window)
 {
-    rmt_tx_channel_config_t tx_channel_cfg = {
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        .resolution_hz = IR_RESOLUTION_HZ,
-        .mem_block_symbols = 64,
-        .trans_queue_depth = 4,
-        .gpio_num = IR_TX_GPIO_NUM,
-    };
-    ESP_ERROR_CHECK(rmt_new_tx_channel(&tx_channel_cfg, &tx_channel));
-
-    rmt_carrier_config_t carrier_cfg = {
-        .duty_cycle = 0.33,
-        .frequency_hz = 38000, // 38KHz
-    };
-    ESP_ERROR_CHECK(rmt_apply_carrier(tx_channel, &carrier_cfg));
-
-    ir_gree_encoder_config_t encoder_cfg = {
-        .resolution = IR_RESOLUTION_HZ,
-    };
+    static char payload[1024];
+    char topic[64];
+    int len = snprintf(payload, sizeof(payload), "{\"samples\":%u,\"dropped\":%" PRIu32 ",\"stages\":{",
+                       (unsigned)window->count, device->latency.dropped);
 
-    ESP_ERROR_CHECK(rmt_new_ir_gree_encoder(&encoder_cfg, &gree_encoder));
+    for (int stage = 0; stage < IR_LATENCY_STAGE_NUM && len < (int)sizeof(payload); stage++)
+    {
+        if (stage)
+        {
+            payload[len++] = ',';
+        }
+        len += ir_latency_format_stage(payload + len, sizeof(payload) - len, window, stage);
+    }
+    if (len + 2 >= (int)sizeof(payload))
+    {
+        ESP_LOGW(TAG, "%s: latency stats too long", device->config->name);
+        return;
+    }
+    len += snprintf(payload + len, sizeof(payload) - len, "}}");
 
-    ESP_ERROR_CHECK(rmt_enable(tx_channel));
+    snprintf(topic, sizeof(topic), MQTT_TOPIC_PREFIX "%s" MQTT_STATS_TOPIC_SUFFIX, device->config->name);
+    esp_mqtt_client_publish(s_mqtt_client, topic, payload, len, 0, 0);
 }
 
-static void rmt_start()
+// 定期取出各设备的延迟样本，按最近IR_LATENCY_WINDOW条发布分位数
+static void ir_stats_task(void *arg)
 {
-    rmt_transmit_config_t transmit_config = {
-        .loop_count = 0,
-    };
-    const ir_gree_scan_code_t scan_code = {
-        .data1 = 0xaaaaaaaa,
-        .data2 = 0xaaaaaaaa,
-        .data3 = 0xaaaaaaaa,
-        .data4 = 0xaaaaaaaa,
-    };
-    ESP_ERROR_CHECK(rmt_transmit(tx_channel, gree_encoder, &scan_code, sizeof(scan_code), &transmit_config));
-}
+    static ir_latency_window_t windows[IR_DEVICE_NUM];
+    ir_latency_sample_t sample;
 
-static void log_error_if_nonzero(const char *message, int error_code)
-{
-    if (error_code != 0)
+    while (1)
     {
-        ESP_LOGE(TAG, "Last error %s: 0x%x", message, error_code);
+        vTaskDelay(pdMS_TO_TICKS(IR_STATS_PERIOD_MS));
+        for (size_t i = 0; i < IR_DEVICE_NUM; i++)
+        {
+            ir_latency_window_t *window = &windows[i];
+            while (ir_latency_pop(&s_devices[i].latency, &sample))
+            {
+                for (int stage = 0; stage < IR_LATENCY_STAGE_NUM; stage++)
+                {
+                    window->us[stage][window->next] = sample.us[stage];
+                }
+                window->next = (window->next + 1) % IR_LATENCY_WINDOW;
+                if (window->count < IR_LATENCY_WINDOW)
+                {
+                    window->count++;
+                }
+            }
+            if (window->count && atomic_load_explicit(&s_mqtt_connected, memory_order_acquire))
+            {
+                ir_latency_publish(&s_devices[i], window);
+            }
+        }
     }
 }
 
@@ -488,6 +2060,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+        atomic_store_explicit(&s_mqtt_connected, true, memory_order_release);
+        if (s_ready_us == 0)
+        {
+            s_ready_us = esp_timer_get_time();
+            ESP_LOGI(TAG, "boot to ready: %" PRIi64 " ms (fast connect: %s)", s_ready_us / 1000, s_wifi_fast_active ? "yes" : "no");
+        }
         msg_id = esp_mqtt_client_publish(client, "topic/test", "data_3", 0, 1, 0);
         ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
 
@@ -500,9 +2078,35 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         msg_id = esp_mqtt_client_subscribe(client, "topic/test", 1);
         ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
 
+        msg_id = esp_mqtt_client_subscribe(client, MQTT_TOPIC_PREFIX "+" MQTT_CMD_TOPIC_SUFFIX, 1);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+        msg_id = esp_mqtt_client_subscribe(client, MQTT_TOPIC_PREFIX "+" MQTT_PRESET_TOPIC_SUFFIX, 1);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+        msg_id = esp_mqtt_client_subscribe(client, MQTT_TOPIC_PREFIX "+" MQTT_LEARN_TOPIC_SUFFIX, 1);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+        msg_id = esp_mqtt_client_subscribe(client, MQTT_TOPIC_PREFIX "+" MQTT_REPLAY_TOPIC_SUFFIX, 1);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+        msg_id = esp_mqtt_client_subscribe(client, MQTT_TOPIC_PREFIX "+" MQTT_SCHED_ADD_TOPIC_SUFFIX, 1);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+        msg_id = esp_mqtt_client_subscribe(client, MQTT_TOPIC_PREFIX "+" MQTT_SCHED_DEL_TOPIC_SUFFIX, 1);
+        ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
+
+        ir_sched_publish_all();
+
+        // 发布断线期间的状态变化，第一次连上时发布完整状态
+        if (s_sync_task)
+        {
+            xTaskNotifyGive(s_sync_task);
+        }
         break;
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+        atomic_store_explicit(&s_mqtt_connected, false, memory_order_release);
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
@@ -517,13 +2121,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
         break;
     case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "MQTT_EVENT_DATA");
-        printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
-        printf("DATA=%.*s\r\n", event->data_len, event->data);
-        rmt_start();
+        ESP_LOGD(TAG, "MQTT_EVENT_DATA");
+        mqtt_handle_data(event);
         break;
     case MQTT_EVENT_ERROR:
         ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
+        // 服务器和传输层的错误与WiFi缓存无关，MQTT客户端自己重连，IP冲突由ARP探测发现
         if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT)
         {
             log_error_if_nonzero("reported from esp-tls", event->error_handle->esp_tls_last_esp_err);
@@ -540,12 +2143,19 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
 static void mqtt_app_start(void)
 {
+    // 重新拿到IP时会再次调用，客户端自己会重连，不用再创建
+    if (s_mqtt_client)
+    {
+        return;
+    }
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = "mqtt://192.168.50.229",
     };
     esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     ESP_ERROR_CHECK(esp_mqtt_client_start(client));
+    s_mqtt_client = client;
+    xTaskCreate(ir_stats_task, "ir_stats_task", 4096, NULL, 2, NULL);
 }
 
 static void smartconfig_task(void *parm)
@@ -565,6 +2175,159 @@ static void smartconfig_task(void *parm)
     }
 }
 
+static void wifi_fast_load(nvs_handle_t nvs_handle)
+{
+    size_t len = sizeof(s_wifi_fast);
+    s_wifi_fast_valid = WIFI_FAST_CONNECT &&
+                        nvs_get_blob(nvs_handle, WIFI_FAST_NVS_KEY, &s_wifi_fast, &len) == ESP_OK &&
+                        len == sizeof(s_wifi_fast) && s_wifi_fast.channel != 0;
+}
+
+// 只在AP或IP变化时写flash
+static void wifi_fast_save(const esp_netif_ip_info_t *ip_info)
+{
+    wifi_ap_record_t ap;
+    if (!WIFI_FAST_CONNECT || esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+    {
+        return;
+    }
+    wifi_fast_config_t fast = {
+        .channel = ap.primary,
+        .ip_info = *ip_info,
+    };
+    memcpy(fast.bssid, ap.bssid, sizeof(fast.bssid));
+    if (s_wifi_fast_valid && memcmp(&fast, &s_wifi_fast, sizeof(fast)) == 0)
+    {
+        return;
+    }
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READWRITE, &nvs_handle) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_set_blob(nvs_handle, WIFI_FAST_NVS_KEY, &fast, sizeof(fast)) == ESP_OK && nvs_commit(nvs_handle) == ESP_OK)
+    {
+        s_wifi_fast = fast;
+        s_wifi_fast_valid = true;
+    }
+    nvs_close(nvs_handle);
+}
+
+// 用缓存的信道和BSSID连接，IP在连上AP后设置
+static void wifi_fast_apply(void)
+{
+    wifi_config_t wifi_config;
+    ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
+    wifi_config.sta.channel = s_wifi_fast.channel;
+    wifi_config.sta.bssid_set = true;
+    memcpy(wifi_config.sta.bssid, s_wifi_fast.bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(s_sta_netif));
+    s_wifi_fast_active = true;
+}
+
+// 缓存不能用：清掉缓存，改回全信道扫描和DHCP
+static void wifi_fast_fallback(bool reconnect)
+{
+    ESP_LOGW(TAG, "fast connect failed, fall back to full scan");
+    s_wifi_fast_active = false;
+    s_wifi_fast_valid = false;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READWRITE, &nvs_handle) == ESP_OK)
+    {
+        nvs_erase_key(nvs_handle, WIFI_FAST_NVS_KEY);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+
+    wifi_config_t wifi_config;
+    ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
+    wifi_config.sta.channel = 0;
+    wifi_config.sta.bssid_set = false;
+    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    esp_netif_dhcpc_start(s_sta_netif);
+    if (reconnect)
+    {
+        esp_wifi_disconnect();
+    }
+}
+
+// 这些原因说明缓存的BSSID和信道连不上：找不到AP（换了信道或路由器）、认证或关联失败，
+// 其他原因（信号差、AP踢掉、信标超时）按普通断线退避重连，保留缓存
+static bool wifi_fast_rejected(uint8_t reason)
+{
+    switch (reason)
+    {
+    case WIFI_REASON_NO_AP_FOUND:
+    case WIFI_REASON_AUTH_EXPIRE:
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_ASSOC_FAIL:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 在TCP/IP任务中执行，发ARP请求问缓存的IP在谁那里
+static esp_err_t wifi_fast_probe_send(void *ctx)
+{
+    struct netif *netif = esp_netif_get_netif_impl(s_sta_netif);
+    etharp_request(netif, (const ip4_addr_t *)&s_wifi_fast.ip_info.ip);
+    return ESP_OK;
+}
+
+// 在TCP/IP任务中执行，有别的设备应答时ARP表中会有这个IP
+static esp_err_t wifi_fast_probe_check(void *ctx)
+{
+    struct netif *netif = esp_netif_get_netif_impl(s_sta_netif);
+    struct eth_addr *eth;
+    const ip4_addr_t *ip;
+    bool *conflict = ctx;
+    *conflict = etharp_find_addr(netif, (const ip4_addr_t *)&s_wifi_fast.ip_info.ip, &eth, &ip) >= 0;
+    return ESP_OK;
+}
+
+// DHCP拿到的IP由lwIP的ARP检查处理，这里只检查缓存的静态IP
+static void wifi_probe_timer_callback(void *arg)
+{
+    bool conflict = false;
+    if (!s_wifi_fast_active)
+    {
+        return;
+    }
+    esp_netif_tcpip_exec(wifi_fast_probe_check, &conflict);
+    if (conflict)
+    {
+        ESP_LOGW(TAG, "cached ip " IPSTR " is used by another host", IP2STR(&s_wifi_fast.ip_info.ip));
+        wifi_fast_fallback(true);
+    }
+}
+
+static void wifi_retry_timer_callback(void *arg)
+{
+    esp_wifi_connect();
+}
+
+// 断线后按指数退避重连，不再深度睡眠，红外接收和发送保持可用
+static void wifi_schedule_retry(void)
+{
+    int shift = s_retry_num < 16 ? s_retry_num : 16;
+    uint32_t delay_ms = WIFI_BACKOFF_MIN_MS << shift;
+    if (delay_ms > WIFI_BACKOFF_MAX_MS)
+    {
+        delay_ms = WIFI_BACKOFF_MAX_MS;
+    }
+    s_retry_num++;
+    ESP_LOGI(TAG, "retry to connect to the AP in %" PRIu32 " ms", delay_ms);
+    esp_timer_stop(s_wifi_retry_timer);
+    ESP_ERROR_CHECK(esp_timer_start_once(s_wifi_retry_timer, (uint64_t)delay_ms * 1000));
+}
+
 static void event_handler(void *event_handler_arg,
                           esp_event_base_t event_base,
                           int32_t event_id,
@@ -575,6 +2338,10 @@ static void event_handler(void *event_handler_arg,
         EventBits_t uxBits = xEventGroupGetBits(s_wifi_event_group);
         if (uxBits & NETWORK_CONFIGED_BIT)
         {
+            if (s_wifi_fast_valid)
+            {
+                wifi_fast_apply();
+            }
             ESP_ERROR_CHECK(esp_wifi_connect());
         }
         else
@@ -582,28 +2349,37 @@ static void event_handler(void *event_handler_arg,
             xTaskCreate(smartconfig_task, "smartconfig_task", 4096, NULL, 3, NULL);
         }
     }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
     {
-        if (s_retry_num < 10)
+        // 静态IP在连上AP后设置，和IDF的static_ip示例一样
+        if (s_wifi_fast_active)
         {
-            ESP_ERROR_CHECK(esp_wifi_connect());
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
+            ESP_ERROR_CHECK(esp_netif_set_ip_info(s_sta_netif, &s_wifi_fast.ip_info));
+            esp_netif_tcpip_exec(wifi_fast_probe_send, NULL);
+            esp_timer_stop(s_wifi_probe_timer);
+            ESP_ERROR_CHECK(esp_timer_start_once(s_wifi_probe_timer, WIFI_FAST_PROBE_MS * 1000));
         }
-        else
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        ESP_LOGI(TAG, "disconnected, reason %d", event->reason);
+        esp_timer_stop(s_wifi_probe_timer);
+        // 缓存的AP连不上（换了路由器或信道），马上改用全信道扫描
+        if (s_wifi_fast_active && wifi_fast_rejected(event->reason))
         {
-            ESP_LOGI(TAG, "connect to the AP fail");
-            // ESP_ERROR_CHECK(esp_sleep_enable_timer_wakeup(60*1000*1000));
-            esp_deep_sleep(60 * 1000 * 1000);
-            s_retry_num = 0;
+            wifi_fast_fallback(false);
             ESP_ERROR_CHECK(esp_wifi_connect());
+            return;
         }
+        wifi_schedule_retry();
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        ESP_LOGI(TAG, "got ip:" IPSTR " at %" PRIi64 " ms", IP2STR(&event->ip_info.ip), esp_timer_get_time() / 1000);
         s_retry_num = 0;
+        wifi_fast_save(&event->ip_info);
 
         mqtt_app_start();
     }
@@ -630,16 +2406,6 @@ static void event_handler(void *event_handler_arg,
     }
 }
 
-#define GPIO_INPUT_IO_0 GPIO_NUM_9
-#define GPIO_INPUT_PIN_SEL 1ULL << GPIO_INPUT_IO_0
-#define ESP_INTR_FLAG_DEFAULT 0
-
-static void IRAM_ATTR gpio_isr_handler(void *arg)
-{
-    uint32_t gpio_num = (uint32_t)arg;
-    ESP_LOGI(TAG, "Im %lu", gpio_num);
-}
-
 void app_main(void)
 {
     // Initialize NVS
@@ -677,15 +2443,31 @@ void app_main(void)
         if (level == 0)
         {
             nvs_set_u8(nvs_handle, "isNetConfed", 0);
+            nvs_erase_key(nvs_handle, WIFI_FAST_NVS_KEY);
             xEventGroupClearBits(s_wifi_event_group, NETWORK_CONFIGED_BIT);
         }
+        else
+        {
+            wifi_fast_load(nvs_handle);
+        }
     }
     nvs_close(nvs_handle);
 
+    esp_timer_create_args_t retry_timer_args = {
+        .callback = wifi_retry_timer_callback,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &s_wifi_retry_timer));
+    esp_timer_create_args_t probe_timer_args = {
+        .callback = wifi_probe_timer_callback,
+        .name = "wifi_probe",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&probe_timer_args, &s_wifi_probe_timer));
+
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-    assert(sta_netif);
+    s_sta_netif = esp_netif_create_default_wifi_sta();
+    assert(s_sta_netif);
     wifi_init_config_t wifi_init_config = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&wifi_init_config));
 
@@ -709,20 +2491,11 @@ void app_main(void)
         wifi_config_t wifi_config;
         ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
     }
-    ESP_ERROR_CHECK(esp_wifi_start());
-
+    // 快速重连时MQTT很快就能连上并收到命令，设备、日志、定时命令和接收都要在WiFi启动前准备好
     init_ir();
+    init_ir_journal();
+    init_ir_sched();
+    init_ir_rx();
 
-    gpio_config_t io_conf = {
-        .pin_bit_mask = 1ULL << GPIO_INPUT_IO_0,
-        .mode = GPIO_MODE_INPUT,
-        .intr_type = GPIO_INTR_NEGEDGE,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-    };
-    ESP_ERROR_CHECK(gpio_config(&io_conf));
-    // install gpio isr service
-    gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
-    // hook isr handler for specific gpio pin
-    gpio_isr_handler_add(GPIO_INPUT_IO_0, gpio_isr_handler, (void *)GPIO_INPUT_IO_0);
+    ESP_ERROR_CHECK(esp_wifi_start());
 }
\ No newline at end of file
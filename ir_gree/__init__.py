@@ -21,4 +21,9 @@
 Gree air conditioning infrared remote controller YAPOF, is a pulse-distance based infrared remote control protocol.
 '''
 
-from .pd import Decoder
+try:
+    from .pd import Decoder
+except ImportError as e:
+    # 不在sigrok中运行时没有sigrokdecode，只能用batch等离线模块
+    if e.name != 'sigrokdecode':
+        raise
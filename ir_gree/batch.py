@@ -0,0 +1,547 @@
+##
+## This file is part of the libsigrokdecode project.
+##
+## Copyright (C) 2014 Gump Yang <gump.yang@gmail.com>
+##
+## This program is free software; you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation; either version 2 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program; if not, see <http://www.gnu.org/licenses/>.
+##
+
+'''
+离线批量解码导出的抓包，不需要sigrok：
+
+    python3 -m ir_gree.batch capture.sr
+    python3 -m ir_gree.batch -s 1MHz -c 0 capture.bin
+    python3 -m ir_gree.batch -A frame,segment,warning capture.vcd
+
+抓包读成NumPy数组，用np.diff一次找出所有边沿，按pd.py的窗口一次分类所有周期，
+段和帧的状态机按控制码（引导码、连接码、无效周期）做前缀组合，没有逐个边沿的Python循环。
+输出的注释和OUTPUT_PYTHON与pd.py逐个边沿解码相同，tools/pd_batch_check.py对比两者
+'''
+
+import argparse
+import configparser
+import re
+import sys
+import zipfile
+from fractions import Fraction
+
+import numpy as np
+
+from .proto import SEGMENT_BITS, SEGMENT_GAPS, DATA_BITS, TAIL_BITS, WINDOWS
+from .calib import Calibrator
+
+# 与pd.py的annotations顺序相同
+ANN_BIT, ANN_LEADER, ANN_CONNECT, ANN_LONG_CONNECT, ANN_END, ANN_SEGMENT, ANN_FRAME, ANN_WARNING, \
+    ANN_CALIBRATION = range(9)
+ANN_NAMES = ('bit', 'leader', 'connect', 'long_connect', 'end', 'segment', 'frame', 'warning', 'calibration')
+
+# 一帧的周期数，与pd.py相同
+CALIB_PERIODS = 1 + SEGMENT_GAPS.count('long_connect') + sum(SEGMENT_BITS) + len(SEGMENT_BITS) - 1
+
+# 周期的分类，前5个的顺序就是pd.py handle_period判断的顺序
+KIND_LEADER, KIND_CONNECT, KIND_LONG_CONNECT, KIND_ZERO, KIND_ONE, KIND_INVALID = range(6)
+KIND_NAMES = ('leader', 'connect', 'long_connect', 'zero', 'one')
+
+# 警告的文字，与pd.py相同
+WARNINGS = (('Bad segment tail', 'Tail'), ('Invalid period',), ('Unexpected connect code',))
+
+# 原始数据每次读的字节数
+CHUNK_BYTES = 1 << 24
+
+
+class Edges:
+    '''一个通道的边沿：falls和rises为下降沿和上升沿的采样号（int64，升序）'''
+    def __init__(self, samplerate, falls, rises):
+        self.samplerate = samplerate
+        self.falls = falls
+        self.rises = rises
+
+
+def parse_samplerate(text):
+    m = re.fullmatch(r'\s*([\d.]+)\s*([kKmMgG]?)(?:Hz|hz)?\s*', text)
+    if not m:
+        raise ValueError('bad samplerate: %s' % text)
+    scale = {'': 1, 'k': 1000, 'm': 1000000, 'g': 1000000000}[m.group(2).lower()]
+    return int(Fraction(m.group(1)) * scale)
+
+
+class LevelEdges:
+    '''逐块输入电平，块之间接上一块的最后一个电平，第一个采样不算边沿（与sigrok的wait相同）'''
+    def __init__(self):
+        self.falls = []
+        self.rises = []
+        self.last = None
+
+    def add(self, levels, samples=None, offset=0):
+        '''levels为bool的电平，samples为对应的采样号，为None时依次为offset、offset + 1...'''
+        if not len(levels):
+            return
+        change = np.flatnonzero(np.diff(levels)) + 1
+        if self.last is not None and self.last != levels[0]:
+            change = np.concatenate(([0], change))
+        rising = levels[change]
+        if samples is None:
+            self.falls.append(change[~rising] + offset)
+            self.rises.append(change[rising] + offset)
+        else:
+            self.falls.append(samples[change[~rising]])
+            self.rises.append(samples[change[rising]])
+        self.last = levels[-1]
+
+    def edges(self, samplerate):
+        join = lambda parts: np.concatenate(parts).astype(np.int64) if parts else np.zeros(0, np.int64)
+        return Edges(samplerate, join(self.falls), join(self.rises))
+
+
+def add_raw(result, data, offset, channel, unitsize):
+    data = data[:len(data) // unitsize * unitsize].reshape(-1, unitsize)[:, channel // 8]
+    # bool的diff是不等比较，比整数相减快
+    levels = ((data >> (channel % 8)) & np.uint8(1)).view(bool)
+    result.add(levels, offset=offset)
+    return offset + len(levels)
+
+
+def load_raw(path, samplerate, channel, unitsize=1):
+    '''sigrok-cli -O binary导出的原始数据，每个采样unitsize字节'''
+    result = LevelEdges()
+    offset = 0
+    chunk = CHUNK_BYTES // unitsize * unitsize
+    with open(path, 'rb') as f:
+        while True:
+            data = np.frombuffer(f.read(chunk), np.uint8)
+            if not len(data):
+                break
+            offset = add_raw(result, data, offset, channel, unitsize)
+    return result.edges(samplerate)
+
+
+def load_sr(path, samplerate, channel):
+    '''sigrok的.sr：metadata中有采样率和通道名，数据在logic-1-N中'''
+    with zipfile.ZipFile(path) as zf:
+        meta = configparser.ConfigParser(interpolation=None)
+        meta.read_string(zf.read('metadata').decode())
+        device = meta['device 1']
+        if samplerate is None:
+            samplerate = parse_samplerate(device['samplerate'])
+        unitsize = int(device.get('unitsize', '1'))
+        if isinstance(channel, str):
+            names = {device[key]: int(key[5:]) - 1 for key in device if re.fullmatch(r'probe\d+', key)}
+            if channel not in names:
+                raise ValueError('no channel %s in %s' % (channel, path))
+            channel = names[channel]
+        capture = device.get('capturefile', 'logic-1')
+        chunks = [n for n in zf.namelist() if n == capture or n.startswith(capture + '-')]
+        chunks.sort(key=lambda n: int(n[len(capture) + 1:] or 0))
+        result = LevelEdges()
+        offset = 0
+        for name in chunks:
+            offset = add_raw(result, np.frombuffer(zf.read(name), np.uint8), offset, channel, unitsize)
+    return result.edges(samplerate)
+
+
+def load_csv(path, samplerate, channel):
+    '''
+    sigrok-cli -O csv导出的数据：';'开头的是注释（其中有Samplerate），第一行不是数字的是通道名
+    每行一个采样；有time列时（dedup）按时间换算成采样号
+    '''
+    with open(path) as f:
+        lines = f.read().splitlines()
+    header = None
+    start = 0
+    for start, line in enumerate(lines):
+        if line.startswith(';') or line.startswith('#') or not line.strip():
+            m = re.search(r'Samplerate:\s*(.+)$', line)
+            if m and samplerate is None:
+                samplerate = parse_samplerate(m.group(1))
+            continue
+        if header is None and not re.fullmatch(r'[\d.,\s\-e]+', line):
+            header = [name.strip() for name in line.split(',')]
+            continue
+        break
+    if samplerate is None:
+        raise ValueError('%s: samplerate unknown, use -s' % path)
+    table = np.loadtxt(lines[start:], delimiter=',', ndmin=2)
+    names = [name.lower() for name in header] if header else []
+    if isinstance(channel, str):
+        if header is None or channel not in header:
+            raise ValueError('no channel %s in %s' % (channel, path))
+        column = header.index(channel)
+    else:
+        # 通道号不算time列
+        column = channel + ('time' in names and names.index('time') <= channel)
+    if 'time' in names:
+        samples = np.rint(table[:, names.index('time')] * samplerate).astype(np.int64)
+    else:
+        samples = np.arange(len(table), dtype=np.int64)
+    result = LevelEdges()
+    result.add(table[:, column] != 0, samples)
+    return result.edges(samplerate)
+
+
+VCD_UNITS = {'s': 0, 'ms': 3, 'us': 6, 'ns': 9, 'ps': 12, 'fs': 15}
+
+
+def load_vcd(path, samplerate, channel):
+    '''
+    sigrok-cli -O vcd导出的数据，只取1位的wire
+    正文整个切成词，'#'开头的是时间，'0<id>'/'1<id>'是通道的电平，都用数组运算处理
+    '''
+    with open(path, 'rb') as f:
+        text = f.read()
+    head, _, body = text.partition(b'$enddefinitions')
+    m = re.search(rb'\$timescale\s+(\d+)\s*(\w+)\s+\$end', head)
+    timescale = Fraction(int(m.group(1)), 10 ** VCD_UNITS[m.group(2).decode()]) if m else Fraction(1, 10 ** 6)
+    wires = re.findall(rb'\$var\s+wire\s+1\s+(\S+)\s+(\S+)\s+\$end', head)
+    if isinstance(channel, str):
+        idents = [ident for ident, name in wires if name.decode() == channel]
+        if not idents:
+            raise ValueError('no channel %s in %s' % (channel, path))
+        ident = idents[0]
+    else:
+        ident = wires[channel][0]
+    if samplerate is None:
+        samplerate = int(1 / timescale)
+
+    tokens = np.array(body.split()[1:])
+    first = tokens.view(np.uint8).reshape(len(tokens), -1)[:, 0]
+    is_time = first == ord('#')
+    times = tokens[is_time].view(np.uint8).reshape(-1, tokens.itemsize).copy()
+    times[:, 0] = ord(' ')
+    times = times.view(tokens.dtype).ravel().astype(np.int64)
+    # 每个词之前最近的时间
+    last_time = np.maximum.accumulate(np.where(is_time, np.cumsum(is_time) - 1, -1))
+    low, high = tokens == b'0' + ident, tokens == b'1' + ident
+    values = low | high
+    stamps = times[np.maximum(last_time[values], 0)]
+    scale = timescale * samplerate
+    if scale.denominator == 1:
+        samples = stamps * scale.numerator
+    else:
+        samples = np.rint(stamps * float(scale)).astype(np.int64)
+    result = LevelEdges()
+    result.add(high[values], samples)
+    return result.edges(samplerate)
+
+
+def load(path, samplerate=None, channel='IR', unitsize=1):
+    '''按扩展名读抓包；原始数据必须给出采样率，channel为通道名或序号'''
+    lower = path.lower()
+    if lower.endswith('.sr'):
+        return load_sr(path, samplerate, channel)
+    if lower.endswith('.csv'):
+        return load_csv(path, samplerate, channel)
+    if lower.endswith('.vcd'):
+        return load_vcd(path, samplerate, channel)
+    if samplerate is None:
+        raise ValueError('%s: raw data needs a samplerate' % path)
+    return load_raw(path, samplerate, 0 if isinstance(channel, str) else channel, unitsize)
+
+
+def sample_windows(samplerate, windows):
+    # 与pd.py的set_windows相同
+    return {name: (samplerate * start // 1000000, samplerate * end // 1000000)
+            for name, (start, end) in windows.items()}
+
+
+# 分类查表的最大长度，窗口上限（采样数）超过它时逐个窗口比较
+CLASSIFY_TABLE_MAX = 1 << 24
+
+
+def classify(periods, windows):
+    '''所有周期一次分类，窗口为开区间，按pd.py的顺序先匹配的优先'''
+    kinds = [(kind, windows[name]) for kind, name in enumerate(KIND_NAMES) if name in windows]
+    size = max([end for _, (start, end) in kinds], default=0) + 1
+    if size <= CLASSIFY_TABLE_MAX:
+        # 按周期查表，优先的窗口最后填
+        table = np.full(size, KIND_INVALID, np.int8)
+        for kind, (start, end) in reversed(kinds):
+            table[max(start + 1, 0):max(end, 0)] = kind
+        return table[np.minimum(periods, size - 1)]
+    conditions = [(periods > start) & (periods < end) for _, (start, end) in kinds]
+    return np.select(conditions, [kind for kind, _ in kinds], KIND_INVALID).astype(np.int8)
+
+
+# pd.py的段状态机在控制码（引导码、连接码、长连接码、无效周期）之间只受数据码个数的影响，
+# 把"控制码 + 后面的一串数据码"看成状态的映射，前缀组合后就得到每个控制码之前的状态
+SEGMENTS = len(SEGMENT_BITS)
+STATE_IDLE = 0                          # segment和resume_segment都是None
+STATE_PARTIAL = 1                       # + 段号：这一段还没收满
+STATE_FULL = 1 + SEGMENTS               # + 段号：这一段收满了，等连接码
+STATE_RESUME = 1 + 2 * SEGMENTS         # + 段号：长连接码之后等引导码
+STATES = 1 + 3 * SEGMENTS
+# 控制码之后、数据码之前的中间状态，除了上面的状态还有"开始某一段"
+STATE_START = STATES                    # + 段号
+
+
+def build_tables():
+    control = np.zeros((KIND_INVALID + 1, STATES), np.int8)
+    for q in range(STATES):
+        control[KIND_LEADER, q] = STATE_START
+        control[KIND_CONNECT, q] = STATE_IDLE
+        control[KIND_LONG_CONNECT, q] = STATE_IDLE
+        control[KIND_INVALID, q] = STATE_IDLE
+    for s in range(SEGMENTS):
+        control[KIND_LEADER, STATE_RESUME + s] = STATE_START + s
+        if SEGMENT_GAPS[s] == 'connect':
+            control[KIND_CONNECT, STATE_FULL + s] = STATE_START + s + 1
+        elif SEGMENT_GAPS[s] == 'long_connect':
+            control[KIND_LONG_CONNECT, STATE_FULL + s] = STATE_RESUME + s + 1
+
+    # 中间状态加上数据码：need为收满需要的位数，收满和没收满时的状态
+    need = np.zeros(STATES + SEGMENTS, np.int64)
+    short = np.arange(STATES + SEGMENTS, dtype=np.int8)
+    full = short.copy()
+    for s in range(SEGMENTS):
+        need[STATE_START + s] = SEGMENT_BITS[s]
+        short[STATE_START + s] = STATE_PARTIAL + s
+        full[STATE_START + s] = STATE_IDLE if SEGMENT_GAPS[s] == 'end' else STATE_FULL + s
+    has_segment = np.zeros(STATES, bool)
+    has_segment[STATE_PARTIAL:STATE_RESUME] = True
+    return control, need, short, full, has_segment
+
+
+CONTROL, NEED, SHORT, FULL, HAS_SEGMENT = build_tables()
+
+
+def apply_runs(middle, runs):
+    '''中间状态后面接着runs个数据码之后的状态'''
+    return np.where(runs >= NEED[middle], FULL[middle], SHORT[middle])
+
+
+# 整体代入的轮数，超过后改用前缀组合
+JACOBI_ROUNDS = 16
+
+
+def run_states(kinds, runs):
+    '''kinds为各控制码，runs为它后面的数据码个数，返回每个控制码之前的状态和之后的中间状态'''
+    if not len(kinds):
+        return np.zeros(0, np.int8), np.zeros(0, np.int8)
+    step_runs = lambda before: apply_runs(CONTROL[kinds, before], runs)
+
+    # after[i] = f(kinds[i], runs[i], after[i - 1])整体反复代入，到不变时就是逐个执行的结果；
+    # 无效周期和大多数引导码与之前的状态无关，实际的依赖链只有一帧的几个控制码长
+    after = step_runs(np.full(len(kinds), STATE_IDLE, np.int8))
+    for _ in range(JACOBI_ROUNDS):
+        before = np.concatenate(([STATE_IDLE], after[:-1])).astype(np.int8)
+        update = step_runs(before)
+        if np.array_equal(update, after):
+            return before, CONTROL[kinds, before]
+        after = update
+
+    # 依赖链很长（构造的数据）时，每个控制码作为状态的映射，Hillis-Steele前缀组合：maps[i]变成maps[i]∘...∘maps[0]
+    maps = apply_runs(CONTROL[kinds], runs[:, None])
+    step = 1
+    while step < len(maps):
+        maps[step:] = np.take_along_axis(maps[step:], maps[:-step].astype(np.intp), axis=1)
+        step *= 2
+    before = np.concatenate(([STATE_IDLE], maps[:-1, STATE_IDLE])).astype(np.int8)
+    return before, CONTROL[kinds, before]
+
+
+class Result:
+    '''
+    解码结果，都是按时间排序的数组，ss/es为采样号：
+    periods_ss/es, kinds           每个周期和它的分类（KIND_*）
+    segment_ss/es/index/value      收满的段，value包括尾部
+    frame_ss/es, frame_data        帧，frame_data每行为data1..4
+    warning_ss/es/reason           警告，reason为WARNINGS中的序号
+    end_ss/es                      结束码
+    calibration                    校准的注释和OUTPUT_PYTHON，不校准时为None
+    '''
+    def __init__(self):
+        empty = np.zeros(0, np.int64)
+        self.samplerate = None
+        self.periods_ss = self.periods_es = empty
+        self.kinds = np.zeros(0, np.int8)
+        self.segment_ss = self.segment_es = self.segment_index = self.segment_value = empty
+        self.frame_ss = self.frame_es = empty
+        self.frame_data = np.zeros((0, SEGMENTS), np.int64)
+        self.warning_ss = self.warning_es = self.warning_reason = empty
+        self.end_ss = self.end_es = empty
+        self.calibration = None
+
+    def annotations(self, show_bits=True):
+        '''
+        与pd.py相同的(ss, es, output, data)，output为'ann'或'python'
+        数据量大时很多，只在输出和对比时用
+        '''
+        out = []
+        texts = {
+            KIND_LEADER: (ANN_LEADER, ['Leader code', 'Leader', 'L']),
+            KIND_CONNECT: (ANN_CONNECT, ['Connect Code', 'Connect', 'C']),
+            KIND_LONG_CONNECT: (ANN_LONG_CONNECT, ['Long connect code', 'Long connect', 'LC']),
+        }
+        for kind, ann in texts.items():
+            for ss, es in zip(self.periods_ss[self.kinds == kind].tolist(), self.periods_es[self.kinds == kind].tolist()):
+                out.append((ss, es, 'ann', [ann[0], ann[1]]))
+        if show_bits:
+            bits = (self.kinds == KIND_ZERO) | (self.kinds == KIND_ONE)
+            for ss, es, kind in zip(self.periods_ss[bits].tolist(), self.periods_es[bits].tolist(),
+                                    self.kinds[bits].tolist()):
+                out.append((ss, es, 'ann', [ANN_BIT, ['%d' % (kind == KIND_ONE)]]))
+        for ss, es, index, value in zip(self.segment_ss.tolist(), self.segment_es.tolist(),
+                                        self.segment_index.tolist(), self.segment_value.tolist()):
+            data = value & ((1 << DATA_BITS) - 1)
+            out.append((ss, es, 'ann', [ANN_SEGMENT, ['Segment %d: 0x%08X' % (index + 1, data),
+                'S%d: %08X' % (index + 1, data), '%08X' % data]]))
+            out.append((ss, es, 'python', ['SEGMENT', [index, data]]))
+        for ss, es, frame in zip(self.frame_ss.tolist(), self.frame_es.tolist(), self.frame_data.tolist()):
+            out.append((ss, es, 'ann', [ANN_FRAME, ['Frame: %08X %08X %08X %08X' % tuple(frame),
+                '%08X %08X %08X %08X' % tuple(frame), 'Frame', 'F']]))
+            out.append((ss, es, 'python', ['FRAME', frame]))
+        for ss, es in zip(self.end_ss.tolist(), self.end_es.tolist()):
+            out.append((ss, es, 'ann', [ANN_END, ['End code', 'End', 'E']]))
+        for ss, es, reason in zip(self.warning_ss.tolist(), self.warning_es.tolist(), self.warning_reason.tolist()):
+            out.append((ss, es, 'ann', [ANN_WARNING, list(WARNINGS[reason])]))
+        if self.calibration is not None:
+            out.extend(self.calibration)
+        return out
+
+
+def calibrate(result, falls):
+    '''与pd.py的run_calibration相同：第一帧的周期聚类出窗口，返回采样数的窗口'''
+    periods = falls[1:CALIB_PERIODS + 1] - falls[:CALIB_PERIODS]
+    calib = Calibrator()
+    for period in (periods * 1000000 // result.samplerate).tolist():
+        calib.add(period)
+    ok, windows, stats = calib.solve(WINDOWS)
+    ss, es = int(falls[0]), int(falls[CALIB_PERIODS])
+    if ok:
+        text = ', '.join('%s %.2fms' % (name, stats[name][1] / 1000)
+            for name in ('leader', 'zero', 'one', 'connect', 'long_connect') if stats[name][0])
+        result.calibration = [(ss, es, 'ann', [ANN_CALIBRATION, ['Calibrated: ' + text, text, 'Calibrated', 'Cal']]),
+                              (ss, es, 'python', ['CALIBRATION', windows])]
+        return sample_windows(result.samplerate, windows)
+    result.calibration = [(ss, es, 'ann', [ANN_WARNING, ['Calibration failed, using default windows',
+                                                        'Calibration failed', 'Cal']])]
+    return sample_windows(result.samplerate, WINDOWS)
+
+
+def segment_values(ones, first, bits):
+    '''从first开始的bits个周期拼成值，低位先发，bits不超过64'''
+    packed = np.packbits(ones[first[:, None] + np.arange(bits)], axis=1, bitorder='little')
+    packed = np.pad(packed, ((0, 0), (0, 8 - packed.shape[1])))
+    return packed.view('<u8').ravel().astype(np.int64)
+
+
+def decode(edges, calibrate_windows=False):
+    result = Result()
+    result.samplerate = edges.samplerate
+    falls, rises = edges.falls, edges.rises
+    if calibrate_windows:
+        # pd.py收不满一帧就一直等，什么也不输出
+        if len(falls) <= CALIB_PERIODS:
+            return result
+        windows = calibrate(result, falls)
+    else:
+        windows = sample_windows(edges.samplerate, WINDOWS)
+
+    result.periods_ss, result.periods_es = falls[:-1], falls[1:]
+    kinds = classify(result.periods_es - result.periods_ss, windows)
+    result.kinds = kinds
+
+    # 控制码的位置和后面的数据码个数；第一个控制码之前的数据码在空闲状态下被忽略
+    controls = np.flatnonzero((kinds != KIND_ZERO) & (kinds != KIND_ONE))
+    runs = np.diff(np.append(controls, len(kinds))) - 1
+    control_kinds = kinds[controls]
+    before, middle = run_states(control_kinds, runs)
+
+    # 收满的段
+    starts = middle >= STATE_START
+    segment = middle.astype(np.int64) - STATE_START
+    done = starts & (runs >= NEED[middle])
+    done_at = np.flatnonzero(done)
+    index = segment[done_at]
+    first = controls[done_at] + 1
+    bits = np.array(SEGMENT_BITS)[index]
+    value = np.zeros(len(done_at), np.int64)
+    ones = kinds == KIND_ONE
+    for s, count in enumerate(SEGMENT_BITS):
+        mask = index == s
+        value[mask] = segment_values(ones, first[mask], count)
+    result.segment_ss = falls[first]
+    result.segment_es = falls[first + bits]
+    result.segment_index = index
+    result.segment_value = value
+
+    # 中止：无效周期和不该出现的连接码，之前有正在收的段时才有警告
+    aborted = (middle == STATE_IDLE) & HAS_SEGMENT[before]
+    invalid_at = controls[aborted & (control_kinds == KIND_INVALID)]
+    connect_at = controls[aborted & (control_kinds != KIND_INVALID)]
+    tail_bad = (bits > DATA_BITS) & ((value >> DATA_BITS) != TAIL_BITS)
+    ss = np.concatenate((result.segment_ss[tail_bad], falls[invalid_at], falls[connect_at]))
+    es = np.concatenate((result.segment_es[tail_bad], falls[invalid_at + 1], falls[connect_at + 1]))
+    reason = np.repeat(np.arange(3), (np.count_nonzero(tail_bad), len(invalid_at), len(connect_at)))
+    order = np.lexsort((es, ss))
+    result.warning_ss, result.warning_es, result.warning_reason = ss[order], es[order], reason[order]
+
+    # 最后一段收满出帧；帧从最近一个重新开始的引导码算起，各段取最近收到的值
+    last = np.array([SEGMENT_GAPS[s] == 'end' for s in range(SEGMENTS)])[index]
+    frame_at = done_at[last]
+    leaders = np.flatnonzero((control_kinds == KIND_LEADER) & (middle == STATE_START))
+    result.frame_ss = falls[controls[leaders[np.searchsorted(leaders, frame_at, 'right') - 1]]] \
+        if len(frame_at) else np.zeros(0, np.int64)
+    result.frame_es = result.segment_es[last]
+    result.frame_data = np.zeros((len(frame_at), SEGMENTS), np.int64)
+    for s in range(SEGMENTS):
+        mine = index == s
+        pos = np.searchsorted(done_at[mine], frame_at, 'right') - 1
+        data = value[mine] & ((1 << DATA_BITS) - 1)
+        result.frame_data[:, s] = np.where(pos >= 0, data[np.maximum(pos, 0)] if len(data) else 0, 0)
+
+    # 结束码到帧后的第一个上升沿
+    rise = np.searchsorted(rises, result.frame_es, 'right')
+    has_rise = rise < len(rises)
+    result.end_ss, result.end_es = result.frame_es[has_rise], rises[rise[has_rise]]
+
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode gree YAPOF frames from an exported capture')
+    parser.add_argument('file', help='.sr、.csv、.vcd或原始数据')
+    parser.add_argument('-s', '--samplerate', help='采样率，原始数据必须给出，如1MHz')
+    parser.add_argument('-c', '--channel', default='IR', help='通道名或序号')
+    parser.add_argument('-u', '--unitsize', type=int, default=1, help='原始数据每个采样的字节数')
+    parser.add_argument('-A', '--annotations', default='frame',
+                        help='输出的注释，逗号分隔：' + ','.join(ANN_NAMES))
+    parser.add_argument('--calibrate', action='store_true', help='与pd.py的calibrate=yes相同')
+    args = parser.parse_args()
+
+    channel = int(args.channel) if args.channel.isdigit() else args.channel
+    samplerate = parse_samplerate(args.samplerate) if args.samplerate else None
+    try:
+        edges = load(args.file, samplerate, channel, args.unitsize)
+    except (OSError, ValueError, KeyError, zipfile.BadZipFile) as e:
+        print(e, file=sys.stderr)
+        return 1
+    result = decode(edges, args.calibrate)
+
+    wanted = set()
+    for name in args.annotations.split(','):
+        if name not in ANN_NAMES:
+            print('unknown annotation %s' % name, file=sys.stderr)
+            return 1
+        wanted.add(ANN_NAMES.index(name))
+    out = [a for a in result.annotations(ANN_BIT in wanted) if a[2] == 'ann' and a[3][0] in wanted]
+    out.sort(key=lambda a: (a[0], a[1]))
+    # 与sigrok-cli --protocol-decoder-samplenum的格式相同
+    lines = ['%d-%d ir_gree-1: %s' % (ss, es, data[1][0]) for ss, es, _, data in out]
+    if lines:
+        print('\n'.join(lines))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
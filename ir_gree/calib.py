@@ -0,0 +1,133 @@
+##
+## This file is part of the libsigrokdecode project.
+##
+## Copyright (C) 2014 Gump Yang <gump.yang@gmail.com>
+##
+## This program is free software; you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation; either version 2 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program; if not, see <http://www.gnu.org/licenses/>.
+##
+
+# 接收窗口自动校准，与esp32/components/ir_gree/ir_gree_calib.c的算法相同：
+# 周期（us）放进对数直方图，以标称周期为初始中心按对数距离聚类，
+# 每类的窗口为它的格覆盖的范围再放宽MARGIN_PCT，不超过与相邻类中心的几何平均
+
+from math import isqrt
+
+from .proto import NOMINAL, DATA_BITS
+
+MIN_US = 512
+OCTAVES = 7
+STEPS = 16
+BINS = OCTAVES * STEPS
+TOTAL_MAX = 4096
+MIN_COUNT = 1
+MIN_BITS = DATA_BITS
+OUTLIER_PCT = 35
+MARGIN_PCT = 10
+ITERATIONS = 8
+SPARSE_RATIO = 32
+
+# 按周期从短到长
+CLASSES = ('zero', 'one', 'leader', 'connect', 'long_connect')
+
+def bin_start(index):
+    octave, step = divmod(index, STEPS)
+    return (STEPS + step) * (MIN_US << octave) // STEPS
+
+class Calibrator:
+    def __init__(self):
+        self.counts = [0] * BINS
+        self.sums = [0] * BINS
+        self.total = 0
+        self.outliers = 0
+
+    def add(self, period):
+        if period < MIN_US or period >= bin_start(BINS):
+            self.outliers += 1
+            return
+        if self.total >= TOTAL_MAX:
+            self.counts = [c // 2 for c in self.counts]
+            self.sums = [s // 2 for s in self.sums]
+            self.total = sum(self.counts)
+        msb = period.bit_length() - 1
+        octave = msb - (MIN_US.bit_length() - 1)
+        step = (period - (1 << msb)) * STEPS >> msb
+        index = octave * STEPS + step
+        self.counts[index] += 1
+        self.sums[index] += period
+        self.total += 1
+
+    @staticmethod
+    def nearest(centers, period):
+        k = 0
+        while k + 1 < len(CLASSES) and period * period > centers[k] * centers[k + 1]:
+            k += 1
+        if abs(period - centers[k]) * 100 > centers[k] * OUTLIER_PCT:
+            return None
+        return k
+
+    def bins(self):
+        for index in range(BINS):
+            if self.counts[index]:
+                yield index, self.counts[index], self.sums[index] // self.counts[index]
+
+    def solve(self, windows):
+        '''
+        windows为各类当前的窗口（us），样本太少的类保持不变
+        返回(ok, windows, stats)，stats为各类的(样本数, 平均周期, 窗口)
+        引导码、数据码0和1都有样本，且数据码不少于MIN_BITS个时ok为True
+        '''
+        centers = [NOMINAL[name] for name in CLASSES]
+        counts = [0] * len(CLASSES)
+        for _ in range(ITERATIONS):
+            sums = [0] * len(CLASSES)
+            counts = [0] * len(CLASSES)
+            for index, count, mean in self.bins():
+                k = self.nearest(centers, mean)
+                if k is not None:
+                    sums[k] += self.sums[index]
+                    counts[k] += count
+            new = [(sums[k] + counts[k] // 2) // counts[k] if counts[k] else centers[k]
+                   for k in range(len(CLASSES))]
+            if new == centers:
+                break
+            centers = new
+
+        # 类的范围只算样本较多的格，零星的干扰不会把窗口撑大
+        lows = [None] * len(CLASSES)
+        highs = [None] * len(CLASSES)
+        for index, count, mean in self.bins():
+            k = self.nearest(centers, mean)
+            if k is None or count * SPARSE_RATIO < counts[k]:
+                continue
+            start, end = bin_start(index), bin_start(index + 1)
+            lows[k] = start if lows[k] is None else min(lows[k], start)
+            highs[k] = end if highs[k] is None else max(highs[k], end)
+
+        result = dict(windows)
+        stats = {}
+        for k, name in enumerate(CLASSES):
+            if counts[k] >= MIN_COUNT:
+                margin = centers[k] * MARGIN_PCT // 100
+                start, end = lows[k] - margin, highs[k] + margin
+                # 窗口为开区间，分界上的周期归较短的一类
+                if k > 0:
+                    start = max(start, isqrt(centers[k - 1] * centers[k]))
+                if k + 1 < len(CLASSES):
+                    end = min(end, isqrt(centers[k] * centers[k + 1]) + 1)
+                result[name] = (start, end)
+            stats[name] = (counts[k], centers[k], result[name])
+
+        zero, one, leader = (counts[CLASSES.index(name)] for name in ('zero', 'one', 'leader'))
+        ok = min(zero, one, leader) >= MIN_COUNT and zero + one >= MIN_BITS
+        return ok, (result if ok else dict(windows)), stats
@@ -18,10 +18,15 @@
 ##
 
 import sigrokdecode as srd
+from .proto import SEGMENT_BITS, SEGMENT_GAPS, DATA_BITS, TAIL_BITS, WINDOWS
+from .calib import Calibrator
 
 class SamplerateError(Exception):
     pass
 
+# 一帧的周期数：引导码、各段的数据码、段之间的连接码，用来校准
+CALIB_PERIODS = 1 + SEGMENT_GAPS.count('long_connect') + sum(SEGMENT_BITS) + len(SEGMENT_BITS) - 1
+
 class Decoder(srd.Decoder):
     api_version = 3
     id = 'ir_gree'
@@ -30,19 +35,34 @@ class Decoder(srd.Decoder):
     desc = 'GREE YAPOF infrared remote control protocol'
     license = 'gplv2+'
     inputs = ['logic']
-    outputs = []
+    outputs = ['ir_gree']
     tags = ['IR']
     channels = (
         {'id': 'ir', 'name': 'IR', 'desc': 'Data line'},
     )
-    options = ()
+    options = (
+        {'id': 'bits', 'desc': 'Annotate every bit', 'default': 'yes',
+            'values': ('yes', 'no')},
+        {'id': 'calibrate', 'desc': 'Learn timing windows from the first frame', 'default': 'no',
+            'values': ('yes', 'no')},
+    )
     annotations = (
         ('bit', 'Bit'),
         ('leader-code', 'Leader Code'),
         ('connect-code', 'Connect Code'),
+        ('long-connect-code', 'Long Connect Code'),
+        ('end-code', 'End Code'),
+        ('segment', 'Segment'),
+        ('frame', 'Frame'),
+        ('warning', 'Warning'),
+        ('calibration', 'Calibration'),
     )
     annotation_rows = (
-        ('bits', 'Bits', (0, 1, 2)),
+        ('bits', 'Bits', (0, 1, 2, 3, 4)),
+        ('segments', 'Segments', (5,)),
+        ('frames', 'Frames', (6,)),
+        ('warnings', 'Warnings', (7,)),
+        ('calibrations', 'Calibration', (8,)),
     )
 
     def __init__(self):
@@ -50,46 +70,173 @@ class Decoder(srd.Decoder):
 
     def start(self):
         self.out_ann = self.register(srd.OUTPUT_ANN)
+        self.out_python = self.register(srd.OUTPUT_PYTHON)
+        self.show_bits = self.options['bits'] == 'yes'
+        self.calibrate = self.options['calibrate'] == 'yes'
 
     def reset(self):
         self.samplerate = None
         self.sample_start = 0
+        self.segment = None
+        self.resume_segment = None
+        self.frame = [0] * len(SEGMENT_BITS)
+        self.frame_start = 0
 
     def metadata(self, key, value):
         if key == srd.SRD_CONF_SAMPLERATE:
             self.samplerate = value
-        # 采样率 * 时间 = 采样数
-        # 引导码 Low 9ms + High 4.5ms=13.5ms, 即0.0135s
-        # 上下浮动10%
-        self.leader_start = int(self.samplerate * 0.012)
-        self.leader_end = int(self.samplerate * 0.015)
+        self.set_windows(WINDOWS)
+
+    def set_windows(self, windows):
+        # 采样率 * 时间 = 采样数，各种码的窗口（us）见proto.py
+        self.windows = {}
+        for name, (start, end) in windows.items():
+            self.windows[name] = (self.samplerate * start // 1000000, self.samplerate * end // 1000000)
+
+    def in_window(self, name, b):
+        if name not in self.windows:
+            return False
+        start, end = self.windows[name]
+        return b > start and b < end
+
+    def putb(self, ss, es, data):
+        self.put(ss, es, self.out_ann, data)
+
+    def start_segment(self, index, ss):
+        self.segment = index
+        self.segment_start = ss
+        self.bit_count = 0
+        self.value = 0
+
+    def abort(self, ss, es, reason):
+        if self.segment is not None:
+            self.putb(ss, es, [7, [reason]])
+        self.segment = None
+        self.resume_segment = None
+
+    def handle_leader(self, ss, es):
+        self.putb(ss, es, [1, ['Leader code', 'Leader', 'L']])
+        # 长连接码之后的引导码开始下一段，其他情况都从头开始
+        if self.resume_segment is not None:
+            self.start_segment(self.resume_segment, es)
+            self.resume_segment = None
+        else:
+            self.frame_start = ss
+            self.start_segment(0, es)
 
-        # 连接码 Low 0.66ms + High 20ms
-        self.connect_start = int(self.samplerate * 0.0205)
-        self.connect_end = int(self.samplerate * 0.0208)
+    def handle_bit(self, ss, es, bit):
+        if self.show_bits:
+            self.putb(ss, es, [0, ['%d' % bit]])
+        if self.segment is None or self.bit_count >= SEGMENT_BITS[self.segment]:
+            return False
+        self.value |= bit << self.bit_count
+        self.bit_count += 1
+        if self.bit_count < SEGMENT_BITS[self.segment]:
+            return False
 
-        # 0 Low 0.66ms + High 0.54ms = 1.2ms
-        self.zero_start = int(self.samplerate * 0.00108)
-        self.zero_end = int(self.samplerate * 0.00144)
+        index = self.segment
+        data = self.value & ((1 << DATA_BITS) - 1)
+        self.frame[index] = data
+        self.putb(self.segment_start, es, [5, ['Segment %d: 0x%08X' % (index + 1, data),
+            'S%d: %08X' % (index + 1, data), '%08X' % data]])
+        self.put(self.segment_start, es, self.out_python, ['SEGMENT', [index, data]])
+        if SEGMENT_BITS[index] > DATA_BITS and (self.value >> DATA_BITS) != TAIL_BITS:
+            self.putb(self.segment_start, es, [7, ['Bad segment tail', 'Tail']])
+        if SEGMENT_GAPS[index] != 'end':
+            return False
 
-        # 1 Low 0.66ms + High 1.66ms = 2.32ms
-        self.one_start = int(self.samplerate * 0.00208)
-        self.one_end = int(self.samplerate * 0.00255)
+        # 最后一位的周期结束于结束码的下降沿，到这里整帧已经收完
+        self.putb(self.frame_start, es, [6, ['Frame: %08X %08X %08X %08X' % tuple(self.frame),
+            '%08X %08X %08X %08X' % tuple(self.frame), 'Frame', 'F']])
+        self.put(self.frame_start, es, self.out_python, ['FRAME', list(self.frame)])
+        self.segment = None
+        return True
+
+    def handle_connect(self, ss, es, long):
+        if long:
+            self.putb(ss, es, [3, ['Long connect code', 'Long connect', 'LC']])
+        else:
+            self.putb(ss, es, [2, ['Connect Code', 'Connect', 'C']])
+        expected = 'long_connect' if long else 'connect'
+        if self.segment is None or self.bit_count != SEGMENT_BITS[self.segment] \
+                or SEGMENT_GAPS[self.segment] != expected:
+            self.abort(ss, es, 'Unexpected connect code')
+            return
+        if long:
+            self.resume_segment = self.segment + 1
+            self.segment = None
+        else:
+            self.start_segment(self.segment + 1, es)
+
+    def handle_period(self, ss, es):
+        b = es - ss
+        if self.in_window('leader', b):
+            self.handle_leader(ss, es)
+        elif self.in_window('connect', b):
+            self.handle_connect(ss, es, False)
+        elif self.in_window('long_connect', b):
+            self.handle_connect(ss, es, True)
+        elif self.in_window('zero', b):
+            return self.handle_bit(ss, es, 0)
+        elif self.in_window('one', b):
+            return self.handle_bit(ss, es, 1)
+        else:
+            self.abort(ss, es, 'Invalid period')
+        return False
+
+    def put_end(self, ss, es):
+        self.putb(ss, es, [4, ['End code', 'End', 'E']])
+
+    def run_calibration(self):
+        # 先收一帧的周期，聚类出窗口后再从头解码这些周期
+        calib = Calibrator()
+        periods = []
+        while len(periods) < CALIB_PERIODS:
+            (ir,) = self.wait({0: 'e'})
+            if ir:
+                # 记下每个周期后的上升沿，重放时结束码要用
+                if periods and periods[-1][2] is None:
+                    periods[-1][2] = self.samplenum
+                continue
+            if self.sample_start != 0:
+                periods.append([self.sample_start, self.samplenum, None])
+                calib.add((self.samplenum - self.sample_start) * 1000000 // self.samplerate)
+            self.sample_start = self.samplenum
+
+        ok, windows, stats = calib.solve(WINDOWS)
+        ss, es = periods[0][0], periods[-1][1]
+        if ok:
+            self.set_windows(windows)
+            text = ', '.join('%s %.2fms' % (name, stats[name][1] / 1000)
+                for name in ('leader', 'zero', 'one', 'connect', 'long_connect') if stats[name][0])
+            self.putb(ss, es, [8, ['Calibrated: ' + text, text, 'Calibrated', 'Cal']])
+            self.put(ss, es, self.out_python, ['CALIBRATION', windows])
+        else:
+            self.putb(ss, es, [7, ['Calibration failed, using default windows', 'Calibration failed', 'Cal']])
+
+        for ss, es, rise in periods:
+            if not self.handle_period(ss, es):
+                continue
+            if rise is None:
+                self.wait({0: 'r'})
+                rise = self.samplenum
+            self.put_end(es, rise)
 
     def decode(self):
+        if not self.samplerate:
+            raise SamplerateError('Cannot decode without samplerate.')
+        if self.calibrate:
+            self.run_calibration()
         while True:
             self.wait({0: 'f'})
             if (self.sample_start == 0):
                 self.sample_start = self.samplenum
-            else:
-                b = self.samplenum - self.sample_start
-                if (b > self.leader_start and b < self.leader_end):
-                    self.put(self.sample_start, self.samplenum, self.out_ann, [1,['Leader code', 'Leader', 'L']])
-                elif (b > self.connect_start and b < self.connect_end):
-                    self.put(self.sample_start, self.samplenum, self.out_ann, [2,['Connect Code', 'Connect', 'C']])
-                elif (b > self.zero_start and b < self.zero_end):
-                    self.put(self.sample_start, self.samplenum, self.out_ann, [0,['%d' % 0]])
-                elif (b > self.one_start and b < self.one_end):
-                    self.put(self.sample_start, self.samplenum, self.out_ann, [0,['%d' % 1]])
-                    
-                self.sample_start = self.samplenum
\ No newline at end of file
+                continue
+
+            ss, es = self.sample_start, self.samplenum
+            frame_done = self.handle_period(ss, es)
+            self.sample_start = es
+            if frame_done:
+                # 结束码只有660us低电平，后面没有下降沿，等上升沿
+                self.wait({0: 'r'})
+                self.put_end(es, self.samplenum)
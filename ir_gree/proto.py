@@ -0,0 +1,28 @@
+## 由tools/gen_protocol.py根据protocols/gree_yapof.json生成，不要手动修改
+## 格力空调遥控器YAPOF
+
+# 每段的位数，低位先发；带固定尾部的段最后TAIL_BIT_COUNT位为TAIL_BITS
+SEGMENT_BITS = (35, 32, 35, 32)
+# 每段后面的码，'long_connect'之后重新发引导码
+SEGMENT_GAPS = ('connect', 'long_connect', 'connect', 'end')
+DATA_BITS = 32
+TAIL_BITS = 0x2
+TAIL_BIT_COUNT = 3
+
+# 各种码的周期（mark + space）窗口，单位us，开区间
+WINDOWS = {
+    'leader': (12000, 15000),
+    'zero': (1080, 1440),
+    'one': (2080, 2550),
+    'connect': (20500, 20800),
+    'long_connect': (40000, 41500),
+}
+
+# 各种码的标称周期（mark + space），单位us，校准的初始中心
+NOMINAL = {
+    'leader': 13500,
+    'zero': 1200,
+    'one': 2340,
+    'connect': 20660,
+    'long_connect': 40660,
+}
@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+'''
+根据协议描述（protocols/*.json）生成各处使用的协议表：
+
+    esp32/components/ir_gree/include/ir_gree_protocol.h  ESP32编码器、解码器和主机工具
+    arduino/38khz/gree_protocol.h                        Arduino播放表
+    ir_gree/proto.py                                     sigrok解码器的窗口
+
+    python3 tools/gen_protocol.py [protocols/gree_yapof.json]
+    python3 tools/gen_protocol.py --check   # 生成的文件与描述不一致时返回1
+
+描述中的字段：
+    prefix     C宏的前缀
+    data_bits  每段数据的位数
+    tail       部分段在数据后面还有固定的几位，value为这几位的值（低位先发）
+    codes      各种码的mark/space（us）和接收时周期（mark + space）的窗口，开区间
+               必须有leader、zero、one、end，end的space为0
+    segments   按发送顺序的各段，tail表示带固定尾部，gap为段后的码
+               帧以引导码开始，long_connect之后重新发引导码，最后一段的gap必须是end
+
+编码器和解码器只认识固定的几种码（ir_gree_sym_t），扫描码固定为4段（ir_gree_scan_code_t），
+换一种型号只改时长、窗口、位数和段后的码。
+'''
+
+import argparse
+import json
+import os
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# 与ir_gree_sym_t一一对应，顺序即C头文件中的顺序
+CODES = ('leader', 'zero', 'one', 'connect', 'long_connect', 'end')
+GAPS = ('connect', 'long_connect', 'end')
+CODE_NAMES = {
+    'leader': '引导码',
+    'zero': '数据码 0',
+    'one': '数据码 1',
+    'connect': '短连接码',
+    'long_connect': '长连接码',
+    'end': '结束码，后面没有空闲',
+}
+
+C_HEADER = 'esp32/components/ir_gree/include/ir_gree_protocol.h'
+ARDUINO_HEADER = 'arduino/38khz/gree_protocol.h'
+PYTHON_MODULE = 'ir_gree/proto.py'
+
+
+class Protocol:
+    def __init__(self, path):
+        with open(path, encoding='utf-8') as f:
+            desc = json.load(f)
+        self.source = os.path.relpath(os.path.abspath(path), ROOT).replace(os.sep, '/')
+        self.description = desc['description']
+        self.prefix = desc['prefix']
+        self.data_bits = desc['data_bits']
+        self.tail_value = desc['tail']['value']
+        self.tail_bits = desc['tail']['bits']
+        self.codes = desc['codes']
+        self.segments = desc['segments']
+        self.validate()
+
+    def validate(self):
+        for name in ('leader', 'zero', 'one', 'end'):
+            if name not in self.codes:
+                raise ValueError('missing code: %s' % name)
+        for name, code in self.codes.items():
+            if name not in CODES:
+                raise ValueError('unknown code: %s' % name)
+            if name != 'end' and (code['space'] <= 0 or len(code['window']) != 2):
+                raise ValueError('%s needs a space and a window' % name)
+        if self.codes['end']['space'] != 0:
+            raise ValueError('end code must not have a space')
+        if self.data_bits > 32 or self.tail_value >> self.tail_bits:
+            raise ValueError('invalid data or tail bits')
+        if len(self.segments) != 4:
+            raise ValueError('ir_gree_scan_code_t has exactly 4 segments')
+        if self.segments[-1]['gap'] != 'end':
+            raise ValueError('the last segment must end with the end code')
+        for seg in self.segments:
+            if seg['gap'] not in GAPS or seg['gap'] not in self.codes:
+                raise ValueError('invalid gap: %s' % seg['gap'])
+            if seg['gap'] == 'end' and seg is not self.segments[-1]:
+                raise ValueError('only the last segment can end with the end code')
+
+    def segment_bits(self, seg):
+        return self.data_bits + (self.tail_bits if seg['tail'] else 0)
+
+    @property
+    def packed_bits(self):
+        return sum(self.segment_bits(seg) for seg in self.segments)
+
+    def leaders(self):
+        '''每段前面是否有引导码'''
+        result = []
+        for i, seg in enumerate(self.segments):
+            result.append(i == 0 or self.segments[i - 1]['gap'] == 'long_connect')
+        return result
+
+    @property
+    def frame_pulses(self):
+        '''整帧的mark/space对数'''
+        return sum(self.leaders()) + sum(self.segment_bits(seg) + 1 for seg in self.segments)
+
+    def used_codes(self):
+        return [name for name in CODES if name in self.codes]
+
+
+def generated_by(proto, comment):
+    return '%s 由tools/gen_protocol.py根据%s生成，不要手动修改' % (comment, proto.source)
+
+
+def gen_c(proto):
+    p = proto.prefix
+    lines = [
+        '/*',
+        generated_by(proto, ' *'),
+        ' * %s，时长单位us' % proto.description,
+        ' * MIN/MAX为接收时周期（mark + space）的窗口，开区间',
+        ' */',
+        '',
+        '#pragma once',
+        '',
+    ]
+    for name in proto.used_codes():
+        code = proto.codes[name]
+        upper = '%s_%s' % (p, name.upper())
+        lines.append('// %s' % CODE_NAMES[name])
+        lines.append('#define %s_MARK_US %d' % (upper, code['mark']))
+        if name != 'end':
+            lines.append('#define %s_SPACE_US %d' % (upper, code['space']))
+            lines.append('#define %s_MIN_US %d' % (upper, code['window'][0]))
+            lines.append('#define %s_MAX_US %d' % (upper, code['window'][1]))
+        lines.append('')
+
+    lines += [
+        '// 每段的数据位数，带固定尾部的段后面还有%d位%s（低位先发）' % (proto.tail_bits, bin(proto.tail_value)[2:].zfill(proto.tail_bits)[::-1]),
+        '#define %s_DATA_BITS %d' % (p, proto.data_bits),
+        '#define %s_TAIL_BITS 0x%X' % (p, proto.tail_value),
+        '#define %s_TAIL_BIT_COUNT %d' % (p, proto.tail_bits),
+        '',
+        '#define %s_SEGMENT_NUM %d' % (p, len(proto.segments)),
+        '// 所有段的位数，包括固定尾部',
+        '#define %s_PACKED_BITS %d' % (p, proto.packed_bits),
+        '// 整帧的mark/space对数',
+        '#define %s_FRAME_PULSES %d' % (p, proto.frame_pulses),
+        '',
+        '// ir_gree_segments的初始值：段的位数和段后的符号',
+        '#define %s_SEGMENTS_INIT \\' % p,
+        '    { \\',
+    ]
+    for seg in proto.segments:
+        lines.append('        {%d, %s_SYM_%s}, \\' % (proto.segment_bits(seg), p, seg['gap'].upper()))
+    lines += ['    }', '']
+    return '\n'.join(lines)
+
+
+def gen_arduino(proto):
+    lines = [
+        generated_by(proto, '//'),
+        '// %s，时长单位us' % proto.description,
+        '',
+        '#pragma once',
+        '',
+    ]
+    for name in proto.used_codes():
+        code = proto.codes[name]
+        lines.append('// %s' % CODE_NAMES[name])
+        lines.append('#define %s_MARK %d' % (name.upper(), code['mark']))
+        if name != 'end':
+            lines.append('#define %s_SPACE %d' % (name.upper(), code['space']))
+        lines.append('')
+
+    bits = ', '.join(str(proto.segment_bits(seg)) for seg in proto.segments)
+    gaps = ', '.join('GAP_%s' % seg['gap'].upper() for seg in proto.segments)
+    # 每对mark/space占两项，结束码只有mark
+    frame_codes = proto.frame_pulses * 2 - 1
+    lines += [
+        '// 段后的码，长连接码之后重新发引导码',
+        'enum {',
+        '  GAP_CONNECT,',
+        '  GAP_LONG_CONNECT,',
+        '  GAP_END,',
+        '};',
+        '',
+        '#define SEGMENT_NUM %d' % len(proto.segments),
+        'const byte segmentBits[SEGMENT_NUM] = { %s };' % bits,
+        'const byte segmentGaps[SEGMENT_NUM] = { %s };' % gaps,
+        '',
+        '// 整帧的数据码按发送顺序逐位存放，低位在前，%d位共%d字节' % (proto.packed_bits, (proto.packed_bits + 7) // 8),
+        '#define PACKED_BYTES %d' % ((proto.packed_bits + 7) // 8),
+        '// 整帧波形的项数，每项是一段脉冲或空闲',
+        '#define FRAME_CODES %d' % frame_codes,
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def gen_python(proto):
+    bits = ', '.join(str(proto.segment_bits(seg)) for seg in proto.segments)
+    gaps = ', '.join("'%s'" % seg['gap'] for seg in proto.segments)
+    lines = [
+        generated_by(proto, '##'),
+        '## %s' % proto.description,
+        '',
+        '# 每段的位数，低位先发；带固定尾部的段最后TAIL_BIT_COUNT位为TAIL_BITS',
+        'SEGMENT_BITS = (%s,)' % bits if len(proto.segments) == 1 else 'SEGMENT_BITS = (%s)' % bits,
+        "# 每段后面的码，'long_connect'之后重新发引导码",
+        'SEGMENT_GAPS = (%s,)' % gaps if len(proto.segments) == 1 else 'SEGMENT_GAPS = (%s)' % gaps,
+        'DATA_BITS = %d' % proto.data_bits,
+        'TAIL_BITS = 0x%X' % proto.tail_value,
+        'TAIL_BIT_COUNT = %d' % proto.tail_bits,
+        '',
+        '# 各种码的周期（mark + space）窗口，单位us，开区间',
+        'WINDOWS = {',
+    ]
+    for name in proto.used_codes():
+        if name != 'end':
+            lines.append("    '%s': (%d, %d)," % (name, proto.codes[name]['window'][0], proto.codes[name]['window'][1]))
+    lines += [
+        '}',
+        '',
+        '# 各种码的标称周期（mark + space），单位us，校准的初始中心',
+        'NOMINAL = {',
+    ]
+    for name in proto.used_codes():
+        if name != 'end':
+            lines.append("    '%s': %d," % (name, proto.codes[name]['mark'] + proto.codes[name]['space']))
+    lines += ['}', '']
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate protocol tables from a protocol descriptor')
+    parser.add_argument('descriptor', nargs='?', default=os.path.join(ROOT, 'protocols', 'gree_yapof.json'))
+    parser.add_argument('--check', action='store_true', help='only check that the generated files are up to date')
+    args = parser.parse_args()
+
+    proto = Protocol(args.descriptor)
+    outputs = {
+        C_HEADER: gen_c(proto),
+        ARDUINO_HEADER: gen_arduino(proto),
+        PYTHON_MODULE: gen_python(proto),
+    }
+
+    stale = []
+    for path, text in outputs.items():
+        full = os.path.join(ROOT, path)
+        try:
+            with open(full, encoding='utf-8', newline='') as f:
+                old = f.read().replace('\r\n', '\n')
+        except FileNotFoundError:
+            old = None
+        if old == text:
+            continue
+        stale.append(path)
+        if not args.check:
+            with open(full, 'w', encoding='utf-8', newline='\n') as f:
+                f.write(text)
+            print('generated %s' % path)
+
+    if args.check and stale:
+        for path in stale:
+            print('%s is out of date' % path)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
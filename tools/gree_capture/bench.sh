@@ -0,0 +1,25 @@
+#!/bin/sh
+# 对比gree_capture与sigrok-cli -P ir_gree解析同一个抓包的耗时
+# ./bench.sh capture.sr [通道名]
+set -e
+
+CAPTURE=$1
+CHANNEL=${2:-IR}
+BUILD=${BUILD:-build}
+
+if [ -z "$CAPTURE" ]; then
+    echo "usage: $0 capture.sr [channel]" >&2
+    exit 2
+fi
+
+cmake -S "$(dirname "$0")" -B "$BUILD" -DGREE_CAPTURE_AVX2=ON >/dev/null
+cmake --build "$BUILD" >/dev/null
+
+echo "gree_capture:"
+time "$BUILD/gree_capture" "$CAPTURE" >/dev/null
+"$BUILD/gree_capture" --bench "$CAPTURE"
+
+if command -v sigrok-cli >/dev/null; then
+    echo "sigrok-cli:"
+    time sigrok-cli -i "$CAPTURE" -P "ir_gree:ir=$CHANNEL" -A ir_gree >/dev/null
+fi
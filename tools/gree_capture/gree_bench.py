@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+'''
+用gree_gen生成各种情况的抓包，比较各个解码器的速度和解出的帧是否正确
+
+    python3 tools/gree_capture/gree_bench.py --size 1G
+    python3 tools/gree_capture/gree_bench.py --size 4G --scenarios clean,drift --pd-size 0
+
+解码器：
+    capture    gree_capture，与pd.py相同的按采样数分类
+    calibrate  gree_capture --calibrate，先校准窗口再解码（扫两遍）
+    rmt        gree_capture --rmt，按ESP32的RMT接收和ir_gree_decoder解码
+    batch      python3 -m ir_gree.batch，与pd.py的输出相同的NumPy批量解码，需要numpy
+    pd         sigrok-cli -P ir_gree，即ir_gree/pd.py，很慢，用--pd-size另外生成较小的.sr
+
+每个解码器解出的帧按时间（引导码下降沿，相差不超过--tolerance毫秒）和gree_gen写的.frames对比：
+    ok        扫描码相同
+    wrong     时间对上但扫描码不同
+    spurious  没有对应的帧
+    missed    没有解出的帧
+    clean ok  没有毛刺和漏码的帧中解对的个数/总数
+吞吐量为每秒处理的抓包字节数，realtime为抓包时长与耗时之比
+'''
+
+import argparse
+import importlib.util
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# 名称: gree_gen的参数
+SCENARIOS = {
+    'clean': [],
+    'jitter': ['--jitter', '30'],
+    'drift': ['--scale', '1.1'],
+    'glitch': ['--glitches', '1'],
+    'drop': ['--drop', '0.001'],
+    'carrier': ['--carrier', '38k'],
+}
+
+CAPTURE_RE = re.compile(r'^([\d.]+) s: ([0-9a-f]{8}) ([0-9a-f]{8}) ([0-9a-f]{8}) ([0-9a-f]{8})')
+# sigrok-cli --protocol-decoder-samplenum的输出：起始-结束 ir_gree-1: Frame: ...
+SIGROK_RE = re.compile(r'^(\d+)-\d+ ir_gree-\d+: Frame: ([0-9A-F]{8}) ([0-9A-F]{8}) ([0-9A-F]{8}) ([0-9A-F]{8})')
+
+
+def build(build_dir):
+    subprocess.run(['cmake', '-S', HERE, '-B', build_dir, '-DGREE_CAPTURE_AVX2=ON'], check=True,
+                   stdout=subprocess.DEVNULL)
+    subprocess.run(['cmake', '--build', build_dir], check=True, stdout=subprocess.DEVNULL)
+
+
+def generate(args, name, path, size):
+    if not os.path.exists(path) or not args.keep:
+        cmd = [os.path.join(args.build, 'gree_gen'), '-s', str(args.samplerate), '--size', size,
+               '--seed', str(args.seed), '-o', path] + SCENARIOS[name]
+        subprocess.run(cmd, check=True, stderr=subprocess.DEVNULL)
+    truth = []
+    with open(path + '.frames') as f:
+        for line in f:
+            t, *codes, status = line.split()
+            truth.append((float(t), tuple(int(c, 16) for c in codes), status == 'ok'))
+    return truth
+
+
+def run_capture(args, path, extra):
+    cmd = [os.path.join(args.build, 'gree_capture'), '-s', str(args.samplerate)] + extra + [path]
+    begin = time.perf_counter()
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    seconds = time.perf_counter() - begin
+    frames = []
+    for line in out.splitlines():
+        m = CAPTURE_RE.match(line)
+        if m:
+            frames.append((float(m.group(1)), tuple(int(g, 16) for g in m.groups()[1:])))
+    return seconds, frames
+
+
+def run_sigrok_format(args, cmd, env=None):
+    begin = time.perf_counter()
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True, env=env).stdout
+    seconds = time.perf_counter() - begin
+    frames = []
+    for line in out.splitlines():
+        m = SIGROK_RE.match(line)
+        if m:
+            frames.append((int(m.group(1)) / args.samplerate, tuple(int(g, 16) for g in m.groups()[1:])))
+    return seconds, frames
+
+
+def run_pd(args, path):
+    return run_sigrok_format(args, ['sigrok-cli', '-i', path, '-P', 'ir_gree:ir=IR', '-A', 'ir_gree=frame',
+                                    '--protocol-decoder-samplenum'])
+
+
+def run_batch(args, path):
+    # 输出与sigrok-cli --protocol-decoder-samplenum相同
+    env = dict(os.environ, PYTHONPATH=os.path.join(HERE, '..', '..'))
+    return run_sigrok_format(args, [sys.executable, '-m', 'ir_gree.batch', '-s', str(args.samplerate), '-c', '0',
+                                    path], env)
+
+
+def score(truth, frames, tolerance):
+    '''两边都按时间排序，逐个找时间最近的真实帧'''
+    result = {'ok': 0, 'wrong': 0, 'spurious': 0, 'missed': 0, 'clean_ok': 0}
+    matched = [None] * len(truth)
+    i = 0
+    for t, codes in sorted(frames):
+        while i + 1 < len(truth) and abs(truth[i + 1][0] - t) <= abs(truth[i][0] - t):
+            i += 1
+        if not truth or abs(truth[i][0] - t) > tolerance or matched[i] is not None:
+            result['spurious'] += 1
+            continue
+        matched[i] = truth[i][1] == codes
+        result['ok' if matched[i] else 'wrong'] += 1
+    for (t, codes, clean), m in zip(truth, matched):
+        result['missed'] += m is None
+        result['clean_ok'] += clean and m is True
+    return result
+
+
+def report(name, decoder, size, truth, seconds, frames, args):
+    r = score(truth, frames, args.tolerance / 1000)
+    clean = sum(1 for t in truth if t[2])
+    duration = size / args.samplerate
+    print('%-8s %-10s %9.1f %9.1f %8.2f  %6d %6d %6d %6d %6d %8d/%d' % (
+        name, decoder, size / seconds / 1e6, duration / seconds, seconds, len(truth), r['ok'], r['wrong'],
+        r['spurious'], r['missed'], r['clean_ok'], clean))
+    sys.stdout.flush()
+
+
+def parse_size(text):
+    units = {'K': 1 << 10, 'M': 1 << 20, 'G': 1 << 30}
+    if text[-1:].upper() in units:
+        return int(float(text[:-1]) * units[text[-1:].upper()])
+    return int(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='gree decoder benchmark')
+    parser.add_argument('--size', default='256M', help='每种情况的抓包大小，可以超过4G')
+    parser.add_argument('--pd-size', default='16M', help='给pd.py的.sr大小，0为不测')
+    parser.add_argument('--samplerate', type=int, default=1000000)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--scenarios', default=','.join(SCENARIOS))
+    parser.add_argument('--tolerance', type=float, default=5, help='帧时间的误差，毫秒')
+    parser.add_argument('--build', default='build')
+    parser.add_argument('--work', default='bench_data', help='生成的抓包放在这里')
+    parser.add_argument('--keep', action='store_true', help='已经生成过的抓包不再生成')
+    args = parser.parse_args()
+
+    build(args.build)
+    os.makedirs(args.work, exist_ok=True)
+    run_sigrok = parse_size(args.pd_size) > 0 and shutil.which('sigrok-cli')
+    has_numpy = importlib.util.find_spec('numpy') is not None
+    if not has_numpy:
+        print('numpy not found, skipping batch', file=sys.stderr)
+    if parse_size(args.pd_size) > 0 and not run_sigrok:
+        print('sigrok-cli not found, skipping pd.py', file=sys.stderr)
+
+    print('%-8s %-10s %9s %9s %8s  %6s %6s %6s %6s %6s %10s' % (
+        'scenario', 'decoder', 'MB/s', 'realtime', 'seconds', 'frames', 'ok', 'wrong', 'spur', 'missed', 'clean ok'))
+    for name in args.scenarios.split(','):
+        path = os.path.join(args.work, name + '.bin')
+        truth = generate(args, name, path, args.size)
+        size = os.path.getsize(path)
+        for decoder, extra in (('capture', []), ('calibrate', ['--calibrate']), ('rmt', ['--rmt'])):
+            seconds, frames = run_capture(args, path, extra)
+            report(name, decoder, size, truth, seconds, frames, args)
+        if has_numpy:
+            seconds, frames = run_batch(args, path)
+            report(name, 'batch', size, truth, seconds, frames, args)
+
+        if run_sigrok:
+            path = os.path.join(args.work, name + '.sr')
+            truth = generate(args, name, path, args.pd_size)
+            seconds, frames = run_pd(args, path)
+            # .sr里的采样数与文件大小基本相同
+            report(name, 'pd', os.path.getsize(path), truth, seconds, frames, args)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,1060 @@
+/*
+ * 离线解析逻辑分析仪抓包中的格力空调红外帧
+ *
+ * 支持sigrok-cli -O binary导出的原始数据和.sr文件，文件通过mmap读取，
+ * 用SIMD找下降沿，再按ir_gree/pd.py的metadata()窗口分类并组帧。
+ *
+ *   gree_capture [-c 通道] [-s 采样率] [-u 每个采样的字节数] [--bench] [--learn] [--calibrate] [--rmt] 文件
+ *
+ * 原始数据没有采样率，需要用-s指定；.sr文件从metadata中读取。
+ * --learn按ESP32学习模式（ir_gree_learn.h）压缩每次按键的波形再展开，输出压缩率和展开后的时间误差。
+ * --calibrate先扫一遍统计周期的直方图（ir_gree_calib.h），输出学到的时长，再用学到的窗口解码。
+ * --rmt按ESP32的接收流程（RMT滤波、按空闲分段、ir_gree_decoder_feed）解码，结果应与设备上相同，不能与--learn一起用。
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifdef GREE_CAPTURE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ir_gree_calib.h"
+#include "ir_gree_decoder.h"
+#include "ir_gree_learn.h"
+#include "ir_gree_state.h"
+
+namespace
+{
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const char *path)
+    {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("cannot open ") + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error(std::string("cannot stat ") + path);
+        }
+        size_ = st.st_size;
+        if (size_ > 0)
+        {
+            void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error(std::string("cannot mmap ") + path);
+            }
+            data_ = static_cast<const uint8_t *>(p);
+            // 顺序读取，让内核提前预读
+            madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data_)
+        {
+            munmap(const_cast<uint8_t *>(data_), size_);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 与pd.py一样按下降沿到下降沿的采样数分类，窗口为开区间
+struct SampleWindows
+{
+    uint64_t leader[2];
+    uint64_t connect[2];
+    uint64_t long_connect[2];
+    uint64_t zero[2];
+    uint64_t one[2];
+
+    SampleWindows(uint64_t samplerate, const ir_gree_windows_t &w)
+    {
+        set(leader, samplerate, w.leader);
+        set(connect, samplerate, w.connect);
+        set(long_connect, samplerate, w.long_connect);
+        set(zero, samplerate, w.zero);
+        set(one, samplerate, w.one);
+    }
+
+    ir_gree_sym_t classify(uint64_t b) const
+    {
+        if (b > leader[0] && b < leader[1])
+        {
+            return IR_GREE_SYM_LEADER;
+        }
+        if (b > connect[0] && b < connect[1])
+        {
+            return IR_GREE_SYM_CONNECT;
+        }
+        if (b > long_connect[0] && b < long_connect[1])
+        {
+            return IR_GREE_SYM_LONG_CONNECT;
+        }
+        if (b > zero[0] && b < zero[1])
+        {
+            return IR_GREE_SYM_ZERO;
+        }
+        if (b > one[0] && b < one[1])
+        {
+            return IR_GREE_SYM_ONE;
+        }
+        return IR_GREE_SYM_INVALID;
+    }
+
+private:
+    // 与pd.py的int(samplerate * 0.012)取整方式相同
+    static void set(uint64_t out[2], uint64_t samplerate, const ir_gree_window_t &w)
+    {
+        out[0] = static_cast<uint64_t>(samplerate * (w.min / 1e6));
+        out[1] = static_cast<uint64_t>(samplerate * (w.max / 1e6));
+    }
+};
+
+// 收集一次按键的mark/space（us），空闲超过IR_GREE_LEARN_IDLE_US时压缩再展开，统计误差
+class LearnStats
+{
+public:
+    LearnStats(uint64_t samplerate, bool quiet) : samplerate_(samplerate), quiet_(quiet) {}
+
+    void falling_edge(uint64_t sample)
+    {
+        if (has_rise_)
+        {
+            uint32_t space = to_us(sample - rise_);
+            pulses_.push_back({clamp(to_us(rise_ - fall_)), clamp(space)});
+            if (space > IR_GREE_LEARN_IDLE_US)
+            {
+                pulses_.back().space = 0;
+                finish();
+            }
+        }
+        fall_ = sample;
+        has_fall_ = true;
+        has_rise_ = false;
+    }
+
+    void rising_edge(uint64_t sample)
+    {
+        if (has_fall_)
+        {
+            rise_ = sample;
+            has_rise_ = true;
+        }
+    }
+
+    // 输入结束，最后一个结束码后面没有下降沿
+    void flush()
+    {
+        if (has_rise_)
+        {
+            pulses_.push_back({clamp(to_us(rise_ - fall_)), 0});
+            has_rise_ = false;
+        }
+        finish();
+    }
+
+    void report() const
+    {
+        std::fprintf(stderr, "learn: %llu captures (%llu failed), %llu pulses, raw %llu bytes, compressed %llu bytes, ratio %.2f\n",
+                     static_cast<unsigned long long>(captures_), static_cast<unsigned long long>(failed_),
+                     static_cast<unsigned long long>(total_pulses_), static_cast<unsigned long long>(raw_bytes_),
+                     static_cast<unsigned long long>(compressed_bytes_),
+                     compressed_bytes_ ? static_cast<double>(raw_bytes_) / compressed_bytes_ : 0.0);
+        std::fprintf(stderr, "learn: replay timing error mean %.1f us, max %u us\n",
+                     durations_ ? static_cast<double>(error_sum_) / durations_ : 0.0, error_max_);
+    }
+
+private:
+    uint32_t to_us(uint64_t samples) const
+    {
+        return static_cast<uint32_t>(std::min<uint64_t>(samples * 1000000 / samplerate_, UINT32_MAX));
+    }
+
+    static uint16_t clamp(uint32_t us)
+    {
+        return static_cast<uint16_t>(std::min<uint32_t>(us, UINT16_MAX));
+    }
+
+    void finish()
+    {
+        if (pulses_.empty())
+        {
+            return;
+        }
+        captures_++;
+        std::vector<uint8_t> out(IR_GREE_LEARN_MAX_SIZE(pulses_.size()));
+        size_t len = 0;
+        ir_gree_learn_err_t err = ir_gree_learn_compress(pulses_.data(), pulses_.size(), out.data(), out.size(), &len);
+        if (err != IR_GREE_LEARN_OK)
+        {
+            failed_++;
+            std::printf("learn: %zu pulses, compress failed: %d\n", pulses_.size(), err);
+            pulses_.clear();
+            return;
+        }
+
+        // 展开后逐个时长比较
+        ir_gree_learn_reader_t reader;
+        ir_gree_learn_reader_init(&reader, out.data(), len);
+        ir_gree_pulse_t pulse;
+        uint32_t capture_max = 0;
+        size_t n = 0;
+        for (; n < pulses_.size() && ir_gree_learn_next(&reader, &pulse); n++)
+        {
+            for (uint32_t error : {diff(pulse.mark, pulses_[n].mark), diff(pulse.space, pulses_[n].space)})
+            {
+                error_sum_ += error;
+                capture_max = std::max(capture_max, error);
+            }
+            durations_ += 2;
+        }
+        if (n != pulses_.size())
+        {
+            throw std::runtime_error("learned frame expands to a different length");
+        }
+        error_max_ = std::max(error_max_, capture_max);
+
+        // ESP32上未压缩时每对mark/space是一个4字节的RMT符号
+        size_t raw = pulses_.size() * 4;
+        total_pulses_ += pulses_.size();
+        raw_bytes_ += raw;
+        compressed_bytes_ += len;
+        if (!quiet_)
+        {
+            std::printf("learn: %zu pulses, %zu -> %zu bytes (%.2fx), dict %u/%u, max error %u us\n", pulses_.size(), raw, len,
+                        static_cast<double>(raw) / len, out[2], out[3], capture_max);
+        }
+        pulses_.clear();
+    }
+
+    static uint32_t diff(uint16_t a, uint16_t b)
+    {
+        return a > b ? a - b : b - a;
+    }
+
+    uint64_t samplerate_;
+    bool quiet_;
+    std::vector<ir_gree_pulse_t> pulses_;
+    bool has_fall_ = false;
+    bool has_rise_ = false;
+    uint64_t fall_ = 0;
+    uint64_t rise_ = 0;
+    uint64_t captures_ = 0;
+    uint64_t failed_ = 0;
+    uint64_t total_pulses_ = 0;
+    uint64_t raw_bytes_ = 0;
+    uint64_t compressed_bytes_ = 0;
+    uint64_t error_sum_ = 0;
+    uint64_t durations_ = 0;
+    uint32_t error_max_ = 0;
+};
+
+void print_frame(double seconds, const ir_gree_scan_code_t &scan_code)
+{
+    gree_state_t state;
+    std::printf("%.6f s: %08x %08x %08x %08x", seconds,
+                static_cast<unsigned>(scan_code.data1), static_cast<unsigned>(scan_code.data2),
+                static_cast<unsigned>(scan_code.data3), static_cast<unsigned>(scan_code.data4));
+    if (gree_state_unpack(&scan_code, &state))
+    {
+        std::printf(" power=%d mode=%d temp=%d fan=%d swing=%d light=%d turbo=%d sleep=%d timer=%d\n",
+                    state.power, state.mode, state.temperature, state.fan, state.swing,
+                    state.light, state.turbo, state.sleep, state.timer);
+    }
+    else
+    {
+        std::printf(" checksum mismatch\n");
+    }
+}
+
+class FrameDecoder
+{
+public:
+    FrameDecoder(uint64_t samplerate, const ir_gree_windows_t &windows, bool quiet, LearnStats *learn,
+                 ir_gree_calib_t *calib = nullptr)
+        : samplerate_(samplerate), windows_(samplerate, windows), quiet_(quiet), learn_(learn), calib_(calib)
+    {
+        ir_gree_decoder_init(&decoder_, &windows);
+    }
+
+    void rising_edge(uint64_t sample)
+    {
+        if (learn_)
+        {
+            learn_->rising_edge(sample);
+        }
+    }
+
+    void falling_edge(uint64_t sample)
+    {
+        if (learn_)
+        {
+            learn_->falling_edge(sample);
+        }
+        if (!has_start_)
+        {
+            has_start_ = true;
+            start_ = sample;
+            return;
+        }
+
+        if (calib_)
+        {
+            ir_gree_calib_add(calib_, std::min<uint64_t>((sample - start_) * 1000000 / samplerate_, UINT32_MAX));
+        }
+        ir_gree_sym_t sym = windows_.classify(sample - start_);
+        ir_gree_scan_code_t scan_code;
+        bool done = ir_gree_decoder_feed_symbol(&decoder_, sym, &scan_code);
+        // 解码器从第一段重新开始的引导码是一帧的开始
+        if (sym == IR_GREE_SYM_LEADER && decoder_.segment == 0)
+        {
+            frame_start_ = start_;
+        }
+        if (done)
+        {
+            frames_++;
+            if (!quiet_)
+            {
+                print_frame(static_cast<double>(frame_start_) / samplerate_, scan_code);
+            }
+        }
+        start_ = sample;
+        edges_++;
+    }
+
+    uint64_t frames() const { return frames_; }
+    uint64_t edges() const { return edges_; }
+
+private:
+    uint64_t samplerate_;
+    SampleWindows windows_;
+    bool quiet_;
+    LearnStats *learn_;
+    ir_gree_calib_t *calib_;
+    ir_gree_decoder_t decoder_;
+    bool has_start_ = false;
+    uint64_t start_ = 0;
+    uint64_t frame_start_ = 0;
+    uint64_t frames_ = 0;
+    uint64_t edges_ = 0;
+};
+
+// 按ESP32的接收流程解码：RMT滤掉短脉冲，空闲超过signal_range_max结束一次接收，
+// 每次接收最多IR_RX_BUFFER_SYMBOLS个符号，两次接收间隔太久时解码器重新开始，参数与esp32/main/main.c相同
+#define RMT_SIGNAL_RANGE_MIN_NS 1250
+#define RMT_SIGNAL_RANGE_MAX_NS (25 * 1000 * 1000)
+#define RMT_BUFFER_SYMBOLS 128
+#define RMT_FRAME_TIMEOUT_US (200 * 1000)
+
+class RmtDecoder
+{
+public:
+    RmtDecoder(uint64_t samplerate, const ir_gree_windows_t &windows, bool quiet)
+        : samplerate_(samplerate), windows_(windows), quiet_(quiet),
+          min_samples_(std::ceil(samplerate * (RMT_SIGNAL_RANGE_MIN_NS / 1e9))),
+          idle_samples_(samplerate * (RMT_SIGNAL_RANGE_MAX_NS / 1e9))
+    {
+        ir_gree_decoder_init(&decoder_, &windows_);
+        symbols_.reserve(RMT_BUFFER_SYMBOLS);
+    }
+
+    void rising_edge(uint64_t sample) { edge(1, sample); }
+    void falling_edge(uint64_t sample) { edge(0, sample); }
+
+    // 文件结束时的空闲也算接收结束
+    void flush()
+    {
+        if (has_pending_)
+        {
+            commit(pending_level_, pending_);
+            has_pending_ = false;
+        }
+        finish();
+    }
+
+    uint64_t frames() const { return frames_; }
+    uint64_t edges() const { return edges_; }
+
+private:
+    struct Symbol
+    {
+        uint64_t start;
+        uint32_t mark;
+        uint32_t space;
+    };
+
+    // 边沿先挂起，下一个边沿离它不到signal_range_min时两个都丢掉
+    void edge(unsigned level, uint64_t sample)
+    {
+        if (has_pending_ && sample - pending_ < min_samples_)
+        {
+            has_pending_ = false;
+            return;
+        }
+        if (has_pending_)
+        {
+            commit(pending_level_, pending_);
+        }
+        has_pending_ = true;
+        pending_ = sample;
+        pending_level_ = level;
+    }
+
+    uint32_t us(uint64_t samples) const
+    {
+        return static_cast<uint32_t>(std::min<uint64_t>(samples * 1000000 / samplerate_, UINT32_MAX));
+    }
+
+    void commit(unsigned level, uint64_t sample)
+    {
+        // 滤掉毛刺后可能出现同一电平的两个边沿
+        if ((level == 0) == low_)
+        {
+            return;
+        }
+        low_ = level == 0;
+        if (low_)
+        {
+            edges_++;
+            // 高电平太久，上一次接收已经结束
+            if (receiving_ && sample - rise_ > idle_samples_)
+            {
+                finish();
+            }
+            if (receiving_ && symbols_.size() < RMT_BUFFER_SYMBOLS)
+            {
+                symbols_.push_back({fall_, us(rise_ - fall_), us(sample - rise_)});
+            }
+            receiving_ = true;
+            fall_ = sample;
+        }
+        else
+        {
+            rise_ = sample;
+        }
+    }
+
+    void finish()
+    {
+        if (!receiving_)
+        {
+            return;
+        }
+        receiving_ = false;
+        // 最后一个mark后面没有下降沿，space为0
+        if (symbols_.size() < RMT_BUFFER_SYMBOLS)
+        {
+            symbols_.push_back({fall_, us(rise_ - fall_), 0});
+        }
+        uint64_t done = rise_ + idle_samples_;
+        if (us(done - last_done_) > RMT_FRAME_TIMEOUT_US)
+        {
+            ir_gree_decoder_init(&decoder_, &windows_);
+        }
+        last_done_ = done;
+
+        for (const Symbol &symbol : symbols_)
+        {
+            ir_gree_sym_t sym = symbol.space ? ir_gree_classify(&windows_, symbol.mark + symbol.space) : IR_GREE_SYM_END;
+            ir_gree_scan_code_t scan_code;
+            bool done_frame = ir_gree_decoder_feed_symbol(&decoder_, sym, &scan_code);
+            if (sym == IR_GREE_SYM_LEADER && decoder_.segment == 0)
+            {
+                frame_start_ = symbol.start;
+            }
+            if (done_frame)
+            {
+                frames_++;
+                if (!quiet_)
+                {
+                    print_frame(static_cast<double>(frame_start_) / samplerate_, scan_code);
+                }
+            }
+        }
+        symbols_.clear();
+    }
+
+    uint64_t samplerate_;
+    ir_gree_windows_t windows_;
+    bool quiet_;
+    uint64_t min_samples_;
+    uint64_t idle_samples_;
+    ir_gree_decoder_t decoder_;
+    std::vector<Symbol> symbols_;
+    bool has_pending_ = false;
+    uint64_t pending_ = 0;
+    unsigned pending_level_ = 1;
+    bool low_ = false;
+    bool receiving_ = false;
+    uint64_t fall_ = 0;
+    uint64_t rise_ = 0;
+    uint64_t last_done_ = 0;
+    uint64_t frame_start_ = 0;
+    uint64_t frames_ = 0;
+    uint64_t edges_ = 0;
+};
+
+// 逐块输入采样，数据可以分多次给出（.sr的多个chunk）
+template <typename Decoder>
+class EdgeDetector
+{
+public:
+    EdgeDetector(unsigned channel, unsigned unitsize, Decoder &decoder)
+        : byte_(channel / 8), bit_(channel % 8), unitsize_(unitsize), decoder_(decoder)
+    {
+    }
+
+    void feed(const uint8_t *data, size_t len)
+    {
+        // 上一块剩下的不完整采样
+        size_t i = 0;
+        if (partial_len_)
+        {
+            while (partial_len_ < unitsize_ && partial_len_ < sizeof(partial_) && i < len)
+            {
+                partial_[partial_len_++] = data[i++];
+            }
+            if (partial_len_ < unitsize_)
+            {
+                return;
+            }
+            scalar(partial_, 1);
+            partial_len_ = 0;
+        }
+
+        size_t samples = (len - i) / unitsize_;
+        if (unitsize_ == 1)
+        {
+            simd(data + i, samples);
+        }
+        else
+        {
+            scalar(data + i, samples);
+        }
+        i += samples * unitsize_;
+
+        while (i < len && partial_len_ < sizeof(partial_))
+        {
+            partial_[partial_len_++] = data[i++];
+        }
+    }
+
+    uint64_t samples() const { return sample_; }
+
+private:
+    // 下降沿用于解码，上升沿只在--learn时需要
+    void edge(unsigned level, uint64_t sample)
+    {
+        if (level)
+        {
+            decoder_.rising_edge(sample);
+        }
+        else
+        {
+            decoder_.falling_edge(sample);
+        }
+    }
+
+    void scalar(const uint8_t *data, size_t samples)
+    {
+        for (size_t n = 0; n < samples; n++)
+        {
+            unsigned level = (data[n * unitsize_ + byte_] >> bit_) & 1;
+            if (prev_ != level)
+            {
+                edge(level, sample_ + n);
+            }
+            prev_ = level;
+        }
+        sample_ += samples;
+    }
+
+    // levels的第j位为第j个采样的电平，prev_为前一个采样的电平
+    template <typename Mask>
+    void edges(Mask levels, unsigned width, uint64_t base)
+    {
+        Mask shifted = static_cast<Mask>((levels << 1) | prev_);
+        Mask changes = shifted ^ levels;
+        if (width < sizeof(Mask) * 8)
+        {
+            changes &= (static_cast<Mask>(1) << width) - 1;
+        }
+        while (changes)
+        {
+            unsigned j = __builtin_ctzll(changes);
+            edge((levels >> j) & 1, base + j);
+            changes &= changes - 1;
+        }
+        prev_ = (levels >> (width - 1)) & 1;
+    }
+
+    void simd(const uint8_t *data, size_t samples)
+    {
+        size_t n = 0;
+#if defined(__AVX2__)
+        for (; n + 32 <= samples; n += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + n));
+            // 把通道位移到每个字节的最高位，再取出32个采样的电平
+            uint32_t levels = _mm256_movemask_epi8(_mm256_slli_epi16(v, 7 - bit_));
+            edges<uint32_t>(levels, 32, sample_ + n);
+        }
+#elif defined(__SSE2__)
+        for (; n + 16 <= samples; n += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + n));
+            uint16_t levels = _mm_movemask_epi8(_mm_slli_epi16(v, 7 - bit_));
+            edges<uint32_t>(levels, 16, sample_ + n);
+        }
+#endif
+        sample_ += n;
+        scalar(data + n, samples - n);
+    }
+
+    unsigned byte_;
+    unsigned bit_;
+    unsigned unitsize_;
+    Decoder &decoder_;
+    uint64_t sample_ = 0;
+    uint32_t prev_ = 1; // 空闲为高电平
+    uint8_t partial_[8] = {};
+    unsigned partial_len_ = 0;
+};
+
+struct Options
+{
+    const char *path = nullptr;
+    unsigned channel = 0;
+    uint64_t samplerate = 0;
+    unsigned unitsize = 1;
+    bool bench = false;
+    bool learn = false;
+    bool calibrate = false;
+    bool rmt = false;
+};
+
+// sigrok的samplerate写成"1 MHz"、"500 kHz"这样的形式
+uint64_t parse_samplerate(const std::string &text)
+{
+    char *end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    std::string unit(end);
+    unit.erase(std::remove(unit.begin(), unit.end(), ' '), unit.end());
+    if (unit == "kHz")
+    {
+        value *= 1e3;
+    }
+    else if (unit == "MHz")
+    {
+        value *= 1e6;
+    }
+    else if (unit == "GHz")
+    {
+        value *= 1e9;
+    }
+    return static_cast<uint64_t>(value);
+}
+
+// .sr文件：zip中的metadata和logic-1-1、logic-1-2……
+class SrArchive
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        uint16_t method;
+        const uint8_t *data;
+        size_t compressed_size;
+        size_t size;
+    };
+
+    explicit SrArchive(const MappedFile &file)
+    {
+        const uint8_t *base = file.data();
+        size_t size = file.size();
+        // 从文件末尾找中央目录结束记录
+        size_t eocd = size >= 22 ? size - 22 : 0;
+        while (eocd > 0 && le32(base + eocd) != 0x06054b50)
+        {
+            eocd--;
+        }
+        if (size < 22 || le32(base + eocd) != 0x06054b50)
+        {
+            throw std::runtime_error("not a zip archive");
+        }
+        size_t count = le16(base + eocd + 10);
+        size_t offset = le32(base + eocd + 16);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t *cd = base + offset;
+            if (offset + 46 > size || le32(cd) != 0x02014b50)
+            {
+                throw std::runtime_error("broken zip central directory");
+            }
+            Entry entry;
+            entry.method = le16(cd + 10);
+            entry.compressed_size = le32(cd + 20);
+            entry.size = le32(cd + 24);
+            size_t name_len = le16(cd + 28);
+            size_t extra_len = le16(cd + 30);
+            size_t comment_len = le16(cd + 32);
+            size_t local = le32(cd + 42);
+            entry.name.assign(reinterpret_cast<const char *>(cd + 46), name_len);
+            const uint8_t *lh = base + local;
+            entry.data = lh + 30 + le16(lh + 26) + le16(lh + 28);
+            if (entry.data + entry.compressed_size > base + size)
+            {
+                throw std::runtime_error("broken zip entry " + entry.name);
+            }
+            entries_.push_back(entry);
+            offset += 46 + name_len + extra_len + comment_len;
+        }
+    }
+
+    const Entry *find(const std::string &name) const
+    {
+        for (const Entry &entry : entries_)
+        {
+            if (entry.name == name)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // 采样数据分成logic-1-1、logic-1-2……，按序号排序
+    std::vector<const Entry *> logic_chunks() const
+    {
+        std::vector<std::pair<long, const Entry *>> chunks;
+        for (const Entry &entry : entries_)
+        {
+            if (entry.name.rfind("logic-1-", 0) == 0)
+            {
+                chunks.emplace_back(std::strtol(entry.name.c_str() + 8, nullptr, 10), &entry);
+            }
+            else if (entry.name == "logic-1")
+            {
+                chunks.emplace_back(0, &entry);
+            }
+        }
+        std::sort(chunks.begin(), chunks.end());
+        std::vector<const Entry *> result;
+        for (auto &chunk : chunks)
+        {
+            result.push_back(chunk.second);
+        }
+        return result;
+    }
+
+    // 解压一个条目，每解出一块就回调一次，存储方式的条目直接使用mmap的数据
+    template <typename Sink>
+    static void read(const Entry &entry, Sink sink)
+    {
+        if (entry.method == 0)
+        {
+            sink(entry.data, entry.size);
+            return;
+        }
+#ifdef GREE_CAPTURE_HAS_ZLIB
+        if (entry.method == 8)
+        {
+            std::vector<uint8_t> out(1 << 20);
+            z_stream zs = {};
+            if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+            {
+                throw std::runtime_error("inflateInit2 failed");
+            }
+            zs.next_in = const_cast<Bytef *>(entry.data);
+            zs.avail_in = entry.compressed_size;
+            int ret;
+            do
+            {
+                zs.next_out = out.data();
+                zs.avail_out = out.size();
+                ret = inflate(&zs, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END)
+                {
+                    inflateEnd(&zs);
+                    throw std::runtime_error("inflate failed in " + entry.name);
+                }
+                sink(out.data(), out.size() - zs.avail_out);
+            } while (ret != Z_STREAM_END);
+            inflateEnd(&zs);
+            return;
+        }
+#endif
+        throw std::runtime_error("unsupported compression in " + entry.name);
+    }
+
+private:
+    static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+    static uint32_t le32(const uint8_t *p) { return le16(p) | (static_cast<uint32_t>(le16(p + 2)) << 16); }
+
+    std::vector<Entry> entries_;
+};
+
+void apply_sr_metadata(const SrArchive &archive, Options &options)
+{
+    const SrArchive::Entry *entry = archive.find("metadata");
+    if (!entry)
+    {
+        throw std::runtime_error("metadata not found in .sr file");
+    }
+    std::string text;
+    SrArchive::read(*entry, [&](const uint8_t *data, size_t len) {
+        text.append(reinterpret_cast<const char *>(data), len);
+    });
+
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos)
+        {
+            continue;
+        }
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "samplerate" && options.samplerate == 0)
+        {
+            options.samplerate = parse_samplerate(value);
+        }
+        else if (key == "unitsize")
+        {
+            options.unitsize = std::strtoul(value.c_str(), nullptr, 10);
+        }
+    }
+}
+
+bool ends_with(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void usage()
+{
+    std::fprintf(stderr, "usage: gree_capture [-c channel] [-s samplerate] [-u unitsize] [--bench] [--learn] [--calibrate] [--rmt] file\n");
+}
+
+void print_calibration(const ir_gree_calib_t &calib, const ir_gree_calib_stat_t *stats, bool ok)
+{
+    static const char *const names[IR_GREE_CALIB_CLASS_NUM] = {"zero", "one", "leader", "connect", "long connect"};
+    std::fprintf(stderr, "calibration %s: %u periods, %u out of range\n", ok ? "done" : "failed, using default windows",
+                 static_cast<unsigned>(calib.total), static_cast<unsigned>(calib.outliers));
+    for (int k = 0; k < IR_GREE_CALIB_CLASS_NUM; k++)
+    {
+        std::fprintf(stderr, "  %-12s %6u  %8.3f ms  window %u-%u us\n", names[k], static_cast<unsigned>(stats[k].count),
+                     stats[k].center / 1e3, static_cast<unsigned>(stats[k].window.min),
+                     static_cast<unsigned>(stats[k].window.max));
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc)
+        {
+            options.channel = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "-s" && i + 1 < argc)
+        {
+            options.samplerate = parse_samplerate(argv[++i]);
+        }
+        else if (arg == "-u" && i + 1 < argc)
+        {
+            options.unitsize = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--bench")
+        {
+            options.bench = true;
+        }
+        else if (arg == "--learn")
+        {
+            options.learn = true;
+        }
+        else if (arg == "--calibrate")
+        {
+            options.calibrate = true;
+        }
+        else if (arg == "--rmt")
+        {
+            options.rmt = true;
+        }
+        else if (!options.path && arg[0] != '-')
+        {
+            options.path = argv[i];
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (!options.path)
+    {
+        usage();
+        return 2;
+    }
+
+    try
+    {
+        MappedFile file(options.path);
+        bool is_sr = ends_with(options.path, ".sr");
+        std::unique_ptr<SrArchive> archive;
+        if (is_sr)
+        {
+            archive.reset(new SrArchive(file));
+            apply_sr_metadata(*archive, options);
+        }
+        if (options.samplerate == 0)
+        {
+            throw std::runtime_error("samplerate unknown, use -s");
+        }
+        if (options.unitsize == 0 || options.unitsize > 8 || options.channel >= options.unitsize * 8)
+        {
+            throw std::runtime_error("invalid unitsize or channel");
+        }
+        if (options.rmt && options.learn)
+        {
+            throw std::runtime_error("--learn is not supported with --rmt");
+        }
+
+        // 把整个文件的采样交给detector，返回字节数
+        auto scan = [&](auto &detector) {
+            uint64_t bytes = 0;
+            if (archive)
+            {
+                for (const SrArchive::Entry *entry : archive->logic_chunks())
+                {
+                    SrArchive::read(*entry, [&](const uint8_t *data, size_t len) {
+                        detector.feed(data, len);
+                        bytes += len;
+                    });
+                }
+            }
+            else
+            {
+                detector.feed(file.data(), file.size());
+                bytes = file.size();
+            }
+            return bytes;
+        };
+
+        ir_gree_windows_t windows = ir_gree_default_windows;
+        if (options.calibrate)
+        {
+            ir_gree_calib_t calib;
+            ir_gree_calib_stat_t stats[IR_GREE_CALIB_CLASS_NUM];
+            ir_gree_calib_init(&calib);
+            FrameDecoder calib_decoder(options.samplerate, windows, true, nullptr, &calib);
+            EdgeDetector<FrameDecoder> calib_detector(options.channel, options.unitsize, calib_decoder);
+            scan(calib_detector);
+            bool ok = ir_gree_calib_solve(&calib, &windows, stats);
+            print_calibration(calib, stats, ok);
+        }
+
+        std::unique_ptr<LearnStats> learn;
+        if (options.learn)
+        {
+            learn.reset(new LearnStats(options.samplerate, options.bench));
+        }
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t bytes = 0;
+        uint64_t samples = 0;
+        uint64_t edges = 0;
+        uint64_t frames = 0;
+        if (options.rmt)
+        {
+            RmtDecoder decoder(options.samplerate, windows, options.bench);
+            EdgeDetector<RmtDecoder> detector(options.channel, options.unitsize, decoder);
+            bytes = scan(detector);
+            decoder.flush();
+            samples = detector.samples();
+            edges = decoder.edges();
+            frames = decoder.frames();
+        }
+        else
+        {
+            FrameDecoder decoder(options.samplerate, windows, options.bench, learn.get());
+            EdgeDetector<FrameDecoder> detector(options.channel, options.unitsize, decoder);
+            bytes = scan(detector);
+            if (learn)
+            {
+                learn->flush();
+            }
+            samples = detector.samples();
+            edges = decoder.edges();
+            frames = decoder.frames();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        std::fprintf(stderr, "%llu samples, %llu edges, %llu frames\n", static_cast<unsigned long long>(samples),
+                     static_cast<unsigned long long>(edges), static_cast<unsigned long long>(frames));
+        if (learn)
+        {
+            learn->report();
+        }
+        if (options.bench)
+        {
+            std::printf("%llu bytes in %.3f s: %.3f GB/s\n", static_cast<unsigned long long>(bytes), seconds,
+                        seconds > 0 ? bytes / seconds / 1e9 : 0.0);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "gree_capture: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,627 @@
+/*
+ * 生成格力空调红外帧的逻辑分析仪数据，用来测试各个解码器
+ *
+ *   gree_gen [-s 采样率] [--frames 帧数 | --size 字节数] [--gap 毫秒] [--seed 种子]
+ *            [--jitter 微秒] [--scale 倍数] [--carrier 频率] [--glitches 每秒个数] [--drop 概率] -o 输出文件
+ *
+ * 状态随机生成，用ir_gree_frame_render渲染成mark/space，与ESP32发射的完全相同。
+ * 输出文件以.sr结尾时写sigrok的.sr（zip，不压缩），否则与sigrok-cli -O binary相同，每个采样1字节。
+ * 通道0为接收头输出，空闲为高电平；加上--carrier时通道1为发射管的载波，占空比1/3。
+ *
+ * --jitter   每个边沿在±微秒内随机偏移
+ * --scale    所有时长乘以这个倍数，模拟遥控器时钟偏差
+ * --glitches 平均每秒的毛刺数，毛刺为1~20us的反向脉冲
+ * --drop     每个脉冲被接收头漏掉的概率
+ *
+ * 每一帧引导码下降沿的时间和扫描码写在<输出文件>.frames中，帧内有毛刺或者漏掉的脉冲时标记为impaired。
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include "ir_gree_frame.h"
+#include "ir_gree_state.h"
+
+namespace
+{
+
+// 帧前面的空闲
+#define GEN_LEAD_IN_US 5000
+#define GEN_GLITCH_MAX_US 20
+// 边沿偏移不能超过最短的mark/space的一半，否则边沿会交叉
+#define GEN_JITTER_MAX_US 250
+// .sr中每个logic-1-N的大小，与sigrok相同
+#define GEN_SR_CHUNK_SIZE (4 << 20)
+// zip的修改时间，DOS格式的1980-01-01
+#define GEN_ZIP_DATE 0x0021u
+#define GEN_CH_IR 0x01
+#define GEN_CH_CARRIER 0x02
+
+struct Options
+{
+    const char *path = nullptr;
+    uint64_t samplerate = 1000000;
+    uint64_t frames = 100;
+    uint64_t size = 0;
+    double gap_ms = 100;
+    uint64_t seed = 1;
+    double jitter_us = 0;
+    double scale = 1.0;
+    double carrier_hz = 0;
+    double glitches = 0;
+    double drop = 0;
+};
+
+class Crc32
+{
+public:
+    Crc32()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table_[i] = c;
+        }
+    }
+
+    uint32_t operator()(const uint8_t *data, size_t len) const
+    {
+        uint32_t c = 0xFFFFFFFF;
+        for (size_t i = 0; i < len; i++)
+        {
+            c = table_[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        }
+        return c ^ 0xFFFFFFFF;
+    }
+
+private:
+    uint32_t table_[256];
+};
+
+class Output
+{
+public:
+    virtual ~Output() = default;
+    virtual void write(const uint8_t *data, size_t len) = 0;
+    virtual void finish() {}
+};
+
+class RawOutput : public Output
+{
+public:
+    explicit RawOutput(const char *path) : file_(std::fopen(path, "wb"))
+    {
+        if (!file_)
+        {
+            throw std::runtime_error(std::string("cannot create ") + path);
+        }
+    }
+
+    ~RawOutput() override
+    {
+        if (file_)
+        {
+            std::fclose(file_);
+        }
+    }
+
+    void write(const uint8_t *data, size_t len) override
+    {
+        if (std::fwrite(data, 1, len, file_) != len)
+        {
+            throw std::runtime_error("write failed");
+        }
+    }
+
+    void finish() override
+    {
+        if (std::fclose(file_) != 0)
+        {
+            file_ = nullptr;
+            throw std::runtime_error("write failed");
+        }
+        file_ = nullptr;
+    }
+
+private:
+    std::FILE *file_;
+};
+
+// 只写不压缩的zip条目，没有zip64，总大小不能超过4GB
+class SrOutput : public Output
+{
+public:
+    SrOutput(const char *path, uint64_t samplerate, bool carrier) : raw_(path)
+    {
+        add("version", "2");
+        std::string metadata = "[global]\nsigrok version=0.5.2\n\n[device 1]\ncapturefile=logic-1\n";
+        metadata += carrier ? "total probes=2\n" : "total probes=1\n";
+        metadata += "samplerate=" + samplerate_text(samplerate) + "\n";
+        metadata += "total analog=0\nprobe1=IR\n";
+        metadata += carrier ? "probe2=LED\n" : "";
+        metadata += "unitsize=1\n";
+        add("metadata", metadata);
+        chunk_.reserve(GEN_SR_CHUNK_SIZE);
+    }
+
+    void write(const uint8_t *data, size_t len) override
+    {
+        while (len > 0)
+        {
+            size_t n = std::min(len, GEN_SR_CHUNK_SIZE - chunk_.size());
+            chunk_.insert(chunk_.end(), data, data + n);
+            data += n;
+            len -= n;
+            if (chunk_.size() == GEN_SR_CHUNK_SIZE)
+            {
+                flush_chunk();
+            }
+        }
+    }
+
+    void finish() override
+    {
+        flush_chunk();
+        uint64_t cd_offset = offset_;
+        std::vector<uint8_t> cd;
+        for (const Entry &entry : entries_)
+        {
+            put32(cd, 0x02014b50);
+            put16(cd, 20);
+            put16(cd, 20);
+            put16(cd, 0);
+            put16(cd, 0);
+            put32(cd, GEN_ZIP_DATE << 16);
+            put32(cd, entry.crc);
+            put32(cd, entry.size);
+            put32(cd, entry.size);
+            put16(cd, entry.name.size());
+            put32(cd, 0); // extra和comment长度
+            put32(cd, 0); // 磁盘号和内部属性
+            put32(cd, 0);
+            put32(cd, entry.offset);
+            cd.insert(cd.end(), entry.name.begin(), entry.name.end());
+        }
+        std::vector<uint8_t> eocd;
+        put32(eocd, 0x06054b50);
+        put32(eocd, 0);
+        put16(eocd, entries_.size());
+        put16(eocd, entries_.size());
+        put32(eocd, cd.size());
+        put32(eocd, cd_offset);
+        put16(eocd, 0);
+        if (cd_offset + cd.size() > UINT32_MAX || entries_.size() > UINT16_MAX)
+        {
+            throw std::runtime_error(".sr larger than 4GB, use raw output");
+        }
+        raw_.write(cd.data(), cd.size());
+        raw_.write(eocd.data(), eocd.size());
+        raw_.finish();
+    }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        uint32_t crc;
+        uint32_t size;
+        uint64_t offset;
+    };
+
+    static std::string samplerate_text(uint64_t samplerate)
+    {
+        if (samplerate % 1000000 == 0)
+        {
+            return std::to_string(samplerate / 1000000) + " MHz";
+        }
+        if (samplerate % 1000 == 0)
+        {
+            return std::to_string(samplerate / 1000) + " kHz";
+        }
+        return std::to_string(samplerate) + " Hz";
+    }
+
+    static void put16(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back(value);
+        out.push_back(value >> 8);
+    }
+
+    static void put32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        put16(out, value);
+        put16(out, value >> 16);
+    }
+
+    void add(const std::string &name, const std::string &text)
+    {
+        add(name, reinterpret_cast<const uint8_t *>(text.data()), text.size());
+    }
+
+    void add(const std::string &name, const uint8_t *data, size_t len)
+    {
+        if (offset_ > UINT32_MAX)
+        {
+            throw std::runtime_error(".sr larger than 4GB, use raw output");
+        }
+        Entry entry = {name, crc_(data, len), static_cast<uint32_t>(len), offset_};
+        std::vector<uint8_t> header;
+        put32(header, 0x04034b50);
+        put16(header, 20);
+        put16(header, 0);
+        put16(header, 0); // 不压缩
+        put32(header, GEN_ZIP_DATE << 16);
+        put32(header, entry.crc);
+        put32(header, entry.size);
+        put32(header, entry.size);
+        put16(header, name.size());
+        put16(header, 0);
+        header.insert(header.end(), name.begin(), name.end());
+        raw_.write(header.data(), header.size());
+        raw_.write(data, len);
+        offset_ += header.size() + len;
+        entries_.push_back(entry);
+    }
+
+    void flush_chunk()
+    {
+        if (chunk_.empty())
+        {
+            return;
+        }
+        add("logic-1-" + std::to_string(++chunks_), chunk_.data(), chunk_.size());
+        chunk_.clear();
+    }
+
+    RawOutput raw_;
+    Crc32 crc_;
+    std::vector<Entry> entries_;
+    std::vector<uint8_t> chunk_;
+    uint64_t offset_ = 0;
+    unsigned chunks_ = 0;
+};
+
+// 边沿之后的电平，时间为绝对时间，单位us
+struct Edge
+{
+    double us;
+    uint8_t level;
+
+    bool operator<(const Edge &other) const { return us < other.us; }
+};
+
+class Generator
+{
+public:
+    Generator(const Options &options, Output &output, std::FILE *truth)
+        : options_(options), output_(output), truth_(truth), rng_(options.seed)
+    {
+    }
+
+    // 生成一帧和它后面的空闲，返回写入的采样数
+    uint64_t frame()
+    {
+        gree_state_t state = random_state();
+        ir_gree_scan_code_t scan_code;
+        ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+        gree_state_pack(&state, &scan_code);
+        size_t count = ir_gree_frame_render(&scan_code, pulses);
+
+        double slot_start = now_us_;
+        double t = slot_start + GEN_LEAD_IN_US;
+        bool impaired = false;
+        marks_.clear();
+        edges_.clear();
+        std::uniform_real_distribution<double> jitter(-options_.jitter_us, options_.jitter_us);
+        std::bernoulli_distribution drop(options_.drop);
+        for (size_t i = 0; i < count; i++)
+        {
+            double mark_end = t + pulses[i].mark * options_.scale;
+            marks_.push_back({t, mark_end});
+            if (options_.drop > 0 && drop(rng_))
+            {
+                impaired = true;
+            }
+            else
+            {
+                edges_.push_back({t + jitter(rng_), 0});
+                edges_.push_back({mark_end + jitter(rng_), GEN_CH_IR});
+            }
+            t += (pulses[i].mark + pulses[i].space) * options_.scale;
+        }
+        double frame_start = edges_.empty() ? marks_.front().first : edges_.front().us;
+        double frame_end = t + options_.jitter_us;
+        double slot_end = t + options_.gap_ms * 1000;
+        impaired |= add_glitches(slot_start, slot_end, frame_start, frame_end);
+
+        std::fprintf(truth_, "%.6f %08x %08x %08x %08x %s\n", frame_start / 1e6,
+                     static_cast<unsigned>(scan_code.data1), static_cast<unsigned>(scan_code.data2),
+                     static_cast<unsigned>(scan_code.data3), static_cast<unsigned>(scan_code.data4),
+                     impaired ? "impaired" : "ok");
+        now_us_ = slot_end;
+        return render(slot_start, slot_end);
+    }
+
+private:
+    gree_state_t random_state()
+    {
+        gree_state_t state = {};
+        state.power = rng_() % 2;
+        state.mode = rng_() % 5;
+        state.temperature = GREE_TEMP_MIN + rng_() % (GREE_TEMP_MAX - GREE_TEMP_MIN + 1);
+        state.fan = rng_() % 4;
+        state.swing = rng_() % 2;
+        state.light = rng_() % 2;
+        state.turbo = rng_() % 2;
+        state.sleep = rng_() % 2;
+        state.timer = rng_() % 4 == 0 ? rng_() % (GREE_TIMER_MAX + 1) : 0;
+        return state;
+    }
+
+    // 在一段电平中间插入反向的短脉冲，返回是否有毛刺落在帧内
+    bool add_glitches(double slot_start, double slot_end, double frame_start, double frame_end)
+    {
+        if (options_.glitches <= 0)
+        {
+            return false;
+        }
+        std::exponential_distribution<double> interval(options_.glitches / 1e6);
+        std::uniform_real_distribution<double> width(1, GEN_GLITCH_MAX_US);
+        double margin = 2e6 / options_.samplerate;
+        bool impaired = false;
+        std::vector<Edge> glitches;
+        for (double t = slot_start + interval(rng_); t < slot_end; t += interval(rng_))
+        {
+            double end = t + width(rng_);
+            // 毛刺不能跨过真实的边沿
+            auto next = std::upper_bound(edges_.begin(), edges_.end(), Edge{t, 0});
+            if ((next != edges_.end() && next->us < end + margin) || (next != edges_.begin() && (next - 1)->us > t - margin))
+            {
+                continue;
+            }
+            uint8_t level = next == edges_.begin() ? GEN_CH_IR : (next - 1)->level;
+            glitches.push_back({t, static_cast<uint8_t>(level ^ GEN_CH_IR)});
+            glitches.push_back({end, level});
+            impaired |= end > frame_start - 1000 && t < frame_end;
+        }
+        edges_.insert(edges_.end(), glitches.begin(), glitches.end());
+        std::sort(edges_.begin(), edges_.end());
+        return impaired;
+    }
+
+    uint64_t sample_at(double us) const
+    {
+        return static_cast<uint64_t>(std::llround(us * options_.samplerate / 1e6));
+    }
+
+    uint64_t render(double slot_start, double slot_end)
+    {
+        uint64_t first = sample_at(slot_start);
+        uint64_t last = sample_at(slot_end);
+        buffer_.assign(last - first, GEN_CH_IR);
+
+        uint8_t level = GEN_CH_IR;
+        uint64_t from = first;
+        for (const Edge &edge : edges_)
+        {
+            uint64_t to = std::min(std::max(sample_at(edge.us), from), last);
+            std::memset(buffer_.data() + (from - first), level, to - from);
+            level = edge.level;
+            from = to;
+        }
+        std::memset(buffer_.data() + (from - first), level, last - from);
+
+        // 载波按发射的时长，不受接收头的偏移和漏码影响
+        if (options_.carrier_hz > 0)
+        {
+            double period = options_.samplerate / options_.carrier_hz;
+            for (const auto &mark : marks_)
+            {
+                uint64_t start = sample_at(mark.first);
+                uint64_t end = std::min(sample_at(mark.second), last);
+                for (uint64_t i = start; i < end; i++)
+                {
+                    if (std::fmod(static_cast<double>(i - start), period) < period / 3)
+                    {
+                        buffer_[i - first] |= GEN_CH_CARRIER;
+                    }
+                }
+            }
+        }
+
+        output_.write(buffer_.data(), buffer_.size());
+        return buffer_.size();
+    }
+
+    const Options &options_;
+    Output &output_;
+    std::FILE *truth_;
+    std::mt19937_64 rng_;
+    double now_us_ = 0;
+    std::vector<std::pair<double, double>> marks_;
+    std::vector<Edge> edges_;
+    std::vector<uint8_t> buffer_;
+};
+
+// 1M、2.5G这样的大小，按1024进位
+uint64_t parse_size(const char *text)
+{
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    switch (*end)
+    {
+    case 'G':
+    case 'g':
+        value *= 1024;
+        // fall through
+    case 'M':
+    case 'm':
+        value *= 1024;
+        // fall through
+    case 'K':
+    case 'k':
+        value *= 1024;
+        break;
+    default:
+        break;
+    }
+    return static_cast<uint64_t>(value);
+}
+
+// 1MHz、500kHz或者直接写Hz
+uint64_t parse_rate(const char *text)
+{
+    char *end = nullptr;
+    double value = std::strtod(text, &end);
+    std::string unit(end);
+    if (unit == "k" || unit == "kHz")
+    {
+        value *= 1e3;
+    }
+    else if (unit == "M" || unit == "MHz")
+    {
+        value *= 1e6;
+    }
+    return static_cast<uint64_t>(value);
+}
+
+bool ends_with(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void usage()
+{
+    std::fprintf(stderr, "usage: gree_gen [-s samplerate] [--frames n | --size bytes] [--gap ms] [--seed n] [--jitter us]\n"
+                         "                [--scale factor] [--carrier hz] [--glitches per_second] [--drop probability] -o file\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "-o")
+        {
+            options.path = value;
+        }
+        else if (arg == "-s")
+        {
+            options.samplerate = parse_rate(value);
+        }
+        else if (arg == "--frames")
+        {
+            options.frames = std::strtoull(value, nullptr, 10);
+        }
+        else if (arg == "--size")
+        {
+            options.size = parse_size(value);
+        }
+        else if (arg == "--gap")
+        {
+            options.gap_ms = std::atof(value);
+        }
+        else if (arg == "--seed")
+        {
+            options.seed = std::strtoull(value, nullptr, 10);
+        }
+        else if (arg == "--jitter")
+        {
+            options.jitter_us = std::atof(value);
+        }
+        else if (arg == "--scale")
+        {
+            options.scale = std::atof(value);
+        }
+        else if (arg == "--carrier")
+        {
+            options.carrier_hz = parse_rate(value);
+        }
+        else if (arg == "--glitches")
+        {
+            options.glitches = std::atof(value);
+        }
+        else if (arg == "--drop")
+        {
+            options.drop = std::atof(value);
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (!options.path || options.samplerate == 0 || options.scale <= 0)
+    {
+        usage();
+        return 2;
+    }
+
+    try
+    {
+        if (options.jitter_us < 0 || options.jitter_us > GEN_JITTER_MAX_US * options.scale)
+        {
+            throw std::runtime_error("jitter too large");
+        }
+        if (options.carrier_hz * 3 > options.samplerate)
+        {
+            throw std::runtime_error("samplerate too low for the carrier");
+        }
+
+        std::unique_ptr<Output> output;
+        if (ends_with(options.path, ".sr"))
+        {
+            output.reset(new SrOutput(options.path, options.samplerate, options.carrier_hz > 0));
+        }
+        else
+        {
+            output.reset(new RawOutput(options.path));
+        }
+        std::string truth_path = std::string(options.path) + ".frames";
+        std::unique_ptr<std::FILE, int (*)(std::FILE *)> truth(std::fopen(truth_path.c_str(), "w"), std::fclose);
+        if (!truth)
+        {
+            throw std::runtime_error("cannot create " + truth_path);
+        }
+
+        Generator generator(options, *output, truth.get());
+        uint64_t samples = 0;
+        uint64_t frames = 0;
+        while (options.size ? samples < options.size : frames < options.frames)
+        {
+            samples += generator.frame();
+            frames++;
+        }
+        output->finish();
+        std::fprintf(stderr, "%llu frames, %llu samples\n", static_cast<unsigned long long>(frames),
+                     static_cast<unsigned long long>(samples));
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "gree_gen: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
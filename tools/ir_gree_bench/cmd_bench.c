@@ -0,0 +1,112 @@
+/*
+ * MQTT命令解析和状态写出的耗时，每种消息重复多轮，输出每条的平均纳秒数
+ *
+ *   gree_cmd_bench [--rounds 轮数]
+ *
+ * sink累加结果，防止编译器把循环优化掉
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ir_gree_cmd.h"
+#include "ir_gree_sched.h"
+
+static volatile uint32_t s_sink;
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    size_t len;
+} bench_msg_t;
+
+static const bench_msg_t s_msgs[] = {
+    {"binary v1", "G\x01\x01\x01\x1a\x00\x01\x00\x00\x00\x00", IR_GREE_CMD_BINARY_SIZE},
+    {"binary v2", "G\x02\x01\x01\x1a\x00\x01\x00\x00\x00\x00\x02\x64\x00", IR_GREE_CMD_BINARY_V2_SIZE},
+    {"json temp", "{\"temp\":24}", 0},
+    {"json full", "{\"power\":1,\"mode\":\"cool\",\"temp\":26,\"fan\":\"auto\",\"swing\":true,\"light\":1,"
+                  "\"turbo\":0,\"sleep\":0,\"timer\":0,\"repeat\":2,\"gap_ms\":100}", 0},
+    {"json unknown keys", "{\"id\":\"evening\",\"at\":\"18:00\",\"days\":\"12345\",\"power\":1,\"mode\":\"cool\",\"temp\":26}", 0},
+};
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void bench_report(const char *op, const char *name, uint64_t ns, long n)
+{
+    printf("%-20s %-18s %8.1f ns/msg\n", op, name, (double)ns / n);
+}
+
+int main(int argc, char **argv)
+{
+    long rounds = 1000000;
+    if (argc == 3 && strcmp(argv[1], "--rounds") == 0)
+    {
+        rounds = atol(argv[2]);
+    }
+    else if (argc != 1)
+    {
+        rounds = 0;
+    }
+    if (rounds <= 0)
+    {
+        fprintf(stderr, "usage: %s [--rounds N]\n", argv[0]);
+        return 2;
+    }
+
+    for (size_t i = 0; i < sizeof(s_msgs) / sizeof(s_msgs[0]); i++)
+    {
+        const bench_msg_t *msg = &s_msgs[i];
+        size_t len = msg->len ? msg->len : strlen(msg->data);
+        gree_state_t state = {.temperature = 26};
+        ir_gree_cmd_opts_t opts = {0};
+        if (ir_gree_cmd_parse(msg->data, len, &state, &opts) != IR_GREE_CMD_OK)
+        {
+            fprintf(stderr, "%s: rejected\n", msg->name);
+            return 1;
+        }
+        uint64_t start = bench_now_ns();
+        for (long r = 0; r < rounds; r++)
+        {
+            s_sink += ir_gree_cmd_parse(msg->data, len, &state, &opts) + state.temperature;
+        }
+        bench_report("ir_gree_cmd_parse", msg->name, bench_now_ns() - start, rounds);
+    }
+
+    // 定时命令的解析，每次添加时一次
+    const bench_msg_t *sched_msg = &s_msgs[4];
+    ir_gree_sched_t sched;
+    uint64_t start = bench_now_ns();
+    for (long r = 0; r < rounds; r++)
+    {
+        s_sink += ir_gree_sched_parse(sched_msg->data, strlen(sched_msg->data), &sched) + sched.minute;
+    }
+    bench_report("ir_gree_sched_parse", sched_msg->name, bench_now_ns() - start, rounds);
+
+    // 遥控器改了状态后写出发布的内容
+    gree_state_t a = {.power = 1, .mode = GREE_MODE_COOL, .temperature = 26};
+    gree_state_t b = a;
+    char buf[160];
+    start = bench_now_ns();
+    for (long r = 0; r < rounds; r++)
+    {
+        b.temperature = GREE_TEMP_MIN + r % (GREE_TEMP_MAX - GREE_TEMP_MIN + 1);
+        s_sink += ir_gree_cmd_format(&b, ir_gree_cmd_diff(&a, &b), buf, sizeof(buf));
+    }
+    bench_report("ir_gree_cmd_format", "diff", bench_now_ns() - start, rounds);
+    start = bench_now_ns();
+    for (long r = 0; r < rounds; r++)
+    {
+        b.temperature = GREE_TEMP_MIN + r % (GREE_TEMP_MAX - GREE_TEMP_MIN + 1);
+        s_sink += ir_gree_cmd_format(&b, IR_GREE_CMD_STATE_ALL, buf, sizeof(buf));
+    }
+    bench_report("ir_gree_cmd_format", "all fields", bench_now_ns() - start, rounds);
+    return 0;
+}
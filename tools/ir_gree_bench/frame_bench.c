@@ -0,0 +1,137 @@
+/*
+ * 协议库打包和渲染的耗时，每种操作对同一组随机扫描码重复多轮，输出每帧的平均纳秒数
+ *
+ *   gree_frame_bench [--frames 扫描码个数] [--rounds 轮数]
+ *
+ * sink累加结果，防止编译器把循环优化掉
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ir_gree_frame.h"
+
+static uint32_t s_rng = 1;
+static volatile uint32_t s_sink;
+
+static uint32_t bench_random(void)
+{
+    // xorshift32
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, uint64_t ns, uint64_t frames)
+{
+    printf("%-22s %8.1f ns/frame\n", name, (double)ns / frames);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 1024;
+    int rounds = 200;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--frames") == 0)
+        {
+            frames = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--rounds") == 0)
+        {
+            rounds = atoi(argv[i + 1]);
+        }
+    }
+    if (frames <= 0 || rounds <= 0 || argc % 2 == 0)
+    {
+        fprintf(stderr, "usage: %s [--frames N] [--rounds N]\n", argv[0]);
+        return 2;
+    }
+
+    ir_gree_scan_code_t *codes = malloc(frames * sizeof(*codes));
+    ir_gree_packed_t *packed = malloc(frames * sizeof(*packed));
+    if (!codes || !packed)
+    {
+        return 1;
+    }
+    for (int i = 0; i < frames; i++)
+    {
+        codes[i] = (ir_gree_scan_code_t){bench_random(), bench_random(), bench_random(), bench_random()};
+    }
+    uint64_t total = (uint64_t)frames * rounds;
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            ir_gree_pack(&codes[i], &packed[i]);
+        }
+        s_sink += packed[r % frames].bits[0];
+    }
+    bench_report("ir_gree_pack", bench_now_ns() - start, total);
+
+    start = bench_now_ns();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            ir_gree_scan_code_t code;
+            ir_gree_unpack(&packed[i], &code);
+            s_sink += code.data2;
+        }
+    }
+    bench_report("ir_gree_unpack", bench_now_ns() - start, total);
+
+    start = bench_now_ns();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            s_sink += ir_gree_frame_render(&codes[i], pulses) + pulses[i % IR_GREE_FRAME_PULSES].space;
+        }
+    }
+    bench_report("ir_gree_frame_render", bench_now_ns() - start, total);
+
+    start = bench_now_ns();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            s_sink += ir_gree_packed_render(&packed[i], pulses) + pulses[i % IR_GREE_FRAME_PULSES].space;
+        }
+    }
+    bench_report("ir_gree_packed_render", bench_now_ns() - start, total);
+
+    // 流式编码器逐个符号取
+    start = bench_now_ns();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            ir_gree_cursor_t cursor = {0};
+            ir_gree_sym_t sym;
+            while ((sym = ir_gree_packed_next(&packed[i], &cursor)) != IR_GREE_SYM_INVALID)
+            {
+                s_sink += sym;
+            }
+        }
+    }
+    bench_report("ir_gree_packed_next", bench_now_ns() - start, total);
+
+    free(codes);
+    free(packed);
+    return 0;
+}
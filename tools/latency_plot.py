@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+'''
+订阅ESP32发布的延迟统计（gree/<设备名>/stats/latency），画出各阶段的分布
+
+    pip install paho-mqtt matplotlib
+    python3 tools/latency_plot.py --host 192.168.50.229 --count 30 -o latency.png
+
+每条消息是设备上最近128条命令的统计，单位us：
+    {"samples":..,"dropped":..,"stages":{"parse":{"p50":..,"p99":..,"max":..,"hist":[..]},..}}
+hist的第b个元素为[2^(b-1), 2^b)us内的样本数
+'''
+
+import argparse
+import json
+import time
+
+import paho.mqtt.client as mqtt
+
+STAGES = ('parse', 'queue', 'transmit', 'total')
+
+
+def collect(args):
+    # {设备名: [(时间, 消息), ...]}
+    reports = {}
+    topic = 'gree/%s/stats/latency' % args.device
+
+    def on_connect(client, userdata, flags, rc, *extra):
+        client.subscribe(topic)
+
+    def on_message(client, userdata, msg):
+        device = msg.topic.split('/')[1]
+        try:
+            report = json.loads(msg.payload)
+        except ValueError:
+            print('invalid payload on %s' % msg.topic)
+            return
+        reports.setdefault(device, []).append((time.time(), report))
+        total = report['stages']['total']
+        print('%s: samples=%d p50=%dus p99=%dus max=%dus' % (
+            device, report['samples'], total['p50'], total['p99'], total['max']))
+
+    # paho-mqtt 2.x需要指定回调版本，1.x没有这个参数
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:
+        client = mqtt.Client()
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.loop_start()
+    try:
+        while sum(len(r) for r in reports.values()) < args.count:
+            time.sleep(0.5)
+    except KeyboardInterrupt:
+        pass
+    client.loop_stop()
+    client.disconnect()
+    return reports
+
+
+def plot(reports, output):
+    import matplotlib
+    if output:
+        matplotlib.use('Agg')
+    import matplotlib.pyplot as plt
+
+    fig, axes = plt.subplots(2, len(STAGES), figsize=(4 * len(STAGES), 7), squeeze=False)
+    for device, items in sorted(reports.items()):
+        start = items[0][0]
+        t = [ts - start for ts, _ in items]
+        for col, stage in enumerate(STAGES):
+            # 上排：分位数随时间的变化
+            ax = axes[0][col]
+            for key, style in (('p50', '-'), ('p99', '--'), ('max', ':')):
+                values = [r['stages'][stage][key] / 1000.0 for _, r in items]
+                ax.plot(t, values, style, label='%s %s' % (device, key))
+            ax.set_title(stage)
+            ax.set_xlabel('s')
+            ax.set_ylabel('ms')
+            ax.legend(fontsize='small')
+
+            # 下排：最后一次统计的分桶
+            ax = axes[1][col]
+            hist = items[-1][1]['stages'][stage]['hist']
+            edges = [(1 << b) / 1000.0 for b in range(len(hist))]
+            ax.bar(range(len(hist)), hist, alpha=0.6, label=device)
+            ticks = list(range(0, len(hist), 4))
+            ax.set_xticks(ticks)
+            ax.set_xticklabels(['<%g' % edges[b] for b in ticks], fontsize='small')
+            ax.set_xlabel('ms')
+            ax.set_ylabel('samples')
+            ax.legend(fontsize='small')
+
+    fig.tight_layout()
+    if output:
+        fig.savefig(output)
+    else:
+        plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Plot IR command latency published by the ESP32')
+    parser.add_argument('--host', default='192.168.50.229')
+    parser.add_argument('--port', type=int, default=1883)
+    parser.add_argument('--device', default='+', help='device name, + for all')
+    parser.add_argument('--count', type=int, default=10, help='number of reports to collect')
+    parser.add_argument('-o', '--output', help='save the figure instead of showing it')
+    args = parser.parse_args()
+
+    reports = collect(args)
+    if not reports:
+        print('no reports received')
+        return
+    plot(reports, args.output)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+'''
+对比ir_gree/batch.py和ir_gree/pd.py：同一个抓包，pd.py在模拟的sigrokdecode中逐个边沿调用decode，
+两边的注释和OUTPUT_PYTHON必须完全相同，并输出两边的耗时
+
+    python3 tools/pd_batch_check.py capture.sr
+    python3 tools/pd_batch_check.py -s 1MHz --calibrate --bits no capture.bin
+
+两边都从找好的边沿开始计时，读文件和找边沿（sigrok中由libsigrokdecode完成）单独列出
+'''
+
+import argparse
+import os
+import sys
+import time
+import types
+
+import numpy as np
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+
+
+class EndOfCapture(Exception):
+    pass
+
+
+def install_srd():
+    '''pd.py用到的sigrokdecode的部分：wait按条件跳到下一个边沿，put记录输出'''
+    srd = types.ModuleType('sigrokdecode')
+    srd.OUTPUT_ANN = 'ann'
+    srd.OUTPUT_PYTHON = 'python'
+    srd.SRD_CONF_SAMPLERATE = 'samplerate'
+
+    class Decoder:
+        def register(self, output):
+            return output
+
+        def put(self, ss, es, output, data):
+            self.outputs.append((ss, es, output, data))
+
+        def wait(self, conds):
+            want = conds[0]
+            while self.edge < len(self.levels):
+                level = self.levels[self.edge]
+                self.samplenum = self.samples[self.edge]
+                self.edge += 1
+                if want == 'e' or (want == 'f') == (level == 0):
+                    return (level,)
+            raise EndOfCapture
+
+    srd.Decoder = Decoder
+    sys.modules['sigrokdecode'] = srd
+
+
+def run_pd(edges, options):
+    from ir_gree.pd import Decoder
+    samples = np.concatenate((edges.falls, edges.rises))
+    levels = np.concatenate((np.zeros(len(edges.falls), np.int8), np.ones(len(edges.rises), np.int8)))
+    order = np.argsort(samples, kind='stable')
+    decoder = Decoder()
+    decoder.outputs = []
+    decoder.samples = samples[order].tolist()
+    decoder.levels = levels[order].tolist()
+    decoder.edge = 0
+    decoder.options = options
+    decoder.start()
+    decoder.metadata('samplerate', edges.samplerate)
+    begin = time.perf_counter()
+    try:
+        decoder.decode()
+    except EndOfCapture:
+        pass
+    return time.perf_counter() - begin, decoder.outputs
+
+
+def key(output):
+    return (output[0], output[1], output[2], repr(output[3]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='compare ir_gree.batch with ir_gree.pd')
+    parser.add_argument('file')
+    parser.add_argument('-s', '--samplerate')
+    parser.add_argument('-c', '--channel', default='IR')
+    parser.add_argument('--bits', default='yes', choices=('yes', 'no'))
+    parser.add_argument('--calibrate', action='store_true')
+    args = parser.parse_args()
+
+    install_srd()
+    from ir_gree import batch
+    channel = int(args.channel) if args.channel.isdigit() else args.channel
+    samplerate = batch.parse_samplerate(args.samplerate) if args.samplerate else None
+
+    begin = time.perf_counter()
+    edges = batch.load(args.file, samplerate, channel)
+    load_seconds = time.perf_counter() - begin
+    begin = time.perf_counter()
+    result = batch.decode(edges, args.calibrate)
+    batch_seconds = time.perf_counter() - begin
+    expected = sorted(result.annotations(args.bits == 'yes'), key=key)
+
+    options = {'bits': args.bits, 'calibrate': 'yes' if args.calibrate else 'no'}
+    pd_seconds, outputs = run_pd(edges, options)
+    outputs.sort(key=key)
+
+    frames = sum(1 for o in outputs if o[2] == 'python' and o[3][0] == 'FRAME')
+    print('%d edges, %d outputs, %d frames' % (len(edges.falls) + len(edges.rises), len(outputs), frames))
+    print('load %.3f s, decode: pd.py %.3f s, batch %.4f s, %.0fx' % (
+        load_seconds, pd_seconds, batch_seconds, pd_seconds / batch_seconds))
+    if outputs == expected:
+        print('outputs match')
+        return 0
+
+    mismatch = 0
+    for a, b in zip(outputs, expected):
+        if a != b:
+            print('pd.py %s\nbatch %s' % (a, b))
+            mismatch += 1
+            if mismatch >= 10:
+                break
+    print('outputs differ: pd.py %d, batch %d' % (len(outputs), len(expected)))
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,338 @@
+/*
+ * 在主机上检查esp32/main/ir_gree_encoder.c在各种RMT内存块大小下的输出
+ *
+ *   gree_encoder_check [--frames 每种大小的帧数] [--block-max 最大内存块] [--seed 种子]
+ *
+ * 按驱动的方式反复调用编码器直到COMPLETE：第一次可以写整个内存块，之后每次补充中断写半个，
+ * 另外每次可写的符号数随机（1 ~ 内存块大小）再跑一遍，以及编码到一半时rmt_encoder_reset再发下一帧。
+ * 拼起来的符号必须与按ir_gree_frame_render独立渲染的整帧完全相同。
+ * 两种编码方式（逐符号的流式编码和预先渲染整帧）都检查，输出每帧的编码器调用次数和耗时，用于对比编码器的改动。
+ * 有不一致时返回1。
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ir_gree_encoder.h"
+#include "rmt_mock.h"
+
+// 输出中统计调用次数和耗时的内存块大小
+static const size_t s_report_blocks[] = {1, 2, 3, 4, 8, 16, 24, 32, 48, 64, 96, 128, 256, 512};
+
+// 一帧的符号数加上一些余量，写出超过这个数说明编码器重复输出
+#define CHECK_OUT_SYMBOLS (IR_GREE_FRAME_SYMBOLS * 2)
+
+typedef struct
+{
+    int frames;
+    size_t block_max;
+    uint32_t seed;
+} check_options_t;
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t calls;
+    uint64_t ns;
+} check_result_t;
+
+static uint32_t s_rng;
+// 驱动看到的完成帧数和调用次数，与编码器自己的统计对比
+static uint64_t s_frames_done;
+static uint64_t s_calls;
+static uint64_t s_transmits;
+static uint32_t s_refills_max;
+
+static uint32_t check_random(void)
+{
+    // xorshift32
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint64_t check_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// 不经过编码器，直接按协议把一帧渲染成RMT符号：mark为高电平，超过15bit的空闲拆成两个低电平
+static size_t check_reference(const ir_gree_scan_code_t *scan_code, rmt_symbol_word_t *symbols)
+{
+    ir_gree_pulse_t pulses[IR_GREE_FRAME_PULSES];
+    size_t count = ir_gree_frame_render(scan_code, pulses);
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t space = pulses[i].space ? pulses[i].space : END_CODE_DURATION_1;
+        uint32_t first = space > RMT_DURATION_MAX ? RMT_DURATION_MAX : space;
+        symbols[n++] = (rmt_symbol_word_t){.level0 = 1, .duration0 = pulses[i].mark, .level1 = 0, .duration1 = first};
+        if (space > first)
+        {
+            uint32_t rest = space - first;
+            symbols[n++] = (rmt_symbol_word_t){.level0 = 0, .duration0 = rest / 2, .level1 = 0, .duration1 = rest - rest / 2};
+        }
+    }
+    return n;
+}
+
+static void check_random_frame(ir_gree_scan_code_t *scan_code)
+{
+    scan_code->data1 = check_random();
+    scan_code->data2 = check_random();
+    scan_code->data3 = check_random();
+    scan_code->data4 = check_random();
+}
+
+/**
+ * 按驱动的方式调用编码器直到COMPLETE，返回调用次数
+ * random为false时第一次可写block个符号，之后每次block / 2个；为true时每次1 ~ block个
+ * abort_after不为0时调用这么多次后停止，模拟发送被中止，返回0；出错返回-1
+ */
+static int check_transmit(rmt_encoder_handle_t encoder, const void *data, size_t size, struct rmt_channel_t *channel,
+                          size_t block, bool random, int abort_after)
+{
+    size_t mem = random ? 1 + check_random() % block : block;
+    s_transmits++;
+    for (int calls = 1; calls <= CHECK_OUT_SYMBOLS; calls++)
+    {
+        rmt_encode_state_t state = RMT_ENCODING_RESET;
+        size_t before = channel->out_len;
+        rmt_mock_channel_refill(channel, mem);
+        size_t encoded = encoder->encode(encoder, channel, data, size, &state);
+        s_calls++;
+        if (channel->overflow)
+        {
+            fprintf(stderr, "block %zu: encoder wrote more than %d symbols\n", block, CHECK_OUT_SYMBOLS);
+            return -1;
+        }
+        if (encoded != channel->out_len - before)
+        {
+            fprintf(stderr, "block %zu call %d: returned %zu symbols, wrote %zu\n", block, calls, encoded,
+                    channel->out_len - before);
+            return -1;
+        }
+        if (state & RMT_ENCODING_COMPLETE)
+        {
+            s_frames_done++;
+            if ((uint32_t)calls - 1 > s_refills_max)
+            {
+                s_refills_max = calls - 1;
+            }
+            return calls;
+        }
+        // 既没有完成也没有写满，驱动会一直等下去
+        if (!(state & RMT_ENCODING_MEM_FULL))
+        {
+            fprintf(stderr, "block %zu call %d: returned without COMPLETE or MEM_FULL\n", block, calls);
+            return -1;
+        }
+        if (calls == abort_after)
+        {
+            return 0;
+        }
+        mem = random ? 1 + check_random() % block : (block > 1 ? block / 2 : 1);
+    }
+    fprintf(stderr, "block %zu: no COMPLETE after %d calls\n", block, CHECK_OUT_SYMBOLS);
+    return -1;
+}
+
+static bool check_compare(const char *name, size_t block, const rmt_symbol_word_t *expected, size_t expected_len,
+                          const struct rmt_channel_t *channel)
+{
+    for (size_t i = 0; i < expected_len && i < channel->out_len; i++)
+    {
+        if (expected[i].val != channel->out[i].val)
+        {
+            fprintf(stderr, "%s block %zu: symbol %zu is %08" PRIx32 ", expected %08" PRIx32 "\n", name, block, i,
+                    channel->out[i].val, expected[i].val);
+            return false;
+        }
+    }
+    if (expected_len != channel->out_len)
+    {
+        fprintf(stderr, "%s block %zu: %zu symbols, expected %zu\n", name, block, channel->out_len, expected_len);
+        return false;
+    }
+    return true;
+}
+
+// 一种编码方式在一种内存块大小下的所有检查
+static bool check_block(rmt_encoder_handle_t encoder, bool prebuilt, size_t block, const check_options_t *options,
+                        check_result_t *result)
+{
+    const char *name = prebuilt ? "prebuilt" : "stream";
+    rmt_symbol_word_t expected[IR_GREE_FRAME_SYMBOLS];
+    rmt_symbol_word_t frame[IR_GREE_FRAME_SYMBOLS];
+    rmt_symbol_word_t out[CHECK_OUT_SYMBOLS];
+    struct rmt_channel_t channel;
+    ir_gree_scan_code_t scan_code;
+    ir_gree_packed_t packed;
+
+    // 0：驱动的ping-pong补充，1：随机大小，2：中止后再发
+    for (int pass = 0; pass < 3; pass++)
+    {
+        for (int f = 0; f < options->frames; f++)
+        {
+            check_random_frame(&scan_code);
+            ir_gree_pack(&scan_code, &packed);
+            size_t expected_len = check_reference(&scan_code, expected);
+            size_t frame_len = ir_gree_build_frame(&packed, frame);
+            const void *data = prebuilt ? (const void *)frame : (const void *)&packed;
+            size_t size = prebuilt ? frame_len * sizeof(rmt_symbol_word_t) : sizeof(packed);
+
+            if (pass == 2)
+            {
+                rmt_mock_channel_init(&channel, out, CHECK_OUT_SYMBOLS);
+                if (check_transmit(encoder, data, size, &channel, block, true, 1 + check_random() % 4) < 0)
+                {
+                    return false;
+                }
+                rmt_encoder_reset(encoder);
+                // 中止的是上一帧，下一帧换一个扫描码
+                check_random_frame(&scan_code);
+                ir_gree_pack(&scan_code, &packed);
+                expected_len = check_reference(&scan_code, expected);
+                frame_len = ir_gree_build_frame(&packed, frame);
+                size = prebuilt ? frame_len * sizeof(rmt_symbol_word_t) : sizeof(packed);
+            }
+
+            rmt_mock_channel_init(&channel, out, CHECK_OUT_SYMBOLS);
+            uint64_t start = check_now_ns();
+            int calls = check_transmit(encoder, data, size, &channel, block, pass == 1, 0);
+            uint64_t ns = check_now_ns() - start;
+            if (calls <= 0 || !check_compare(name, block, expected, expected_len, &channel))
+            {
+                fprintf(stderr, "%s block %zu pass %d frame %08" PRIx32 " %08" PRIx32 " %08" PRIx32 " %08" PRIx32 "\n",
+                        name, block, pass, scan_code.data1, scan_code.data2, scan_code.data3, scan_code.data4);
+                return false;
+            }
+            if (pass == 0)
+            {
+                result->frames++;
+                result->calls += calls;
+                result->ns += ns;
+            }
+        }
+    }
+    return true;
+}
+
+static bool check_encoder(bool prebuilt, const check_options_t *options, check_result_t *results)
+{
+    ir_gree_encoder_config_t config = {
+        .resolution = 1000000,
+        .prebuilt = prebuilt,
+    };
+    rmt_encoder_handle_t encoder = NULL;
+    s_frames_done = 0;
+    s_calls = 0;
+    s_transmits = 0;
+    s_refills_max = 0;
+    if (rmt_new_ir_gree_encoder(&config, &encoder) != ESP_OK)
+    {
+        fprintf(stderr, "rmt_new_ir_gree_encoder failed\n");
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t block = 1; block <= options->block_max && ok; block++)
+    {
+        ok = check_block(encoder, prebuilt, block, options, &results[block]);
+    }
+
+    // 编码器自己的统计与驱动看到的一致
+    ir_gree_encoder_stats_t stats;
+    rmt_ir_gree_encoder_get_stats(encoder, &stats);
+    if (ok && (stats.frames != (uint32_t)s_frames_done || stats.encode_calls != (uint32_t)s_calls))
+    {
+        fprintf(stderr, "%s: encoder counted %" PRIu32 " frames %" PRIu32 " calls, expected %" PRIu64 " %" PRIu64 "\n",
+                prebuilt ? "prebuilt" : "stream", stats.frames, stats.encode_calls, s_frames_done, s_calls);
+        ok = false;
+    }
+    // 每次发送除了第一次调用都是补充中断
+    if (ok && (stats.refills != (uint32_t)(s_calls - s_transmits) || stats.refills_max != s_refills_max))
+    {
+        fprintf(stderr, "%s: encoder counted %" PRIu32 " refills (max %" PRIu32 "), expected %" PRIu64 " (max %" PRIu32 ")\n",
+                prebuilt ? "prebuilt" : "stream", stats.refills, stats.refills_max, s_calls - s_transmits, s_refills_max);
+        ok = false;
+    }
+    rmt_del_encoder(encoder);
+    return ok;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: gree_encoder_check [--frames n] [--block-max symbols] [--seed n]\n");
+}
+
+int main(int argc, char **argv)
+{
+    check_options_t options = {
+        .frames = 50,
+        .block_max = 512,
+        .seed = 1,
+    };
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--frames") == 0)
+        {
+            options.frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--block-max") == 0)
+        {
+            options.block_max = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            options.seed = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (options.frames <= 0 || options.block_max == 0 || options.seed == 0)
+    {
+        usage();
+        return 2;
+    }
+    s_rng = options.seed;
+
+    check_result_t *stream = calloc(options.block_max + 1, sizeof(check_result_t));
+    check_result_t *prebuilt = calloc(options.block_max + 1, sizeof(check_result_t));
+    bool ok = stream && prebuilt && check_encoder(false, &options, stream) && check_encoder(true, &options, prebuilt);
+    if (ok)
+    {
+        printf("%6s  %14s  %14s  %14s  %14s\n", "block", "stream calls", "prebuilt calls", "stream ns", "prebuilt ns");
+        for (size_t i = 0; i < sizeof(s_report_blocks) / sizeof(s_report_blocks[0]); i++)
+        {
+            size_t block = s_report_blocks[i];
+            if (block > options.block_max)
+            {
+                break;
+            }
+            printf("%6zu  %14.1f  %14.1f  %14.0f  %14.0f\n", block, (double)stream[block].calls / stream[block].frames,
+                   (double)prebuilt[block].calls / prebuilt[block].frames, (double)stream[block].ns / stream[block].frames,
+                   (double)prebuilt[block].ns / prebuilt[block].frames);
+        }
+        printf("block sizes 1-%zu: %d frames each, all match\n", options.block_max, options.frames);
+    }
+    free(stream);
+    free(prebuilt);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+// 主机编译用的桩，模拟中只有一个线程，临界区什么也不做
+#pragma once
+
+typedef struct
+{
+    int count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZE(mux) ((mux)->count = 0)
+#define portENTER_CRITICAL(mux) ((mux)->count++)
+#define portEXIT_CRITICAL(mux) ((mux)->count--)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux) portEXIT_CRITICAL(mux)
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rmt_mock.h"
+
+// 与IDF的rmt_encode_copy相同：本次放不下时记住位置并返回MEM_FULL，放完时返回COMPLETE，
+// 正好放满时两个都返回
+typedef struct
+{
+    rmt_encoder_t base;
+    size_t last_symbol_index;
+} rmt_copy_encoder_t;
+
+void rmt_mock_channel_init(struct rmt_channel_t *channel, rmt_symbol_word_t *out, size_t out_size)
+{
+    memset(channel, 0, sizeof(*channel));
+    channel->out = out;
+    channel->out_size = out_size;
+}
+
+void rmt_mock_channel_refill(struct rmt_channel_t *channel, size_t mem_symbols)
+{
+    channel->mem_have = mem_symbols;
+}
+
+static size_t rmt_encode_copy(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data,
+                              size_t data_size, rmt_encode_state_t *ret_state)
+{
+    rmt_copy_encoder_t *copy_encoder = __containerof(encoder, rmt_copy_encoder_t, base);
+    const rmt_symbol_word_t *symbols = (const rmt_symbol_word_t *)primary_data;
+    size_t num_symbols = data_size / sizeof(rmt_symbol_word_t);
+    size_t mem_want = num_symbols - copy_encoder->last_symbol_index;
+    size_t encode_len = mem_want < channel->mem_have ? mem_want : channel->mem_have;
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+
+    for (size_t i = 0; i < encode_len; i++)
+    {
+        if (channel->out_len == channel->out_size)
+        {
+            channel->overflow = 1;
+            break;
+        }
+        channel->out[channel->out_len++] = symbols[copy_encoder->last_symbol_index + i];
+    }
+    channel->mem_have -= encode_len;
+    copy_encoder->last_symbol_index += encode_len;
+
+    // 只写了一部分时下次从last_symbol_index继续
+    if (encode_len == mem_want)
+    {
+        copy_encoder->last_symbol_index = 0;
+        state |= RMT_ENCODING_COMPLETE;
+    }
+    if (channel->mem_have == 0)
+    {
+        state |= RMT_ENCODING_MEM_FULL;
+    }
+    *ret_state = state;
+    return encode_len;
+}
+
+static esp_err_t rmt_copy_encoder_reset(rmt_encoder_t *encoder)
+{
+    rmt_copy_encoder_t *copy_encoder = __containerof(encoder, rmt_copy_encoder_t, base);
+    copy_encoder->last_symbol_index = 0;
+    return ESP_OK;
+}
+
+static esp_err_t rmt_del_copy_encoder(rmt_encoder_t *encoder)
+{
+    free(__containerof(encoder, rmt_copy_encoder_t, base));
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_copy_encoder(const rmt_copy_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    (void)config;
+    rmt_copy_encoder_t *copy_encoder = calloc(1, sizeof(rmt_copy_encoder_t));
+    if (!copy_encoder)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    copy_encoder->base.encode = rmt_encode_copy;
+    copy_encoder->base.reset = rmt_copy_encoder_reset;
+    copy_encoder->base.del = rmt_del_copy_encoder;
+    *ret_encoder = &copy_encoder->base;
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder)
+{
+    return encoder->del(encoder);
+}
+
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t encoder)
+{
+    return encoder->reset(encoder);
+}
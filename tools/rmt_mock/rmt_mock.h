@@ -0,0 +1,32 @@
+/*
+ * 模拟RMT发射通道的内存块
+ *
+ * 驱动第一次调用编码器时整个内存块可用，之后每次补充中断只腾出一半（ping-pong），
+ * 编码器写满时copy_encoder返回MEM_FULL，下一次调用从上次的位置继续。
+ * 这里把每次调用能写的符号数交给调用者决定，从1个符号到任意大小都可以模拟，
+ * 写入的符号按顺序追加到out中，用来与整帧对比。
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "driver/rmt_encoder.h"
+
+struct rmt_channel_t
+{
+    rmt_symbol_word_t *out;
+    size_t out_len;
+    size_t out_size;
+    // 本次调用剩余的空间
+    size_t mem_have;
+    // 写出超过out_size时置位，不再写入
+    int overflow;
+};
+
+void rmt_mock_channel_init(struct rmt_channel_t *channel, rmt_symbol_word_t *out, size_t out_size);
+
+/**
+ * 开始一次编码器调用，本次最多写入mem_symbols个符号
+ */
+void rmt_mock_channel_refill(struct rmt_channel_t *channel, size_t mem_symbols);